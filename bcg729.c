@@ -1,29 +1,170 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include "php.h"
 #include "php_bcg729.h"
 #include "zend_smart_string.h"
+#include "zend_exceptions.h"
+#include "ext/standard/info.h"
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if !defined(PHP_WIN32)
+#include <unistd.h>
+#endif
+
+/* Pool de threads nativas: ./configure detecta pthread.h (--disable-bcg729-threads desliga) */
+#if defined(HAVE_BCG729_THREADS)
+#include <pthread.h>
+#include <signal.h>
+#define BCG729_THREADS 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "bcg729/decoder.h"
 #include "bcg729/encoder.h"
 
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#if defined(_MSC_VER)
+#define BCG729_ALIGNED(n) __declspec(align(n))
+#else
+#define BCG729_ALIGNED(n) __attribute__((aligned(n)))
+#endif
+
+ZEND_DECLARE_MODULE_GLOBALS(bcg729)
+
 #define Z_BCG729_CHANNEL_P(zv)  ((bcg729Channel *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729Channel, std)))
 
+/* Modos do canal (bcg729Channel::ENCODE_ONLY / DECODE_ONLY / BOTH) */
+#define BCG729_MODE_ENCODE 1
+#define BCG729_MODE_DECODE 2
+#define BCG729_MODE_BOTH   (BCG729_MODE_ENCODE | BCG729_MODE_DECODE)
+
+/*
+ * Histórico dos últimos frames que entraram em cada contexto, usado por
+ * exportState(): os contextos da libbcg729 são opacos (não dá para copiar
+ * a estrutura), então o estado é reconstruído repetindo essas entradas
+ * num contexto novo. Desligado por padrão (bcg729.state_frames = 0): o
+ * anel custa memória e um memcpy por frame em todo canal. Enquanto o anel
+ * cobre tudo desde o início (ou reset) o replay repete todas as entradas;
+ * depois disso é uma aproximação, já que os filtros convergem dentro da
+ * janela mas não voltam ao mesmo estado. O último SID que sai do anel do decoder fica fixo
+ * fora dele: num DTX mais longo que a janela o anel só tem CNG, e sem o
+ * SID o replay geraria ruído de conforto sem parâmetros.
+ */
+#define BCG729_HIST_PCM_ITEM 160  /* encoder: 80 amostras PCM */
+#define BCG729_HIST_DEC_ITEM 11   /* decoder: tipo + até 10 bytes */
+#define BCG729_HIST_MAX_FRAMES 1000
+
+/* Tipos de entrada do decoder no histórico */
+#define BCG729_HIST_VOICE  0
+#define BCG729_HIST_SID    1
+#define BCG729_HIST_ERASED 2
+#define BCG729_HIST_CNG    3      /* frame não transmitido depois de um SID */
+
 typedef struct {
-    bcg729DecoderChannelContextStruct *decoder;
-    bcg729EncoderChannelContextStruct *encoder;
+    uint8_t *data;             /* anel de cap itens, alocado com o contexto */
+    uint32_t cap;
+    uint32_t count;
+    uint32_t head;             /* próximo slot a escrever */
+    zend_bool exact;           /* todos os frames desde o contexto novo estão no anel */
+    zend_bool has_sid;         /* decoder: sid vale (nenhuma voz saiu do anel depois dele) */
+    uint8_t sid[2];            /* decoder: último SID que saiu do anel */
+} bcg729History;
+
+typedef struct _bcg729Channel {
+    bcg729DecoderChannelContextStruct *decoder; /* alocado no primeiro uso */
+    bcg729EncoderChannelContextStruct *encoder; /* alocado no primeiro uso */
+    zend_long mode;            /* BCG729_MODE_* */
+    zend_bool closed;          /* close() chamado: não realoca mais */
+    zend_bool annexb;          /* VAD/DTX/CNG (G.729 Annex B) no encoder */
+    zend_bool decoder_in_cng;  /* último frame decodificado foi SID/não transmitido */
+    zend_bool in_batch;        /* marcado enquanto um encodeBatch/decodeBatch o usa */
+    int16_t pcm_tail[80];      /* push(): sobra de PCM que ainda não fecha um frame */
+    size_t pcm_tail_len;       /* em bytes, 0..159 */
+    smart_string pending;      /* push(): G.729 codificado aguardando pull() */
+    smart_string pending_lens; /* tamanho de cada frame em pending (10, 2 ou 0) */
+    bcg729ChannelStats stats;  /* só as threads do batch deste canal escrevem aqui */
+    bcg729History enc_hist;    /* últimos frames PCM do encoder (exportState) */
+    bcg729History dec_hist;    /* últimos frames de entrada do decoder */
+    struct _bcg729Channel *live_prev; /* lista de canais vivos (bcg729_stats()) */
+    struct _bcg729Channel *live_next;
     zend_object std;
 } bcg729Channel;
 
 static zend_class_entry *bcg729_ce;
 static zend_object_handlers bcg729_handlers;
 
+/* Bytes de heap de cada tipo de contexto, medidos uma vez no MINIT */
+static size_t bcg729_decoder_ctx_bytes;
+static size_t bcg729_encoder_ctx_bytes;
+static size_t bcg729_encoder_vad_ctx_bytes;
+
+/* Relógio monotônico em ns para os contadores de tempo */
+static uint64_t bcg729_clock_ns(void) {
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+#else
+    return (uint64_t) time(NULL) * 1000000000ULL;
+#endif
+}
+
+static void bcg729_stats_add(bcg729ChannelStats *dst, const bcg729ChannelStats *src) {
+    dst->frames_encoded += src->frames_encoded;
+    dst->frames_decoded += src->frames_decoded;
+    dst->bytes_in += src->bytes_in;
+    dst->bytes_out += src->bytes_out;
+    dst->rejected += src->rejected;
+    dst->erasures += src->erasures;
+    dst->sid_encoded += src->sid_encoded;
+    dst->sid_decoded += src->sid_decoded;
+    dst->encoder_ns += src->encoder_ns;
+    dst->decoder_ns += src->decoder_ns;
+}
+
 static zend_object *bcg729_create(zend_class_entry *ce) {
     bcg729Channel *obj = zend_object_alloc(sizeof(bcg729Channel), ce);
-    obj->decoder = initBcg729DecoderChannel();
-    obj->encoder = initBcg729EncoderChannel(0);
+    obj->decoder = NULL;
+    obj->encoder = NULL;
+    obj->mode = BCG729_MODE_BOTH;
+    obj->closed = 0;
+    obj->annexb = 0;
+    obj->decoder_in_cng = 0;
+    obj->in_batch = 0;
+    obj->pcm_tail_len = 0;
+    memset(&obj->pending, 0, sizeof(obj->pending));
+    memset(&obj->pending_lens, 0, sizeof(obj->pending_lens));
+    memset(&obj->stats, 0, sizeof(obj->stats));
+    memset(&obj->enc_hist, 0, sizeof(obj->enc_hist));
+    memset(&obj->dec_hist, 0, sizeof(obj->dec_hist));
+
+    obj->live_prev = NULL;
+    obj->live_next = BCG729_G(live_channels);
+    if (obj->live_next) {
+        obj->live_next->live_prev = obj;
+    }
+    BCG729_G(live_channels) = obj;
+    BCG729_G(channels_created)++;
 
     zend_object_std_init(&obj->std, ce);
     object_properties_init(&obj->std, ce);
@@ -32,19 +173,271 @@ static zend_object *bcg729_create(zend_class_entry *ce) {
     return &obj->std;
 }
 
+/* ------------------------------------------------------------------------- */
+/*    Pool de contextos (bcg729.pool_size)                                    */
+/* ------------------------------------------------------------------------- */
+
+PHP_INI_BEGIN()
+    STD_PHP_INI_ENTRY("bcg729.pool_size", "16", PHP_INI_SYSTEM, OnUpdateLong, pool_size, zend_bcg729_globals, bcg729_globals)
+    STD_PHP_INI_ENTRY("bcg729.threads", "1", PHP_INI_SYSTEM, OnUpdateLong, threads, zend_bcg729_globals, bcg729_globals)
+    STD_PHP_INI_BOOLEAN("bcg729.simd", "1", PHP_INI_SYSTEM, OnUpdateBool, simd, zend_bcg729_globals, bcg729_globals)
+    STD_PHP_INI_ENTRY("bcg729.state_frames", "0", PHP_INI_SYSTEM, OnUpdateLong, state_frames, zend_bcg729_globals, bcg729_globals)
+PHP_INI_END()
+
+static void *bcg729_ctx_new(int kind) {
+    if (kind == BCG729_POOL_DECODER) {
+        return initBcg729DecoderChannel();
+    }
+    return initBcg729EncoderChannel(kind == BCG729_POOL_ENCODER_VAD);
+}
+
+static void bcg729_ctx_close(int kind, void *ctx) {
+    if (kind == BCG729_POOL_DECODER) {
+        closeBcg729DecoderChannel(ctx);
+    } else {
+        closeBcg729EncoderChannel(ctx);
+    }
+}
+
+/* Há espaço no pool deste tipo? Cresce o array até pool_size na primeira vez */
+static zend_bool bcg729_pool_has_room(int kind) {
+    zend_long size = BCG729_G(pool_size);
+
+    if (size <= 0 || BCG729_G(pool_count)[kind] >= (uint32_t) size) {
+        return 0;
+    }
+    if (BCG729_G(pool_cap)[kind] < (uint32_t) size) {
+        BCG729_G(pool)[kind] = perealloc(BCG729_G(pool)[kind], sizeof(void *) * (size_t) size, 1);
+        BCG729_G(pool_cap)[kind] = (uint32_t) size;
+    }
+    return 1;
+}
+
+/* Pega um contexto pronto do pool ou, se vazio, inicializa um novo */
+static void *bcg729_pool_acquire(int kind) {
+    if (BCG729_G(pool_count)[kind] > 0) {
+        return BCG729_G(pool)[kind][--BCG729_G(pool_count)[kind]];
+    }
+    return bcg729_ctx_new(kind);
+}
+
+/*
+ * Devolve um contexto usado. A libbcg729 não expõe reset do estado, então
+ * o contexto sujo é liberado e um novo entra no pool: o custo fica no
+ * hangup e o setup da próxima chamada não aloca nada.
+ */
+static void bcg729_pool_release(int kind, void *ctx) {
+    bcg729_ctx_close(kind, ctx);
+    if (bcg729_pool_has_room(kind)) {
+        BCG729_G(pool)[kind][BCG729_G(pool_count)[kind]++] = bcg729_ctx_new(kind);
+    }
+}
+
+static void bcg729_pool_fill(int kind) {
+    while (bcg729_pool_has_room(kind)) {
+        BCG729_G(pool)[kind][BCG729_G(pool_count)[kind]++] = bcg729_ctx_new(kind);
+    }
+}
+
+static void bcg729_pool_free(zend_bcg729_globals *g) {
+    for (int kind = 0; kind < BCG729_POOL_KINDS; kind++) {
+        for (uint32_t i = 0; i < g->pool_count[kind]; i++) {
+            bcg729_ctx_close(kind, g->pool[kind][i]);
+        }
+        if (g->pool[kind]) {
+            pefree(g->pool[kind], 1);
+        }
+        g->pool[kind] = NULL;
+        g->pool_count[kind] = 0;
+        g->pool_cap[kind] = 0;
+    }
+}
+
+static int bcg729_channel_encoder_kind(const bcg729Channel *self) {
+    return self->annexb ? BCG729_POOL_ENCODER_VAD : BCG729_POOL_ENCODER;
+}
+
+/* Descarta a sobra de PCM e os frames ainda não lidos por pull() */
+static void bcg729_channel_stream_clear(bcg729Channel *self) {
+    self->pcm_tail_len = 0;
+    smart_string_free(&self->pending);
+    smart_string_free(&self->pending_lens);
+}
+
+/* Aloca o anel junto com o contexto (sempre na thread do PHP, antes dos lotes) */
+static void bcg729_history_init(bcg729History *h, size_t item) {
+    zend_long frames = BCG729_G(state_frames);
+
+    if (frames > BCG729_HIST_MAX_FRAMES) {
+        frames = BCG729_HIST_MAX_FRAMES;
+    }
+    if (!h->data && frames > 0) {
+        h->data = safe_emalloc((size_t) frames, item, 0);
+        h->cap = (uint32_t) frames;
+    }
+    h->count = 0;
+    h->head = 0;
+    h->exact = 1;
+    h->has_sid = 0;
+}
+
+static void bcg729_history_free(bcg729History *h) {
+    if (h->data) {
+        efree(h->data);
+    }
+    memset(h, 0, sizeof(*h));
+}
+
+/* Próximo slot do anel (sobrescreve o mais antigo quando cheio); NULL se desativado */
+static uint8_t *bcg729_history_slot(bcg729History *h, size_t item) {
+    if (h->count == h->cap) {
+        h->exact = 0;
+        if (h->cap == 0) {
+            return NULL;
+        }
+    } else {
+        h->count++;
+    }
+
+    uint8_t *slot = h->data + ((size_t) h->head * item);
+    h->head = (h->head + 1) % h->cap;
+    return slot;
+}
+
+/* i-ésimo item, do mais antigo para o mais recente */
+static const uint8_t *bcg729_history_item(const bcg729History *h, size_t item, uint32_t i) {
+    return h->data + ((size_t) ((h->head + h->cap - h->count + i) % h->cap) * item);
+}
+
+static void bcg729_history_decoder(bcg729History *h, uint8_t kind, const uint8_t *frame, size_t len) {
+    zend_bool evicting = h->cap > 0 && h->count == h->cap;
+    uint8_t *slot = bcg729_history_slot(h, BCG729_HIST_DEC_ITEM);
+    if (slot) {
+        if (evicting && slot[0] == BCG729_HIST_SID) {
+            memcpy(h->sid, slot + 1, 2);
+            h->has_sid = 1;
+        } else if (evicting && slot[0] == BCG729_HIST_VOICE) {
+            h->has_sid = 0; /* o período de DTX do SID fixo terminou antes da janela */
+        }
+        slot[0] = kind;
+        memcpy(slot + 1, frame, len);
+    }
+}
+
+static void bcg729_history_encoder(bcg729History *h, const int16_t *pcm) {
+    uint8_t *slot = bcg729_history_slot(h, BCG729_HIST_PCM_ITEM);
+    if (slot) {
+        memcpy(slot, pcm, BCG729_HIST_PCM_ITEM);
+    }
+}
+
+/* Devolve os contextos do canal ao pool */
+static void bcg729_channel_release(bcg729Channel *self) {
+    if (self->decoder) {
+        bcg729_pool_release(BCG729_POOL_DECODER, self->decoder);
+        self->decoder = NULL;
+    }
+    if (self->encoder) {
+        bcg729_pool_release(bcg729_channel_encoder_kind(self), self->encoder);
+        self->encoder = NULL;
+    }
+}
+
 static void bcg729_free(zend_object *object) {
     bcg729Channel *obj = (bcg729Channel *) ((char *) object - XtOffsetOf(bcg729Channel, std));
-    if (obj->decoder) {
-        closeBcg729DecoderChannel(obj->decoder);
-        obj->decoder = NULL;
+    bcg729_channel_release(obj);
+    bcg729_channel_stream_clear(obj);
+    bcg729_history_free(&obj->enc_hist);
+    bcg729_history_free(&obj->dec_hist);
+
+    /* Os contadores do canal passam para o total dos canais já destruídos */
+    bcg729_stats_add(&BCG729_G(retired_stats), &obj->stats);
+    if (obj->live_prev) {
+        obj->live_prev->live_next = obj->live_next;
+    } else {
+        BCG729_G(live_channels) = obj->live_next;
     }
-    if (obj->encoder) {
-        closeBcg729EncoderChannel(obj->encoder);
-        obj->encoder = NULL;
+    if (obj->live_next) {
+        obj->live_next->live_prev = obj->live_prev;
     }
+
     zend_object_std_dtor(&obj->std);
 }
 
+/* Contexto do decoder, criado sob demanda; NULL (com warning) se indisponível */
+static bcg729DecoderChannelContextStruct *bcg729_channel_decoder(bcg729Channel *self) {
+    if (!self->decoder) {
+        if (self->closed) {
+            php_error_docref(NULL, E_WARNING, "Decoder channel is closed or not initialized");
+            return NULL;
+        }
+        if (!(self->mode & BCG729_MODE_DECODE)) {
+            php_error_docref(NULL, E_WARNING, "Decoder is not available on an ENCODE_ONLY channel");
+            return NULL;
+        }
+        self->decoder = bcg729_pool_acquire(BCG729_POOL_DECODER);
+        bcg729_history_init(&self->dec_hist, BCG729_HIST_DEC_ITEM);
+    }
+    return self->decoder;
+}
+
+/* Contexto do encoder, criado sob demanda; NULL (com warning) se indisponível */
+static bcg729EncoderChannelContextStruct *bcg729_channel_encoder(bcg729Channel *self) {
+    if (!self->encoder) {
+        if (self->closed) {
+            php_error_docref(NULL, E_WARNING, "Encoder channel is closed or not initialized");
+            return NULL;
+        }
+        if (!(self->mode & BCG729_MODE_ENCODE)) {
+            php_error_docref(NULL, E_WARNING, "Encoder is not available on a DECODE_ONLY channel");
+            return NULL;
+        }
+        self->encoder = bcg729_pool_acquire(bcg729_channel_encoder_kind(self));
+        bcg729_history_init(&self->enc_hist, BCG729_HIST_PCM_ITEM);
+    }
+    return self->encoder;
+}
+
+/* Heap em uso pelo processo (glibc); 0 quando não há como medir */
+static size_t bcg729_heap_in_use(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo mi = mallinfo();
+    return (size_t) (unsigned int) mi.uordblks + (size_t) (unsigned int) mi.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/*
+ * As estruturas de contexto da libbcg729 são opacas e incluem
+ * sub-alocações (CNG, VAD, DTX), então sizeof não serve: mede-se a
+ * variação do heap ao criar um contexto de cada tipo.
+ */
+static size_t bcg729_measure_ctx(int kind) {
+    size_t before = bcg729_heap_in_use(), after;
+
+    if (kind == 0) {
+        bcg729DecoderChannelContextStruct *ctx = initBcg729DecoderChannel();
+        after = bcg729_heap_in_use();
+        closeBcg729DecoderChannel(ctx);
+    } else {
+        bcg729EncoderChannelContextStruct *ctx = initBcg729EncoderChannel(kind == 2);
+        after = bcg729_heap_in_use();
+        closeBcg729EncoderChannel(ctx);
+    }
+
+    return after > before ? after - before : 0;
+}
+
+static void bcg729_ctx_sizes_init(void) {
+    bcg729_decoder_ctx_bytes = bcg729_measure_ctx(0);
+    bcg729_encoder_ctx_bytes = bcg729_measure_ctx(1);
+    bcg729_encoder_vad_ctx_bytes = bcg729_measure_ctx(2);
+}
+
 /* ------------------------------------------------------------------------- */
 /*                TABELAS ALAW / ULAW                                        */
 /* ------------------------------------------------------------------------- */
@@ -119,587 +512,6784 @@ static const int16_t ulaw_to_linear[256] = {
     56, 48, 40, 32, 24, 16, 8, 0
 };
 
+/* ------------------------------------------------------------------------- */
+/*    Kernels SIMD: byte-swap 16-bit e decode G.711, com dispatch no MINIT   */
+/* ------------------------------------------------------------------------- */
 
+/*
+ * As versões escalares são a referência; as variantes SSE2/SSSE3/AVX2 dão
+ * resultado bit a bit idêntico. O decode G.711 vetorial não usa a tabela:
+ * expande o código pela fórmula fechada (sinal, expoente, mantissa), e o
+ * deslocamento variável vira multiplicação por 2^n (pshufb) ou uma escada
+ * de shifts condicionais no SSE2 puro.
+ */
 
+typedef void (*bcg729_swap16_fn)(unsigned char *dst, const unsigned char *src, size_t len);
+typedef void (*bcg729_g711_decode_fn)(int16_t *dst, const unsigned char *src, size_t samples);
+typedef void (*bcg729_mac_q12_fn)(int32_t *acc, const int16_t *src, int16_t gain, size_t samples);
 
-ZEND_FUNCTION(resampler)
-{
-    zend_string *input;
-    zend_long src_rate, dst_rate;
-    zend_bool to_be = 0;
+/* Estatísticas de um frame PCM (analyzePcm / bcg729Analyzer) */
+typedef struct {
+    uint64_t energy;     /* soma dos quadrados */
+    int32_t peak;        /* maior |x| (até 32768) */
+    uint32_t crossings;  /* trocas de sinal, incluindo a fronteira com o frame anterior */
+    uint32_t clipped;    /* amostras em ±fundo de escala */
+} bcg729FrameStats;
 
-    ZEND_PARSE_PARAMETERS_START(3, 4)
-        Z_PARAM_STR(input)
-        Z_PARAM_LONG(src_rate)
-        Z_PARAM_LONG(dst_rate)
-        Z_PARAM_OPTIONAL
-        Z_PARAM_BOOL(to_be)
-    ZEND_PARSE_PARAMETERS_END();
+typedef void (*bcg729_frame_stats_fn)(const int16_t *x, size_t n, int16_t prev, bcg729FrameStats *st);
 
-    if (ZSTR_LEN(input) < 2 || src_rate <= 0 || dst_rate <= 0) {
-        RETURN_EMPTY_STRING();
+static void bcg729_swap16_scalar(unsigned char *dst, const unsigned char *src, size_t len) {
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        unsigned char lo = src[i];
+        dst[i]     = src[i + 1];
+        dst[i + 1] = lo;
     }
+}
 
-    const int16_t *pcm_in = (const int16_t *)ZSTR_VAL(input);
-    size_t samples_in = ZSTR_LEN(input) / 2;
-    double ratio = (double)dst_rate / (double)src_rate;
-    size_t samples_out = (size_t)ceil(samples_in * ratio);
-
-    smart_string result = {0};
-    smart_string_alloc(&result, samples_out * 2, 0);
+static void bcg729_alaw_decode_scalar(int16_t *dst, const unsigned char *src, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = alaw_to_linear[src[i]];
+    }
+}
 
-    // 🧩 Cúbico + antialias
-    double src_pos = 0.0;
-    double src_step = 1.0 / ratio;
-    double last_dc = 0.0;
+static void bcg729_ulaw_decode_scalar(int16_t *dst, const unsigned char *src, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        dst[i] = ulaw_to_linear[src[i]];
+    }
+}
 
-    unsigned char be[2];
-    for (size_t i = 0; i < samples_out; i++) {
-        double pos = src_pos;
-        size_t idx = (size_t)pos;
-        double frac = pos - idx;
+/* acc[i] += (src[i] × gain) >> 12, com gain em Q12 */
+static void bcg729_mac_q12_scalar(int32_t *acc, const int16_t *src, int16_t gain, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        acc[i] += ((int32_t) src[i] * gain) >> 12;
+    }
+}
 
-        // bordas seguras
-        int16_t y0 = (idx > 0) ? pcm_in[idx - 1] : pcm_in[idx];
-        int16_t y1 = pcm_in[idx];
-        int16_t y2 = (idx + 1 < samples_in) ? pcm_in[idx + 1] : pcm_in[idx];
-        int16_t y3 = (idx + 2 < samples_in) ? pcm_in[idx + 2] : y2;
+static void bcg729_frame_stats_scalar(const int16_t *x, size_t n, int16_t prev, bcg729FrameStats *st) {
+    uint64_t energy = 0;
+    int32_t peak = 0;
+    uint32_t crossings = 0, clipped = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = x[i];
+        int32_t a = v < 0 ? -v : v;
+        energy += (uint32_t) (v * v);
+        if (a > peak) {
+            peak = a;
+        }
+        crossings += (v < 0) != (prev < 0);
+        clipped += (a >= 32767);
+        prev = x[i];
+    }
 
-        // interpolação cúbica (Catmull–Rom)
-        double a0 = -0.5*y0 + 1.5*y1 - 1.5*y2 + 0.5*y3;
-        double a1 = y0 - 2.5*y1 + 2.0*y2 - 0.5*y3;
-        double a2 = -0.5*y0 + 0.5*y2;
-        double a3 = y1;
+    st->energy = energy;
+    st->peak = peak;
+    st->crossings = crossings;
+    st->clipped = clipped;
+}
 
-        double sample = ((a0*frac + a1)*frac + a2)*frac + a3;
+static bcg729_swap16_fn bcg729_swap16 = bcg729_swap16_scalar;
+static bcg729_g711_decode_fn bcg729_alaw_decode = bcg729_alaw_decode_scalar;
+static bcg729_g711_decode_fn bcg729_ulaw_decode = bcg729_ulaw_decode_scalar;
+static bcg729_mac_q12_fn bcg729_mac_q12 = bcg729_mac_q12_scalar;
+static bcg729_frame_stats_fn bcg729_frame_stats = bcg729_frame_stats_scalar;
+static const char *bcg729_simd_level = "scalar";
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BCG729_X86_DISPATCH 1
+#include <immintrin.h>
+
+#define BCG729_TARGET(t) __attribute__((target(t)))
+
+/* A-law: 0x55 alternado, sinal 1 = positivo, base << (exp - 1) */
+
+BCG729_TARGET("sse2")
+static inline __m128i bcg729_alaw8_sse2(__m128i a) {
+    const __m128i k55 = _mm_set1_epi16(0x55), k80 = _mm_set1_epi16(0x80);
+    const __m128i k0f = _mm_set1_epi16(0x0F), k07 = _mm_set1_epi16(0x07);
+    const __m128i k1 = _mm_set1_epi16(1), k2 = _mm_set1_epi16(2), k4 = _mm_set1_epi16(4);
+    const __m128i zero = _mm_setzero_si128();
+
+    a = _mm_xor_si128(a, k55);
+    __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(a, k80), zero);
+    __m128i exp = _mm_and_si128(_mm_srli_epi16(a, 4), k07);
+    __m128i has_exp = _mm_cmpgt_epi16(exp, zero);
+    __m128i val = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(a, k0f), 4), _mm_set1_epi16(8));
+    val = _mm_add_epi16(val, _mm_and_si128(has_exp, _mm_set1_epi16(0x100)));
+    __m128i shift = _mm_subs_epu16(exp, k1);
+    __m128i m;
+
+    m = _mm_cmpeq_epi16(_mm_and_si128(shift, k1), k1);
+    val = _mm_or_si128(_mm_andnot_si128(m, val), _mm_and_si128(m, _mm_slli_epi16(val, 1)));
+    m = _mm_cmpeq_epi16(_mm_and_si128(shift, k2), k2);
+    val = _mm_or_si128(_mm_andnot_si128(m, val), _mm_and_si128(m, _mm_slli_epi16(val, 2)));
+    m = _mm_cmpeq_epi16(_mm_and_si128(shift, k4), k4);
+    val = _mm_or_si128(_mm_andnot_si128(m, val), _mm_and_si128(m, _mm_slli_epi16(val, 4)));
+
+    return _mm_sub_epi16(_mm_xor_si128(val, neg), neg);
+}
 
-        // 🧽 antialias DC (remove "metal raspando")
-        last_dc = 0.999 * last_dc + 0.001 * sample;
-        sample -= last_dc;
+/* μ-law: bits invertidos, sinal 1 = negativo, ((mant << 3) + 0x84) << exp - 0x84 */
+BCG729_TARGET("sse2")
+static inline __m128i bcg729_ulaw8_sse2(__m128i u) {
+    const __m128i kff = _mm_set1_epi16(0xFF), k80 = _mm_set1_epi16(0x80);
+    const __m128i k0f = _mm_set1_epi16(0x0F), k07 = _mm_set1_epi16(0x07), k84 = _mm_set1_epi16(0x84);
+    const __m128i k1 = _mm_set1_epi16(1), k2 = _mm_set1_epi16(2), k4 = _mm_set1_epi16(4);
+
+    u = _mm_xor_si128(u, kff);
+    __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(u, k80), k80);
+    __m128i exp = _mm_and_si128(_mm_srli_epi16(u, 4), k07);
+    __m128i val = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, k0f), 3), k84);
+    __m128i m;
+
+    m = _mm_cmpeq_epi16(_mm_and_si128(exp, k1), k1);
+    val = _mm_or_si128(_mm_andnot_si128(m, val), _mm_and_si128(m, _mm_slli_epi16(val, 1)));
+    m = _mm_cmpeq_epi16(_mm_and_si128(exp, k2), k2);
+    val = _mm_or_si128(_mm_andnot_si128(m, val), _mm_and_si128(m, _mm_slli_epi16(val, 2)));
+    m = _mm_cmpeq_epi16(_mm_and_si128(exp, k4), k4);
+    val = _mm_or_si128(_mm_andnot_si128(m, val), _mm_and_si128(m, _mm_slli_epi16(val, 4)));
+    val = _mm_sub_epi16(val, k84);
+
+    return _mm_sub_epi16(_mm_xor_si128(val, neg), neg);
+}
 
-        // clamp
-        if (sample > 32767.0) sample = 32767.0;
-        if (sample < -32768.0) sample = -32768.0;
-        int16_t out = (int16_t)lrint(sample);
+BCG729_TARGET("sse2")
+static void bcg729_swap16_sse2(unsigned char *dst, const unsigned char *src, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *) (dst + i), v);
+    }
+    bcg729_swap16_scalar(dst + i, src + i, len - i);
+}
 
-        if (to_be) {
-            be[0] = (out >> 8) & 0xFF;
-            be[1] = out & 0xFF;
-            smart_string_appendl(&result, (char *)be, 2);
-        } else {
-            smart_string_appendl(&result, (char *)&out, 2);
-        }
+BCG729_TARGET("sse2")
+static void bcg729_alaw_decode_sse2(int16_t *dst, const unsigned char *src, size_t samples) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), bcg729_alaw8_sse2(_mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128((__m128i *) (dst + i + 8), bcg729_alaw8_sse2(_mm_unpackhi_epi8(v, zero)));
+    }
+    bcg729_alaw_decode_scalar(dst + i, src + i, samples - i);
+}
 
-        src_pos += src_step;
+BCG729_TARGET("sse2")
+static void bcg729_ulaw_decode_sse2(int16_t *dst, const unsigned char *src, size_t samples) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), bcg729_ulaw8_sse2(_mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128((__m128i *) (dst + i + 8), bcg729_ulaw8_sse2(_mm_unpackhi_epi8(v, zero)));
     }
+    bcg729_ulaw_decode_scalar(dst + i, src + i, samples - i);
+}
 
-    smart_string_0(&result);
-    RETVAL_STRINGL(result.c, result.len);
-    smart_string_free(&result);
+/* SSSE3: pshufb faz o swap e também a tabela 2^exp do decode */
+BCG729_TARGET("ssse3")
+static void bcg729_swap16_ssse3(unsigned char *dst, const unsigned char *src, size_t len) {
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    bcg729_swap16_scalar(dst + i, src + i, len - i);
 }
 
+BCG729_TARGET("ssse3")
+static inline __m128i bcg729_alaw8_ssse3(__m128i a) {
+    const __m128i pow2 = _mm_setr_epi8(1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i hi_zero = _mm_set1_epi16((short) 0x8000);
+    const __m128i zero = _mm_setzero_si128();
 
-/* ─────────────────────────────
- *   Arginfo
- * ───────────────────────────── */
-ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resampler, 0, 3, IS_STRING, 0)
-    ZEND_ARG_TYPE_INFO(0, input, IS_STRING, 0)
-    ZEND_ARG_TYPE_INFO(0, src_rate, IS_LONG, 0)
-    ZEND_ARG_TYPE_INFO(0, dst_rate, IS_LONG, 0)
-    ZEND_ARG_TYPE_INFO(0, to_be, _IS_BOOL, 0)
-ZEND_END_ARG_INFO()
+    a = _mm_xor_si128(a, _mm_set1_epi16(0x55));
+    __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(a, _mm_set1_epi16(0x80)), zero);
+    __m128i exp = _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi16(0x07));
+    __m128i val = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(a, _mm_set1_epi16(0x0F)), 4), _mm_set1_epi16(8));
+    val = _mm_add_epi16(val, _mm_and_si128(_mm_cmpgt_epi16(exp, zero), _mm_set1_epi16(0x100)));
+    val = _mm_mullo_epi16(val, _mm_shuffle_epi8(pow2, _mm_or_si128(exp, hi_zero)));
 
+    return _mm_sub_epi16(_mm_xor_si128(val, neg), neg);
+}
 
+BCG729_TARGET("ssse3")
+static inline __m128i bcg729_ulaw8_ssse3(__m128i u) {
+    const __m128i pow2 = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char) 128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i hi_zero = _mm_set1_epi16((short) 0x8000);
+    const __m128i k80 = _mm_set1_epi16(0x80), k84 = _mm_set1_epi16(0x84);
 
+    u = _mm_xor_si128(u, _mm_set1_epi16(0xFF));
+    __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(u, k80), k80);
+    __m128i exp = _mm_and_si128(_mm_srli_epi16(u, 4), _mm_set1_epi16(0x07));
+    __m128i val = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(u, _mm_set1_epi16(0x0F)), 3), k84);
+    val = _mm_sub_epi16(_mm_mullo_epi16(val, _mm_shuffle_epi8(pow2, _mm_or_si128(exp, hi_zero))), k84);
 
+    return _mm_sub_epi16(_mm_xor_si128(val, neg), neg);
+}
 
+BCG729_TARGET("ssse3")
+static void bcg729_alaw_decode_ssse3(int16_t *dst, const unsigned char *src, size_t samples) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), bcg729_alaw8_ssse3(_mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128((__m128i *) (dst + i + 8), bcg729_alaw8_ssse3(_mm_unpackhi_epi8(v, zero)));
+    }
+    bcg729_alaw_decode_scalar(dst + i, src + i, samples - i);
+}
 
+BCG729_TARGET("ssse3")
+static void bcg729_ulaw_decode_ssse3(int16_t *dst, const unsigned char *src, size_t samples) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i), bcg729_ulaw8_ssse3(_mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128((__m128i *) (dst + i + 8), bcg729_ulaw8_ssse3(_mm_unpackhi_epi8(v, zero)));
+    }
+    bcg729_ulaw_decode_scalar(dst + i, src + i, samples - i);
+}
 
-/* ------------------------------------------------------------------------- */
-/*    decodePcmaToPcm: A-law -> PCM 16-bit little-endian                      */
-/* ------------------------------------------------------------------------- */
+/* AVX2: mesma lógica do SSSE3 em 16 amostras por registrador */
+BCG729_TARGET("avx2")
+static void bcg729_swap16_avx2(unsigned char *dst, const unsigned char *src, size_t len) {
+    const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_shuffle_epi8(v, mask));
+    }
+    bcg729_swap16_ssse3(dst + i, src + i, len - i);
+}
 
-ZEND_FUNCTION(decodePcmaToPcm) {
-    zend_string *input;
+BCG729_TARGET("avx2")
+static void bcg729_alaw_decode_avx2(int16_t *dst, const unsigned char *src, size_t samples) {
+    const __m256i pow2 = _mm256_setr_epi8(1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0,
+                                          1, 1, 2, 4, 8, 16, 32, 64, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i hi_zero = _mm256_set1_epi16((short) 0x8000);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+        a = _mm256_xor_si256(a, _mm256_set1_epi16(0x55));
+        __m256i neg = _mm256_cmpeq_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x80)), zero);
+        __m256i exp = _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi16(0x07));
+        __m256i val = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(a, _mm256_set1_epi16(0x0F)), 4), _mm256_set1_epi16(8));
+        val = _mm256_add_epi16(val, _mm256_and_si256(_mm256_cmpgt_epi16(exp, zero), _mm256_set1_epi16(0x100)));
+        val = _mm256_mullo_epi16(val, _mm256_shuffle_epi8(pow2, _mm256_or_si256(exp, hi_zero)));
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_sub_epi16(_mm256_xor_si256(val, neg), neg));
+    }
+    bcg729_alaw_decode_ssse3(dst + i, src + i, samples - i);
+}
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+BCG729_TARGET("avx2")
+static void bcg729_ulaw_decode_avx2(int16_t *dst, const unsigned char *src, size_t samples) {
+    const __m256i pow2 = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char) 128, 0, 0, 0, 0, 0, 0, 0, 0,
+                                          1, 2, 4, 8, 16, 32, 64, (char) 128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i hi_zero = _mm256_set1_epi16((short) 0x8000);
+    const __m256i k80 = _mm256_set1_epi16(0x80), k84 = _mm256_set1_epi16(0x84);
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        __m256i u = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+        u = _mm256_xor_si256(u, _mm256_set1_epi16(0xFF));
+        __m256i neg = _mm256_cmpeq_epi16(_mm256_and_si256(u, k80), k80);
+        __m256i exp = _mm256_and_si256(_mm256_srli_epi16(u, 4), _mm256_set1_epi16(0x07));
+        __m256i val = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(u, _mm256_set1_epi16(0x0F)), 3), k84);
+        val = _mm256_sub_epi16(_mm256_mullo_epi16(val, _mm256_shuffle_epi8(pow2, _mm256_or_si256(exp, hi_zero))), k84);
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_sub_epi16(_mm256_xor_si256(val, neg), neg));
+    }
+    bcg729_ulaw_decode_ssse3(dst + i, src + i, samples - i);
+}
 
-    size_t samples = ZSTR_LEN(input);
-    if (samples == 0) {
-        RETURN_EMPTY_STRING();
+/* 16×16 → 32 bits: mullo/mulhi reconstituem o produto completo antes do shift */
+BCG729_TARGET("sse2")
+static void bcg729_mac_q12_sse2(int32_t *acc, const int16_t *src, int16_t gain, size_t samples) {
+    const __m128i g = _mm_set1_epi16(gain);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i lo = _mm_mullo_epi16(v, g), hi = _mm_mulhi_epi16(v, g);
+        __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 12);
+        __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 12);
+        _mm_storeu_si128((__m128i *) (acc + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (acc + i)), p0));
+        _mm_storeu_si128((__m128i *) (acc + i + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (acc + i + 4)), p1));
     }
+    bcg729_mac_q12_scalar(acc + i, src + i, gain, samples - i);
+}
 
-    zend_string *out = zend_string_alloc(samples * 2, 0);
-    int16_t *dst = (int16_t *) ZSTR_VAL(out);
-    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+BCG729_TARGET("avx2")
+static void bcg729_mac_q12_avx2(int32_t *acc, const int16_t *src, int16_t gain, size_t samples) {
+    const __m256i g = _mm256_set1_epi32(gain);
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (src + i)));
+        __m256i p = _mm256_srai_epi32(_mm256_mullo_epi32(v, g), 12);
+        _mm256_storeu_si256((__m256i *) (acc + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (acc + i)), p));
+    }
+    bcg729_mac_q12_scalar(acc + i, src + i, gain, samples - i);
+}
 
-    for (size_t i = 0; i < samples; i++) {
-        dst[i] = alaw_to_linear[src[i]];
+/*
+ * Energia via pmaddwd (a soma de dois quadrados cabe em uint32, então é
+ * estendida sem sinal para 64 bits), pico via max/min, e trocas de sinal
+ * pelo bit 15 de x[i] ^ x[i-1]. Contadores de 16 bits por lane bastam
+ * para frames de até BCG729_ANALYZE_MAX_FRAME amostras.
+ */
+BCG729_TARGET("sse2")
+static void bcg729_frame_stats_sse2(const int16_t *x, size_t n, int16_t prev, bcg729FrameStats *st) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i hi = _mm_set1_epi16(32766), lo = _mm_set1_epi16(-32766);
+    __m128i energy = zero, vmax = zero, vmin = zero, cross = zero, clip = zero;
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (x + i));
+        __m128i pv = i == 0
+            ? _mm_insert_epi16(_mm_slli_si128(v, 2), prev, 0)
+            : _mm_loadu_si128((const __m128i *) (x + i - 1));
+        __m128i sq = _mm_madd_epi16(v, v);
+
+        energy = _mm_add_epi64(energy, _mm_unpacklo_epi32(sq, zero));
+        energy = _mm_add_epi64(energy, _mm_unpackhi_epi32(sq, zero));
+        vmax = _mm_max_epi16(vmax, v);
+        vmin = _mm_min_epi16(vmin, v);
+        cross = _mm_sub_epi16(cross, _mm_srai_epi16(_mm_xor_si128(v, pv), 15));
+        clip = _mm_sub_epi16(clip, _mm_or_si128(_mm_cmpgt_epi16(v, hi), _mm_cmplt_epi16(v, lo)));
     }
 
-    ZSTR_VAL(out)[samples * 2] = '\0';
-    RETURN_STR(out);
+    int16_t mx[8], mn[8];
+    uint16_t cr[8], cl[8];
+    uint64_t en[2];
+    _mm_storeu_si128((__m128i *) mx, vmax);
+    _mm_storeu_si128((__m128i *) mn, vmin);
+    _mm_storeu_si128((__m128i *) cr, cross);
+    _mm_storeu_si128((__m128i *) cl, clip);
+    _mm_storeu_si128((__m128i *) en, energy);
+
+    bcg729FrameStats tail;
+    bcg729_frame_stats_scalar(x + i, n - i, i > 0 ? x[i - 1] : prev, &tail);
+
+    st->energy = en[0] + en[1] + tail.energy;
+    st->peak = tail.peak;
+    st->crossings = tail.crossings;
+    st->clipped = tail.clipped;
+    for (int k = 0; k < 8; k++) {
+        if (mx[k] > st->peak) {
+            st->peak = mx[k];
+        }
+        if (-(int32_t) mn[k] > st->peak) {
+            st->peak = -(int32_t) mn[k];
+        }
+        st->crossings += cr[k];
+        st->clipped += cl[k];
+    }
+}
+#endif
+
+static void bcg729_simd_init(void) {
+#ifdef BCG729_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        bcg729_swap16 = bcg729_swap16_avx2;
+        bcg729_alaw_decode = bcg729_alaw_decode_avx2;
+        bcg729_ulaw_decode = bcg729_ulaw_decode_avx2;
+        bcg729_mac_q12 = bcg729_mac_q12_avx2;
+        bcg729_frame_stats = bcg729_frame_stats_sse2;
+        bcg729_simd_level = "avx2";
+    } else if (__builtin_cpu_supports("ssse3")) {
+        bcg729_swap16 = bcg729_swap16_ssse3;
+        bcg729_alaw_decode = bcg729_alaw_decode_ssse3;
+        bcg729_ulaw_decode = bcg729_ulaw_decode_ssse3;
+        bcg729_mac_q12 = bcg729_mac_q12_sse2;
+        bcg729_frame_stats = bcg729_frame_stats_sse2;
+        bcg729_simd_level = "ssse3";
+    } else if (__builtin_cpu_supports("sse2")) {
+        bcg729_swap16 = bcg729_swap16_sse2;
+        bcg729_alaw_decode = bcg729_alaw_decode_sse2;
+        bcg729_ulaw_decode = bcg729_ulaw_decode_sse2;
+        bcg729_mac_q12 = bcg729_mac_q12_sse2;
+        bcg729_frame_stats = bcg729_frame_stats_sse2;
+        bcg729_simd_level = "sse2";
+    }
+#endif
 }
 
+
+
+
 /* ------------------------------------------------------------------------- */
-/*    pcmLeToBe: PCM little-endian -> big-endian (network order)             */
+/*    Classe bcg729Resampler: resampler com estado entre chamadas            */
 /* ------------------------------------------------------------------------- */
 
-ZEND_FUNCTION(pcmLeToBe)
-{
-    zend_string *input;
+/*
+ * Resampler polyphase com filtro windowed-sinc (janela de Kaiser).
+ * A razão dst/src é reduzida para up/down e o filtro protótipo tem
+ * up * taps coeficientes, guardados por fase e em ordem reversa para que
+ * cada amostra de saída seja um produto escalar contíguo. As tabelas são
+ * calculadas uma vez por razão e compartilhadas entre todos os objetos.
+ *
+ * O objeto guarda as últimas (taps - 1) amostras de entrada, a fase
+ * fracionária e o estado do removedor de DC, então o resultado independe
+ * de como o áudio foi fatiado em pacotes.
+ */
+
+#define BCG729_RESAMPLER_BASE_TAPS   24
+#define BCG729_RESAMPLER_MAX_FACTOR  1024
+#define BCG729_RESAMPLER_KAISER_BETA 7.0
+#define BCG729_RESAMPLER_ROLLOFF     0.92
+
+typedef struct _bcg729ResamplerFilter {
+    uint32_t up;
+    uint32_t down;
+    uint32_t taps;       /* taps por fase */
+    float *coeffs;       /* up * taps, fase por fase, ordem reversa */
+    struct _bcg729ResamplerFilter *next;
+} bcg729ResamplerFilter;
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+typedef struct {
+    const bcg729ResamplerFilter *filter;
+    int16_t *buf;        /* histórico (taps - 1) + bloco atual */
+    size_t buf_cap;      /* em amostras */
+    size_t pos;          /* índice em buf da amostra mais nova da próxima saída */
+    uint32_t phase;      /* fase fracionária, 0 .. up - 1 */
+    double last_dc;
+    zend_long src_rate;
+    zend_long dst_rate;
+    zend_object std;
+} bcg729Resampler;
 
-    size_t len = ZSTR_LEN(input);
-    if (len < 2 || (len & 1) != 0) {
-        RETURN_EMPTY_STRING();
-    }
+#define Z_BCG729_RESAMPLER_P(zv)  ((bcg729Resampler *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729Resampler, std)))
 
-    zend_string *out = zend_string_alloc(len, 0);
-    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
-    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+static zend_class_entry *bcg729_resampler_ce;
+static zend_object_handlers bcg729_resampler_handlers;
 
-    for (size_t i = 0; i < len; i += 2) {
-        dst[i]     = src[i + 1];
-        dst[i + 1] = src[i];
+static double bcg729_bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        double h = x / (2.0 * k);
+        term *= h * h;
+        sum += term;
+        if (term < sum * 1e-12) break;
     }
+    return sum;
+}
 
-    dst[len] = '\0';
-    RETURN_STR(out);
+/* Protótipo passa-baixas na taxa "up * src": corte fc em ciclos por amostra
+ * de entrada, janela de Kaiser centrada em center com meia largura halfwidth */
+static void bcg729_windowed_sinc(double *h, size_t n, double center, double halfwidth, uint32_t up, double fc) {
+    double norm = bcg729_bessel_i0(BCG729_RESAMPLER_KAISER_BETA);
+
+    for (size_t k = 0; k < n; k++) {
+        double t = ((double) k - center) / (double) up;
+        double x = 2.0 * fc * t;
+        double sinc = (fabs(x) < 1e-12) ? 1.0 : sin(M_PI * x) / (M_PI * x);
+        double r = halfwidth > 0 ? ((double) k - center) / halfwidth : 0.0;
+        double w = bcg729_bessel_i0(BCG729_RESAMPLER_KAISER_BETA * sqrt(fmax(0.0, 1.0 - r * r))) / norm;
+        h[k] = 2.0 * fc * sinc * w;
+    }
 }
 
-/* ------------------------------------------------------------------------- */
-/*    decodePcmuToPcm: μ-law -> PCM 16-bit little-endian                      */
-/* ------------------------------------------------------------------------- */
+static uint32_t bcg729_gcd(uint32_t a, uint32_t b) {
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
 
-ZEND_FUNCTION(decodePcmuToPcm) {
-    zend_string *input;
+static const bcg729ResamplerFilter *bcg729_resampler_filter_get(uint32_t up, uint32_t down) {
+    bcg729ResamplerFilter *f;
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+    for (f = BCG729_G(resampler_filters); f; f = f->next) {
+        if (f->up == up && f->down == down) {
+            return f;
+        }
+    }
 
-    size_t samples = ZSTR_LEN(input);
-    if (samples == 0) {
-        RETURN_EMPTY_STRING();
+    /* no downsampling o corte cai para o Nyquist de saída: mais taps
+     * mantêm a mesma banda de transição relativa */
+    uint32_t taps = BCG729_RESAMPLER_BASE_TAPS * (down > up ? (down + up - 1) / up : 1);
+    size_t n = (size_t) taps * up;
+    double fc = 0.5 * (up < down ? (double) up / (double) down : 1.0) * BCG729_RESAMPLER_ROLLOFF;
+    double center = (double) (n - 1) / 2.0;
+    double *proto = (double *) safe_pemalloc(n, sizeof(double), 0, 1);
+
+    bcg729_windowed_sinc(proto, n, center, center, up, fc);
+
+    f = (bcg729ResamplerFilter *) pemalloc(sizeof(bcg729ResamplerFilter), 1);
+    f->up = up;
+    f->down = down;
+    f->taps = taps;
+    f->coeffs = (float *) safe_pemalloc(n, sizeof(float), 0, 1);
+
+    /* cada fase normalizada para ganho DC unitário */
+    for (uint32_t p = 0; p < up; p++) {
+        double sum = 0.0;
+        for (uint32_t j = 0; j < taps; j++) {
+            sum += proto[p + (size_t) j * up];
+        }
+        for (uint32_t j = 0; j < taps; j++) {
+            f->coeffs[(size_t) p * taps + (taps - 1 - j)] = (float) (proto[p + (size_t) j * up] / sum);
+        }
     }
+    pefree(proto, 1);
 
-    zend_string *out = zend_string_alloc(samples * 2, 0);
-    int16_t *dst = (int16_t *) ZSTR_VAL(out);
-    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+    f->next = BCG729_G(resampler_filters);
+    BCG729_G(resampler_filters) = f;
+    return f;
+}
 
-    for (size_t i = 0; i < samples; i++) {
-        dst[i] = ulaw_to_linear[src[i]];
+static void bcg729_resampler_filters_free(bcg729ResamplerFilter *f) {
+    while (f) {
+        bcg729ResamplerFilter *next = f->next;
+        pefree(f->coeffs, 1);
+        pefree(f, 1);
+        f = next;
     }
+}
 
-    ZSTR_VAL(out)[samples * 2] = '\0';
-    RETURN_STR(out);
+static void bcg729_resampler_reset_state(bcg729Resampler *r) {
+    uint32_t hist = r->filter->taps - 1;
+    memset(r->buf, 0, hist * sizeof(int16_t));
+    r->pos = hist;
+    r->phase = 0;
+    r->last_dc = 0.0;
 }
 
-/* ------------------------------------------------------------------------- */
-/*      Funções auxiliares linear2alaw / linear2ulaw                          */
-/* ------------------------------------------------------------------------- */
+/* Processa um bloco (pode ser vazio) e escreve direto em out. Retorna o
+ * número de amostras escritas; out precisa de espaço para
+ * bcg729_resampler_max_out(). */
+static size_t bcg729_resampler_run(bcg729Resampler *r, const int16_t *in, size_t samples_in, unsigned char *out, zend_bool to_be) {
+    const bcg729ResamplerFilter *f = r->filter;
+    uint32_t taps = f->taps;
+    size_t hist = taps - 1;
+    size_t total = hist + samples_in;
+
+    if (total > r->buf_cap) {
+        r->buf = (int16_t *) safe_erealloc(r->buf, total, sizeof(int16_t), 0);
+        r->buf_cap = total;
+    }
+    if (samples_in) {
+        memcpy(r->buf + hist, in, samples_in * sizeof(int16_t));
+    }
 
-static int searchSegment(int val, const int16_t *seg_end, int seg_count) {
-    for (int i = 0; i < seg_count; i++) {
-        if (val <= seg_end[i]) return i;
+    size_t pos = r->pos;
+    uint32_t phase = r->phase;
+    double last_dc = r->last_dc;
+    size_t written = 0;
+
+    while (pos < total) {
+        const float *c = f->coeffs + (size_t) phase * taps;
+        const int16_t *x = r->buf + pos - hist;
+        float acc = 0.0f;
+
+        for (uint32_t k = 0; k < taps; k++) {
+            acc += c[k] * (float) x[k];
+        }
+
+        double sample = acc;
+        last_dc = 0.999 * last_dc + 0.001 * sample;
+        sample -= last_dc;
+
+        if (sample > 32767.0) sample = 32767.0;
+        if (sample < -32768.0) sample = -32768.0;
+        int16_t s = (int16_t) lrint(sample);
+
+        if (to_be) {
+            out[0] = (unsigned char) ((s >> 8) & 0xFF);
+            out[1] = (unsigned char) (s & 0xFF);
+        } else {
+            memcpy(out, &s, 2);
+        }
+        out += 2;
+        written++;
+
+        phase += f->down;
+        pos += phase / f->up;
+        phase %= f->up;
     }
-    return seg_count;
+
+    /* preserva o histórico para o próximo bloco */
+    memmove(r->buf, r->buf + total - hist, hist * sizeof(int16_t));
+    r->pos = pos - (total - hist);
+    r->phase = phase;
+    r->last_dc = last_dc;
+
+    return written;
 }
 
-static int linear2alaw(int pcm_val) {
-    static const int16_t seg_end[8] = {0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF};
-    int mask;
-    int seg;
-    int aval;
+static size_t bcg729_resampler_max_out(const bcg729Resampler *r, size_t samples_in) {
+    const bcg729ResamplerFilter *f = r->filter;
+    return ((samples_in + 1) * f->up) / f->down + 2;
+}
 
-    pcm_val >>= 3;
+static zend_object *bcg729_resampler_create(zend_class_entry *ce) {
+    bcg729Resampler *obj = zend_object_alloc(sizeof(bcg729Resampler), ce);
 
-    if (pcm_val >= 0) {
-        mask = 0xD5;
-    } else {
-        mask = 0x55;
-        pcm_val = -pcm_val - 1;
-    }
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_resampler_handlers;
 
-    seg = searchSegment(pcm_val, seg_end, 8);
-    if (seg >= 8) return (0x7F ^ mask);
+    return &obj->std;
+}
 
-    aval = (seg << 4);
-    if (seg < 2) {
-        aval |= (pcm_val >> 1) & 0x0F;
-    } else {
-        aval |= (pcm_val >> seg) & 0x0F;
+static void bcg729_resampler_free(zend_object *object) {
+    bcg729Resampler *obj = (bcg729Resampler *) ((char *) object - XtOffsetOf(bcg729Resampler, std));
+    if (obj->buf) {
+        efree(obj->buf);
+        obj->buf = NULL;
     }
+    zend_object_std_dtor(&obj->std);
+}
 
-    return aval ^ mask;
+static bcg729Resampler *bcg729_resampler_fetch(zval *zv) {
+    bcg729Resampler *self = Z_BCG729_RESAMPLER_P(zv);
+    if (!self->filter) {
+        zend_throw_error(NULL, "bcg729Resampler was not initialized");
+        return NULL;
+    }
+    return self;
 }
 
-static int linear2ulaw(int pcm_val) {
-    static const int16_t seg_end[8] = {0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF, 0x3FFF, 0x7FFF};
-    int mask;
-    int seg;
-    int uval;
+ZEND_METHOD(bcg729Resampler, __construct) {
+    zend_long src_rate, dst_rate;
 
-    if (pcm_val < 0) {
-        pcm_val = 0x84 - pcm_val;
-        mask = 0x7F;
-    } else {
-        pcm_val += 0x84;
-        mask = 0xFF;
+    ZEND_PARSE_PARAMETERS_START(2, 2)
+        Z_PARAM_LONG(src_rate)
+        Z_PARAM_LONG(dst_rate)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (src_rate <= 0 || src_rate > 384000) {
+        zend_argument_value_error(1, "must be between 1 and 384000");
+        RETURN_THROWS();
+    }
+    if (dst_rate <= 0 || dst_rate > 384000) {
+        zend_argument_value_error(2, "must be between 1 and 384000");
+        RETURN_THROWS();
     }
 
-    seg = searchSegment(pcm_val, seg_end, 8);
-    if (seg >= 8) return (0x7F ^ mask);
+    uint32_t g = bcg729_gcd((uint32_t) src_rate, (uint32_t) dst_rate);
+    uint32_t up = (uint32_t) dst_rate / g;
+    uint32_t down = (uint32_t) src_rate / g;
 
-    uval = (seg << 4) | ((pcm_val >> (seg + 3)) & 0x0F);
-    return uval ^ mask;
-}
+    if (up > BCG729_RESAMPLER_MAX_FACTOR || down > BCG729_RESAMPLER_MAX_FACTOR) {
+        zend_value_error("Unsupported rate ratio " ZEND_LONG_FMT ":" ZEND_LONG_FMT, src_rate, dst_rate);
+        RETURN_THROWS();
+    }
 
-/* ------------------------------------------------------------------------- */
-/*    encodePcmToPcma: PCM 16-bit -> A-law                                    */
-/* ------------------------------------------------------------------------- */
+    bcg729Resampler *self = Z_BCG729_RESAMPLER_P(getThis());
+    self->filter = bcg729_resampler_filter_get(up, down);
+    self->src_rate = src_rate;
+    self->dst_rate = dst_rate;
 
-ZEND_FUNCTION(encodePcmToPcma) {
+    size_t cap = self->filter->taps + 320;
+    self->buf = (int16_t *) safe_erealloc(self->buf, cap, sizeof(int16_t), 0);
+    self->buf_cap = cap;
+    bcg729_resampler_reset_state(self);
+}
+
+ZEND_METHOD(bcg729Resampler, process) {
     zend_string *input;
+    zend_bool to_be = 0;
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
+    ZEND_PARSE_PARAMETERS_START(1, 2)
         Z_PARAM_STR(input)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(to_be)
     ZEND_PARSE_PARAMETERS_END();
 
+    bcg729Resampler *self = bcg729_resampler_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+
     size_t len = ZSTR_LEN(input);
-    if (len < 2 || (len & 1) != 0) {
+    if ((len & 1) != 0) {
+        php_error_docref(NULL, E_WARNING, "PCM input length must be a multiple of 2");
+        RETURN_FALSE;
+    }
+    if (len == 0) {
         RETURN_EMPTY_STRING();
     }
 
-    size_t num_samples = len / 2;
-    zend_string *out = zend_string_alloc(num_samples, 0);
-    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
-    const int16_t *src = (const int16_t *) ZSTR_VAL(input);
+    size_t samples_in = len / 2;
+    size_t max_out = bcg729_resampler_max_out(self, samples_in);
+    zend_string *out = zend_string_safe_alloc(max_out, 2, 0, 0);
 
-    for (size_t i = 0; i < num_samples; i++) {
-        dst[i] = (unsigned char) linear2alaw(src[i]);
+    size_t written = bcg729_resampler_run(self, (const int16_t *) ZSTR_VAL(input), samples_in,
+                                          (unsigned char *) ZSTR_VAL(out), to_be);
+
+    ZSTR_LEN(out) = written * 2;
+    ZSTR_VAL(out)[written * 2] = '\0';
+    RETURN_STR(out);
+}
+
+ZEND_METHOD(bcg729Resampler, flush) {
+    zend_bool to_be = 0;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(to_be)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Resampler *self = bcg729_resampler_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
     }
 
-    dst[num_samples] = '\0';
+    /* empurra metade do filtro em silêncio para liberar o atraso de grupo */
+    size_t pad = self->filter->taps / 2;
+    int16_t *zeros = (int16_t *) ecalloc(pad, sizeof(int16_t));
+    size_t max_out = bcg729_resampler_max_out(self, pad);
+    zend_string *out = zend_string_safe_alloc(max_out, 2, 0, 0);
+
+    size_t written = bcg729_resampler_run(self, zeros, pad, (unsigned char *) ZSTR_VAL(out), to_be);
+    efree(zeros);
+    bcg729_resampler_reset_state(self);
+
+    ZSTR_LEN(out) = written * 2;
+    ZSTR_VAL(out)[written * 2] = '\0';
     RETURN_STR(out);
 }
 
+ZEND_METHOD(bcg729Resampler, reset) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729Resampler *self = bcg729_resampler_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    bcg729_resampler_reset_state(self);
+}
+
+ZEND_METHOD(bcg729Resampler, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729Resampler *self = bcg729_resampler_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+
+    array_init(return_value);
+    add_assoc_long(return_value, "src_rate", self->src_rate);
+    add_assoc_long(return_value, "dst_rate", self->dst_rate);
+    add_assoc_long(return_value, "up", self->filter->up);
+    add_assoc_long(return_value, "down", self->filter->down);
+    add_assoc_long(return_value, "taps_per_phase", self->filter->taps);
+    add_assoc_long(return_value, "delay_samples", (self->filter->taps - 1) / 2);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_resampler_construct, 0, 0, 2)
+    ZEND_ARG_TYPE_INFO(0, src_rate, IS_LONG, 0)
+    ZEND_ARG_TYPE_INFO(0, dst_rate, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_resampler_process, 0, 1, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, input, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, to_be, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resampler_flush, 0, 0, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, to_be, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resampler_reset, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resampler_info, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry bcg729_resampler_methods[] = {
+    ZEND_ME(bcg729Resampler, __construct, arginfo_resampler_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729Resampler, process,     arginfo_resampler_process,   ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Resampler, flush,       arginfo_resampler_flush,     ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Resampler, reset,       arginfo_resampler_reset,     ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Resampler, info,        arginfo_resampler_info,      ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
+
 /* ------------------------------------------------------------------------- */
-/*    encodePcmToPcmu: PCM 16-bit -> μ-law                                    */
+/*    resampler(): kernels Q15 para razões inteiras                          */
 /* ------------------------------------------------------------------------- */
 
-ZEND_FUNCTION(encodePcmToPcmu) {
-    zend_string *input;
+/*
+ * Caminho rápido para as razões usadas em VoIP/WebRTC. O filtro é o mesmo
+ * windowed-sinc do bcg729Resampler, quantizado em Q15 com o atraso de
+ * grupo compensado (saída alinhada à entrada, como no caminho genérico).
+ * No upsampling o corte fica exatamente no Nyquist de entrada, então a
+ * fase 0 é identidade e vira cópia direta.
+ *
+ * Dois estágios por bloco de até BCG729_Q15_BLOCK saídas: o FIR escreve
+ * int32 já na escala de 16 bits, e o emit tira o DC, satura e grava na
+ * ordem de bytes pedida. O removedor de DC é atualizado a cada 8 saídas
+ * (mesma constante de tempo de 1024 amostras), o que tira a dependência
+ * amostra a amostra e deixa o emit vetorial. Os kernels escalar, SSE2 e
+ * AVX2 dão resultado bit a bit idêntico; a escolha é feita no MINIT.
+ */
+
+#define BCG729_Q15_TAPS 16   /* taps por fase; no downsampling, 16 * down */
+#define BCG729_Q15_MAX_COEFFS 96
+#define BCG729_Q15_BLOCK 384 /* saídas int32 por passada do emit */
+#define BCG729_Q15_SLACK 8   /* a transposta do 1:6 em AVX2 escreve 2 int32 além do bloco */
+#define BCG729_Q15_PAD 128   /* folga de cada lado da entrada (>= maior janela) */
+#define BCG729_Q15_STACK 2048
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+typedef struct {
+    zend_long src_rate;
+    zend_long dst_rate;
+    uint32_t up;
+    uint32_t down;
+    uint32_t taps;
+    BCG729_ALIGNED(32) int16_t coeffs[BCG729_Q15_MAX_COEFFS];
+} bcg729Q15Kernel;
+
+static bcg729Q15Kernel bcg729_q15_kernels[] = {
+    { 8000, 16000, 2, 1, BCG729_Q15_TAPS,     {0} },
+    { 16000, 8000, 1, 2, BCG729_Q15_TAPS * 2, {0} },
+    { 8000, 48000, 6, 1, BCG729_Q15_TAPS,     {0} },
+    { 48000, 8000, 1, 6, BCG729_Q15_TAPS * 6, {0} },
+};
 
-    size_t len = ZSTR_LEN(input);
-    if (len < 2 || (len & 1) != 0) {
-        RETURN_EMPTY_STRING();
+static void bcg729_q15_kernels_init(void) {
+    double proto[BCG729_Q15_MAX_COEFFS];
+
+    for (size_t i = 0; i < sizeof(bcg729_q15_kernels) / sizeof(bcg729_q15_kernels[0]); i++) {
+        bcg729Q15Kernel *k = &bcg729_q15_kernels[i];
+        size_t n = (size_t) k->taps * k->up;
+        double fc = (k->down > 1) ? 0.5 * BCG729_RESAMPLER_ROLLOFF / k->down : 0.5;
+        double center = (double) (k->taps / 2) * k->up;
+
+        bcg729_windowed_sinc(proto, n, center, center, k->up, fc);
+
+        /* no upsampling a fase 0 é identidade e não usa coeficientes */
+        for (uint32_t p = (k->up > 1) ? 1 : 0; p < k->up; p++) {
+            int16_t *c = k->coeffs + (size_t) p * k->taps;
+            double sum = 0.0;
+            int32_t qsum = 0;
+            uint32_t peak = 0;
+
+            for (uint32_t j = 0; j < k->taps; j++) {
+                sum += proto[p + (size_t) j * k->up];
+            }
+            for (uint32_t j = 0; j < k->taps; j++) {
+                double v = proto[p + (size_t) j * k->up] / sum * 32768.0;
+                c[k->taps - 1 - j] = (int16_t) lrint(v > 32767.0 ? 32767.0 : v);
+            }
+            for (uint32_t j = 0; j < k->taps; j++) {
+                qsum += c[j];
+                if (abs(c[j]) > abs(c[peak])) {
+                    peak = j;
+                }
+            }
+            /* ganho DC exato em Q15 */
+            c[peak] = (int16_t) (c[peak] + 32768 - qsum);
+        }
     }
+}
 
-    size_t num_samples = len / 2;
-    zend_string *out = zend_string_alloc(num_samples, 0);
-    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
-    const int16_t *src = (const int16_t *) ZSTR_VAL(input);
+static const bcg729Q15Kernel *bcg729_q15_kernel_find(zend_long src_rate, zend_long dst_rate) {
+    for (size_t i = 0; i < sizeof(bcg729_q15_kernels) / sizeof(bcg729_q15_kernels[0]); i++) {
+        if (bcg729_q15_kernels[i].src_rate == src_rate && bcg729_q15_kernels[i].dst_rate == dst_rate) {
+            return &bcg729_q15_kernels[i];
+        }
+    }
+    return NULL;
+}
 
-    for (size_t i = 0; i < num_samples; i++) {
-        dst[i] = (unsigned char) linear2ulaw(src[i]);
+/* up: blocks × 8 entradas a partir de in[i] -> saídas intercaladas por fase em y */
+typedef void (*bcg729_q15_up_fn)(const bcg729Q15Kernel *k, const int16_t *in, size_t i, size_t blocks, int32_t *y);
+/* down: count saídas; x aponta para a primeira janela, as seguintes andam down amostras */
+typedef void (*bcg729_q15_down_fn)(const bcg729Q15Kernel *k, const int16_t *x, size_t count, int32_t *y);
+/* emit: DC, saturação e ordem de bytes */
+typedef void (*bcg729_q15_emit_fn)(unsigned char *dst, const int32_t *y, size_t n, int64_t *dc, zend_bool to_be);
+
+static inline int32_t bcg729_dot_q15(const int16_t *c, const int16_t *x, uint32_t taps) {
+    int32_t sum = 0;
+    uint32_t k = 0;
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; k + 8 <= taps; k += 8) {
+        int16x8_t vc = vld1q_s16(c + k);
+        int16x8_t vx = vld1q_s16(x + k);
+        acc = vmlal_s16(acc, vget_low_s16(vc), vget_low_s16(vx));
+        acc = vmlal_s16(acc, vget_high_s16(vc), vget_high_s16(vx));
     }
+    sum = vaddvq_s32(acc);
+#endif
 
-    dst[num_samples] = '\0';
-    RETURN_STR(out);
+    for (; k < taps; k++) {
+        sum += (int32_t) c[k] * x[k];
+    }
+    return sum;
 }
 
-/* ------------------------------------------------------------------------- */
-/*    decodeL16ToPcm: L16 big-endian -> PCM little-endian                     */
-/* ------------------------------------------------------------------------- */
+static void bcg729_q15_up_scalar(const bcg729Q15Kernel *k, const int16_t *in, size_t i, size_t blocks, int32_t *y) {
+    ptrdiff_t lead = (ptrdiff_t) k->taps / 2 - 1;
 
-ZEND_FUNCTION(decodeL16ToPcm) {
-    zend_string *input;
+    for (size_t end = i + blocks * 8; i < end; i++) {
+        *y++ = in[i];
+        for (uint32_t p = 1; p < k->up; p++) {
+            *y++ = (bcg729_dot_q15(k->coeffs + (size_t) p * k->taps, in + i - lead, k->taps) + 16384) >> 15;
+        }
+    }
+}
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+static void bcg729_q15_down_scalar(const bcg729Q15Kernel *k, const int16_t *x, size_t count, int32_t *y) {
+    for (size_t n = 0; n < count; n++, x += k->down) {
+        y[n] = (bcg729_dot_q15(k->coeffs, x, k->taps) + 16384) >> 15;
+    }
+}
 
-    size_t len = ZSTR_LEN(input);
-    if (len < 2 || (len & 1) != 0) {
-        RETURN_EMPTY_STRING();
+/* Removedor de DC (Q14, 1/1024 por amostra) atualizado com a soma de m saídas */
+static inline int32_t bcg729_q15_dc_step(int64_t *dc, int64_t sum, size_t m) {
+    *dc += ((sum * 16384) - ((int64_t) m * *dc)) >> 10;
+    return (int32_t) ((*dc + 8192) >> 14);
+}
+
+static void bcg729_q15_emit_scalar(unsigned char *dst, const int32_t *y, size_t n, int64_t *dc, zend_bool to_be) {
+    for (size_t i = 0; i < n; i += 8) {
+        size_t m = n - i < 8 ? n - i : 8;
+        int64_t sum = 0;
+
+        for (size_t j = 0; j < m; j++) {
+            sum += y[i + j];
+        }
+        int32_t offset = bcg729_q15_dc_step(dc, sum, m);
+
+        for (size_t j = 0; j < m; j++, dst += 2) {
+            int32_t sample = y[i + j] - offset;
+
+            if (sample > 32767) sample = 32767;
+            if (sample < -32768) sample = -32768;
+
+            if (to_be) {
+                dst[0] = (unsigned char) ((sample >> 8) & 0xFF);
+                dst[1] = (unsigned char) (sample & 0xFF);
+            } else {
+                int16_t s = (int16_t) sample;
+                memcpy(dst, &s, 2);
+            }
+        }
     }
+}
 
-    zend_string *out = zend_string_alloc(len, 0);
-    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
-    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+static bcg729_q15_up_fn bcg729_q15_up = bcg729_q15_up_scalar;
+static bcg729_q15_down_fn bcg729_q15_down = bcg729_q15_down_scalar;
+static bcg729_q15_emit_fn bcg729_q15_emit = bcg729_q15_emit_scalar;
+
+#ifdef BCG729_X86_DISPATCH
+BCG729_TARGET("sse2")
+static void bcg729_q15_emit_sse2(unsigned char *dst, const int32_t *y, size_t n, int64_t *dc, zend_bool to_be) {
+    size_t i = 0;
 
-    for (size_t i = 0; i < len; i += 2) {
-        dst[i]     = src[i + 1];  /* low byte */
-        dst[i + 1] = src[i];      /* high byte */
+    for (; i + 8 <= n; i += 8, dst += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (y + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (y + i + 4));
+        __m128i s = _mm_add_epi32(a, b);
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        __m128i offset = _mm_set1_epi32(bcg729_q15_dc_step(dc, _mm_cvtsi128_si32(s), 8));
+        __m128i v = _mm_packs_epi32(_mm_sub_epi32(a, offset), _mm_sub_epi32(b, offset));
+        if (to_be) {
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        }
+        _mm_storeu_si128((__m128i *) dst, v);
     }
+    bcg729_q15_emit_scalar(dst, y + i, n - i, dc, to_be);
+}
 
-    dst[len] = '\0';
-    RETURN_STR(out);
+/* 8 saídas consecutivas de uma fase: pares de taps intercalados no pmaddwd */
+BCG729_TARGET("sse2")
+static inline void bcg729_q15_fir8_sse2(const int16_t *c, const int16_t *x, uint32_t taps, __m128i *lo, __m128i *hi) {
+    __m128i acc0 = _mm_set1_epi32(16384), acc1 = acc0;
+
+    for (uint32_t k = 0; k < taps; k += 2) {
+        __m128i x0 = _mm_loadu_si128((const __m128i *) (x + k));
+        __m128i x1 = _mm_loadu_si128((const __m128i *) (x + k + 1));
+        int32_t pair;
+        memcpy(&pair, c + k, sizeof(pair)); /* c[k] na metade baixa, c[k + 1] na alta */
+        __m128i cv = _mm_set1_epi32(pair);
+        acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(x0, x1), cv));
+        acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(x0, x1), cv));
+    }
+    *lo = _mm_srai_epi32(acc0, 15);
+    *hi = _mm_srai_epi32(acc1, 15);
 }
 
-/* ------------------------------------------------------------------------- */
-/*    encodePcmToL16: PCM little-endian -> L16 big-endian                     */
-/* ------------------------------------------------------------------------- */
+BCG729_TARGET("sse2")
+static void bcg729_q15_up_sse2(const bcg729Q15Kernel *k, const int16_t *in, size_t i, size_t blocks, int32_t *y) {
+    ptrdiff_t lead = (ptrdiff_t) k->taps / 2 - 1;
+
+    for (size_t b = 0; b < blocks; b++, i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (in + i));
+        __m128i sign = _mm_srai_epi16(x, 15);
+        __m128i p0lo = _mm_unpacklo_epi16(x, sign), p0hi = _mm_unpackhi_epi16(x, sign);
+
+        if (k->up == 2) {
+            __m128i lo, hi;
+            bcg729_q15_fir8_sse2(k->coeffs + k->taps, in + i - lead, k->taps, &lo, &hi);
+            _mm_storeu_si128((__m128i *) y, _mm_unpacklo_epi32(p0lo, lo));
+            _mm_storeu_si128((__m128i *) (y + 4), _mm_unpackhi_epi32(p0lo, lo));
+            _mm_storeu_si128((__m128i *) (y + 8), _mm_unpacklo_epi32(p0hi, hi));
+            _mm_storeu_si128((__m128i *) (y + 12), _mm_unpackhi_epi32(p0hi, hi));
+            y += 16;
+        } else {
+            BCG729_ALIGNED(16) int32_t phases[6][8];
+            _mm_store_si128((__m128i *) phases[0], p0lo);
+            _mm_store_si128((__m128i *) (phases[0] + 4), p0hi);
+            for (uint32_t p = 1; p < k->up; p++) {
+                __m128i lo, hi;
+                bcg729_q15_fir8_sse2(k->coeffs + (size_t) p * k->taps, in + i - lead, k->taps, &lo, &hi);
+                _mm_store_si128((__m128i *) phases[p], lo);
+                _mm_store_si128((__m128i *) (phases[p] + 4), hi);
+            }
+            for (int j = 0; j < 8; j++) {
+                for (uint32_t p = 0; p < k->up; p++) {
+                    *y++ = phases[p][j];
+                }
+            }
+        }
+    }
+}
 
-ZEND_FUNCTION(encodePcmToL16) {
-    zend_string *input;
+/* 4 produtos escalares por vez; a redução horizontal vira uma transposta 4x4 */
+BCG729_TARGET("sse2")
+static void bcg729_q15_down_sse2(const bcg729Q15Kernel *k, const int16_t *x, size_t count, int32_t *y) {
+    size_t n = 0, step = k->down;
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+    for (; n + 4 <= count; n += 4, x += 4 * step) {
+        __m128i a0 = _mm_setzero_si128(), a1 = a0, a2 = a0, a3 = a0;
+
+        for (uint32_t t = 0; t < k->taps; t += 8) {
+            __m128i c = _mm_load_si128((const __m128i *) (k->coeffs + t));
+            a0 = _mm_add_epi32(a0, _mm_madd_epi16(c, _mm_loadu_si128((const __m128i *) (x + t))));
+            a1 = _mm_add_epi32(a1, _mm_madd_epi16(c, _mm_loadu_si128((const __m128i *) (x + step + t))));
+            a2 = _mm_add_epi32(a2, _mm_madd_epi16(c, _mm_loadu_si128((const __m128i *) (x + 2 * step + t))));
+            a3 = _mm_add_epi32(a3, _mm_madd_epi16(c, _mm_loadu_si128((const __m128i *) (x + 3 * step + t))));
+        }
+        __m128i t0 = _mm_add_epi32(_mm_unpacklo_epi32(a0, a1), _mm_unpackhi_epi32(a0, a1));
+        __m128i t1 = _mm_add_epi32(_mm_unpacklo_epi32(a2, a3), _mm_unpackhi_epi32(a2, a3));
+        __m128i s = _mm_add_epi32(_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *) (y + n), _mm_srai_epi32(_mm_add_epi32(s, _mm_set1_epi32(16384)), 15));
+    }
+    bcg729_q15_down_scalar(k, x, count - n, y + n);
+}
+
+BCG729_TARGET("avx2")
+static void bcg729_q15_emit_avx2(unsigned char *dst, const int32_t *y, size_t n, int64_t *dc, zend_bool to_be) {
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16, dst += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (y + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (y + i + 8));
+        __m128i sa = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+        __m128i sb = _mm_add_epi32(_mm256_castsi256_si128(b), _mm256_extracti128_si256(b, 1));
+        sa = _mm_add_epi32(sa, _mm_shuffle_epi32(sa, _MM_SHUFFLE(1, 0, 3, 2)));
+        sa = _mm_add_epi32(sa, _mm_shuffle_epi32(sa, _MM_SHUFFLE(2, 3, 0, 1)));
+        sb = _mm_add_epi32(sb, _mm_shuffle_epi32(sb, _MM_SHUFFLE(1, 0, 3, 2)));
+        sb = _mm_add_epi32(sb, _mm_shuffle_epi32(sb, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        __m256i oa = _mm256_set1_epi32(bcg729_q15_dc_step(dc, _mm_cvtsi128_si32(sa), 8));
+        __m256i ob = _mm256_set1_epi32(bcg729_q15_dc_step(dc, _mm_cvtsi128_si32(sb), 8));
+        __m256i v = _mm256_packs_epi32(_mm256_sub_epi32(a, oa), _mm256_sub_epi32(b, ob));
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0)); /* packs intercala por lane */
+        if (to_be) {
+            v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+        }
+        _mm256_storeu_si256((__m256i *) dst, v);
+    }
+    bcg729_q15_emit_sse2(dst, y + i, n - i, dc, to_be);
+}
+
+/*
+ * 16 entradas por vez com todas as fases no mesmo laço: os pares de
+ * amostras intercalados são os mesmos em todas as fases, só o par de
+ * coeficientes muda. Por lane, lo = entradas 0-3 e 8-11, hi = 4-7 e 12-15.
+ */
+BCG729_TARGET("avx2")
+static inline __attribute__((always_inline)) void bcg729_q15_up16_avx2(const bcg729Q15Kernel *k, const int16_t *x, const uint32_t up, __m256i *lo, __m256i *hi) {
+    for (uint32_t p = 1; p < up; p++) {
+        lo[p] = hi[p] = _mm256_set1_epi32(16384);
+    }
+    for (uint32_t t = 0; t < k->taps; t += 2) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *) (x + t));
+        __m256i x1 = _mm256_loadu_si256((const __m256i *) (x + t + 1));
+        __m256i pl = _mm256_unpacklo_epi16(x0, x1), ph = _mm256_unpackhi_epi16(x0, x1);
+
+        for (uint32_t p = 1; p < up; p++) {
+            int32_t pair;
+            memcpy(&pair, k->coeffs + (size_t) p * k->taps + t, sizeof(pair));
+            __m256i cv = _mm256_set1_epi32(pair);
+            lo[p] = _mm256_add_epi32(lo[p], _mm256_madd_epi16(pl, cv));
+            hi[p] = _mm256_add_epi32(hi[p], _mm256_madd_epi16(ph, cv));
+        }
+    }
+    for (uint32_t p = 1; p < up; p++) {
+        lo[p] = _mm256_srai_epi32(lo[p], 15);
+        hi[p] = _mm256_srai_epi32(hi[p], 15);
+    }
+}
+
+BCG729_TARGET("avx2")
+static inline __attribute__((always_inline)) void bcg729_q15_up_avx2_n(const bcg729Q15Kernel *k, const int16_t *in, size_t i, size_t blocks, int32_t *y, const uint32_t up) {
+    ptrdiff_t lead = (ptrdiff_t) k->taps / 2 - 1;
+    size_t b = 0;
+
+    for (; b + 2 <= blocks; b += 2, i += 16) {
+        __m256i lo[6], hi[6];
+        __m128i x = _mm_loadu_si128((const __m128i *) (in + i));
+        __m128i x8 = _mm_loadu_si128((const __m128i *) (in + i + 8));
+
+        /* fase 0 é a própria entrada, no mesmo arranjo por lane */
+        lo[0] = _mm256_cvtepi16_epi32(_mm_unpacklo_epi64(x, x8));
+        hi[0] = _mm256_cvtepi16_epi32(_mm_unpackhi_epi64(x, x8));
+        bcg729_q15_up16_avx2(k, in + i - lead, up, lo, hi);
+
+        if (up == 2) {
+            __m256i a = _mm256_unpacklo_epi32(lo[0], lo[1]), c = _mm256_unpackhi_epi32(lo[0], lo[1]);
+            __m256i d = _mm256_unpacklo_epi32(hi[0], hi[1]), e = _mm256_unpackhi_epi32(hi[0], hi[1]);
+            _mm256_storeu_si256((__m256i *) y, _mm256_permute2x128_si256(a, c, 0x20));
+            _mm256_storeu_si256((__m256i *) (y + 8), _mm256_permute2x128_si256(d, e, 0x20));
+            _mm256_storeu_si256((__m256i *) (y + 16), _mm256_permute2x128_si256(a, c, 0x31));
+            _mm256_storeu_si256((__m256i *) (y + 24), _mm256_permute2x128_si256(d, e, 0x31));
+            y += 32;
+            continue;
+        }
+
+        /* 1:6: transposta 8x8 com as fases 6 e 7 zeradas */
+        __m256i rows[2][4][2];
+        for (int h = 0; h < 2; h++) {
+            __m256i *v = h ? hi : lo;
+            __m256i z = _mm256_setzero_si256();
+            __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]), t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+            __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]), t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+            __m256i t4 = _mm256_unpacklo_epi32(v[4], v[5]), t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+
+            /* linha j: fases 0-3 e 4-5 da entrada j (lane 0) e j + 8 (lane 1) */
+            rows[h][0][0] = _mm256_unpacklo_epi64(t0, t2);
+            rows[h][1][0] = _mm256_unpackhi_epi64(t0, t2);
+            rows[h][2][0] = _mm256_unpacklo_epi64(t1, t3);
+            rows[h][3][0] = _mm256_unpackhi_epi64(t1, t3);
+            rows[h][0][1] = _mm256_unpacklo_epi64(t4, z);
+            rows[h][1][1] = _mm256_unpackhi_epi64(t4, z);
+            rows[h][2][1] = _mm256_unpacklo_epi64(t5, z);
+            rows[h][3][1] = _mm256_unpackhi_epi64(t5, z);
+        }
+        /* em ordem crescente de endereço: cada store cobre os 2 zeros do anterior */
+        for (int h = 0; h < 2; h++) {
+            for (int j = 0; j < 4; j++) {
+                _mm256_storeu_si256((__m256i *) (y + (h * 4 + j) * 6), _mm256_permute2x128_si256(rows[h][j][0], rows[h][j][1], 0x20));
+            }
+        }
+        for (int h = 0; h < 2; h++) {
+            for (int j = 0; j < 4; j++) {
+                _mm256_storeu_si256((__m256i *) (y + (8 + h * 4 + j) * 6), _mm256_permute2x128_si256(rows[h][j][0], rows[h][j][1], 0x31));
+            }
+        }
+        y += 16 * 6;
+    }
+    if (b < blocks) {
+        bcg729_q15_up_sse2(k, in, i, blocks - b, y);
+    }
+}
+
+BCG729_TARGET("avx2")
+static void bcg729_q15_up_avx2(const bcg729Q15Kernel *k, const int16_t *in, size_t i, size_t blocks, int32_t *y) {
+    if (k->up == 2) {
+        bcg729_q15_up_avx2_n(k, in, i, blocks, y, 2);
+    } else {
+        bcg729_q15_up_avx2_n(k, in, i, blocks, y, 6);
+    }
+}
+
+BCG729_TARGET("avx2")
+static void bcg729_q15_down_avx2(const bcg729Q15Kernel *k, const int16_t *x, size_t count, int32_t *y) {
+    size_t n = 0, step = k->down;
+
+    for (; n + 4 <= count; n += 4, x += 4 * step) {
+        __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+
+        for (uint32_t t = 0; t < k->taps; t += 16) {
+            __m256i c = _mm256_load_si256((const __m256i *) (k->coeffs + t));
+            a0 = _mm256_add_epi32(a0, _mm256_madd_epi16(c, _mm256_loadu_si256((const __m256i *) (x + t))));
+            a1 = _mm256_add_epi32(a1, _mm256_madd_epi16(c, _mm256_loadu_si256((const __m256i *) (x + step + t))));
+            a2 = _mm256_add_epi32(a2, _mm256_madd_epi16(c, _mm256_loadu_si256((const __m256i *) (x + 2 * step + t))));
+            a3 = _mm256_add_epi32(a3, _mm256_madd_epi16(c, _mm256_loadu_si256((const __m256i *) (x + 3 * step + t))));
+        }
+        __m128i b0 = _mm_add_epi32(_mm256_castsi256_si128(a0), _mm256_extracti128_si256(a0, 1));
+        __m128i b1 = _mm_add_epi32(_mm256_castsi256_si128(a1), _mm256_extracti128_si256(a1, 1));
+        __m128i b2 = _mm_add_epi32(_mm256_castsi256_si128(a2), _mm256_extracti128_si256(a2, 1));
+        __m128i b3 = _mm_add_epi32(_mm256_castsi256_si128(a3), _mm256_extracti128_si256(a3, 1));
+        __m128i t0 = _mm_add_epi32(_mm_unpacklo_epi32(b0, b1), _mm_unpackhi_epi32(b0, b1));
+        __m128i t1 = _mm_add_epi32(_mm_unpacklo_epi32(b2, b3), _mm_unpackhi_epi32(b2, b3));
+        __m128i s = _mm_add_epi32(_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i *) (y + n), _mm_srai_epi32(_mm_add_epi32(s, _mm_set1_epi32(16384)), 15));
+    }
+    bcg729_q15_down_scalar(k, x, count - n, y + n);
+}
+#endif
+
+/* Mesmo critério de bcg729_simd_init() (e também desligado por bcg729.simd = 0) */
+static void bcg729_q15_simd_init(void) {
+#ifdef BCG729_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        bcg729_q15_up = bcg729_q15_up_avx2;
+        bcg729_q15_down = bcg729_q15_down_avx2;
+        bcg729_q15_emit = bcg729_q15_emit_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        bcg729_q15_up = bcg729_q15_up_sse2;
+        bcg729_q15_down = bcg729_q15_down_sse2;
+        bcg729_q15_emit = bcg729_q15_emit_sse2;
+    }
+#endif
+}
+
+/*
+ * A entrada é copiada com as bordas grampeadas (como no caminho genérico)
+ * para um buffer com BCG729_Q15_PAD amostras de folga de cada lado: toda
+ * saída passa pelos kernels de bloco, inclusive nas pontas do pacote.
+ */
+static void bcg729_resample_q15(const bcg729Q15Kernel *k, const int16_t *in, size_t samples_in, unsigned char *dst, size_t samples_out, zend_bool to_be) {
+    BCG729_ALIGNED(32) int32_t y[BCG729_Q15_BLOCK + BCG729_Q15_SLACK];
+    int16_t stack[BCG729_Q15_STACK + 2 * BCG729_Q15_PAD];
+    int16_t *buf = samples_in <= BCG729_Q15_STACK ? stack : safe_emalloc(samples_in + 2 * BCG729_Q15_PAD, sizeof(int16_t), 0);
+    const int16_t *x = buf + BCG729_Q15_PAD;
+    ptrdiff_t lead = (ptrdiff_t) k->taps / 2 - 1;
+    int64_t dc = 0;
+
+    /* só a parte da folga que as janelas (e os grupos de 8/16) alcançam */
+    for (size_t i = BCG729_Q15_PAD - (k->taps + 16); i < BCG729_Q15_PAD; i++) {
+        buf[i] = in[0];
+    }
+    for (size_t i = 0; i < k->taps + 16; i++) {
+        buf[BCG729_Q15_PAD + samples_in + i] = in[samples_in - 1];
+    }
+    memcpy(buf + BCG729_Q15_PAD, in, samples_in * sizeof(int16_t));
+
+    for (size_t n = 0; n < samples_out;) {
+        size_t filled;
+
+        if (k->down == 1) {
+            /* blocos de 8 entradas; o último pode passar do fim e é cortado no emit */
+            size_t blocks = (samples_out - n + (8 * k->up) - 1) / (8 * k->up);
+            if (blocks > BCG729_Q15_BLOCK / (8 * k->up)) {
+                blocks = BCG729_Q15_BLOCK / (8 * k->up);
+            }
+            bcg729_q15_up(k, x, n / k->up, blocks, y);
+            filled = blocks * 8 * k->up;
+        } else {
+            filled = (samples_out - n + 3) & ~(size_t) 3;
+            if (filled > BCG729_Q15_BLOCK) {
+                filled = BCG729_Q15_BLOCK;
+            }
+            bcg729_q15_down(k, x + (ptrdiff_t) (n * k->down) - lead, filled, y);
+        }
+
+        if (filled > samples_out - n) {
+            filled = samples_out - n;
+        }
+        bcg729_q15_emit(dst, y, filled, &dc, to_be);
+        dst += filled * 2;
+        n += filled;
+    }
+
+    if (buf != stack) {
+        efree(buf);
+    }
+}
+
+ZEND_FUNCTION(resampler)
+{
+    zend_string *input;
+    zend_long src_rate, dst_rate;
+    zend_bool to_be = 0;
+
+    ZEND_PARSE_PARAMETERS_START(3, 4)
+        Z_PARAM_STR(input)
+        Z_PARAM_LONG(src_rate)
+        Z_PARAM_LONG(dst_rate)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(to_be)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (ZSTR_LEN(input) < 2 || src_rate <= 0 || dst_rate <= 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    const int16_t *pcm_in = (const int16_t *)ZSTR_VAL(input);
+    size_t samples_in = ZSTR_LEN(input) / 2;
+    double ratio = (double)dst_rate / (double)src_rate;
+    size_t samples_out = (size_t)ceil(samples_in * ratio);
+
+    zend_string *result = zend_string_safe_alloc(samples_out, 2, 0, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(result);
+
+    // ⚡ razões inteiras conhecidas: FIR Q15
+    const bcg729Q15Kernel *kernel = bcg729_q15_kernel_find(src_rate, dst_rate);
+    if (kernel) {
+        bcg729_resample_q15(kernel, pcm_in, samples_in, dst, samples_out, to_be);
+        ZSTR_VAL(result)[samples_out * 2] = '\0';
+        RETURN_STR(result);
+    }
+
+    // 🧩 Cúbico + antialias
+    double src_pos = 0.0;
+    double src_step = 1.0 / ratio;
+    double last_dc = 0.0;
+
+    for (size_t i = 0; i < samples_out; i++) {
+        double pos = src_pos;
+        size_t idx = (size_t)pos;
+        double frac = pos - idx;
+
+        // bordas seguras
+        int16_t y0 = (idx > 0) ? pcm_in[idx - 1] : pcm_in[idx];
+        int16_t y1 = pcm_in[idx];
+        int16_t y2 = (idx + 1 < samples_in) ? pcm_in[idx + 1] : pcm_in[idx];
+        int16_t y3 = (idx + 2 < samples_in) ? pcm_in[idx + 2] : y2;
+
+        // interpolação cúbica (Catmull–Rom)
+        double a0 = -0.5*y0 + 1.5*y1 - 1.5*y2 + 0.5*y3;
+        double a1 = y0 - 2.5*y1 + 2.0*y2 - 0.5*y3;
+        double a2 = -0.5*y0 + 0.5*y2;
+        double a3 = y1;
+
+        double sample = ((a0*frac + a1)*frac + a2)*frac + a3;
+
+        // 🧽 antialias DC (remove "metal raspando")
+        last_dc = 0.999 * last_dc + 0.001 * sample;
+        sample -= last_dc;
+
+        // clamp
+        if (sample > 32767.0) sample = 32767.0;
+        if (sample < -32768.0) sample = -32768.0;
+        int16_t out = (int16_t)lrint(sample);
+
+        if (to_be) {
+            dst[0] = (out >> 8) & 0xFF;
+            dst[1] = out & 0xFF;
+        } else {
+            memcpy(dst, &out, 2);
+        }
+        dst += 2;
+
+        src_pos += src_step;
+    }
+
+    ZSTR_VAL(result)[samples_out * 2] = '\0';
+    RETURN_STR(result);
+}
+
+
+/* ─────────────────────────────
+ *   Arginfo
+ * ───────────────────────────── */
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_resampler, 0, 3, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, input, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, src_rate, IS_LONG, 0)
+    ZEND_ARG_TYPE_INFO(0, dst_rate, IS_LONG, 0)
+    ZEND_ARG_TYPE_INFO(0, to_be, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+
+
+
+
+
+
+/* ------------------------------------------------------------------------- */
+/*    decodePcmaToPcm: A-law -> PCM 16-bit little-endian                      */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(decodePcmaToPcm) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t samples = ZSTR_LEN(input);
+    if (samples == 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    zend_string *out = zend_string_alloc(samples * 2, 0);
+    int16_t *dst = (int16_t *) ZSTR_VAL(out);
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+
+    bcg729_alaw_decode(dst, src, samples);
+
+    ZSTR_VAL(out)[samples * 2] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    pcmLeToBe: PCM little-endian -> big-endian (network order)             */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(pcmLeToBe)
+{
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    if (len < 2 || (len & 1) != 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    zend_string *out = zend_string_alloc(len, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+
+    bcg729_swap16(dst, src, len);
+
+    dst[len] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    decodePcmuToPcm: μ-law -> PCM 16-bit little-endian                      */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(decodePcmuToPcm) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t samples = ZSTR_LEN(input);
+    if (samples == 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    zend_string *out = zend_string_alloc(samples * 2, 0);
+    int16_t *dst = (int16_t *) ZSTR_VAL(out);
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+
+    bcg729_ulaw_decode(dst, src, samples);
+
+    ZSTR_VAL(out)[samples * 2] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*      Funções auxiliares linear2alaw / linear2ulaw                          */
+/* ------------------------------------------------------------------------- */
+
+static int searchSegment(int val, const int16_t *seg_end, int seg_count) {
+    for (int i = 0; i < seg_count; i++) {
+        if (val <= seg_end[i]) return i;
+    }
+    return seg_count;
+}
+
+static int linear2alaw(int pcm_val) {
+    static const int16_t seg_end[8] = {0x1F, 0x3F, 0x7F, 0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF};
+    int mask;
+    int seg;
+    int aval;
+
+    pcm_val >>= 3;
+
+    if (pcm_val >= 0) {
+        mask = 0xD5;
+    } else {
+        mask = 0x55;
+        pcm_val = -pcm_val - 1;
+    }
+
+    seg = searchSegment(pcm_val, seg_end, 8);
+    if (seg >= 8) return (0x7F ^ mask);
+
+    aval = (seg << 4);
+    if (seg < 2) {
+        aval |= (pcm_val >> 1) & 0x0F;
+    } else {
+        aval |= (pcm_val >> seg) & 0x0F;
+    }
+
+    return aval ^ mask;
+}
+
+static int linear2ulaw(int pcm_val) {
+    static const int16_t seg_end[8] = {0xFF, 0x1FF, 0x3FF, 0x7FF, 0xFFF, 0x1FFF, 0x3FFF, 0x7FFF};
+    int mask;
+    int seg;
+    int uval;
+
+    if (pcm_val < 0) {
+        pcm_val = 0x84 - pcm_val;
+        mask = 0x7F;
+    } else {
+        pcm_val += 0x84;
+        mask = 0xFF;
+    }
+
+    seg = searchSegment(pcm_val, seg_end, 8);
+    if (seg >= 8) return (0x7F ^ mask);
+
+    uval = (seg << 4) | ((pcm_val >> (seg + 3)) & 0x0F);
+    return uval ^ mask;
+}
+
+/*
+ * Tabelas de encode com 64K entradas, indexadas pela amostra vista como
+ * uint16_t. São preenchidas uma vez no MINIT a partir de linear2alaw /
+ * linear2ulaw, então o encode vira um load por amostra sem desvios.
+ */
+static uint8_t linear_to_alaw[65536];
+static uint8_t linear_to_ulaw[65536];
+
+/* Transcodificação direta A-law <-> μ-law (decode + encode compostos) */
+static uint8_t alaw_to_ulaw[256];
+static uint8_t ulaw_to_alaw[256];
+
+static void bcg729_g711_tables_init(void) {
+    for (uint32_t i = 0; i < 65536; i++) {
+        int16_t pcm = (int16_t) (uint16_t) i;
+        linear_to_alaw[i] = (uint8_t) linear2alaw(pcm);
+        linear_to_ulaw[i] = (uint8_t) linear2ulaw(pcm);
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        alaw_to_ulaw[i] = linear_to_ulaw[(uint16_t) alaw_to_linear[i]];
+        ulaw_to_alaw[i] = linear_to_alaw[(uint16_t) ulaw_to_linear[i]];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/*    encodePcmToPcma: PCM 16-bit -> A-law                                    */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(encodePcmToPcma) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    if (len < 2 || (len & 1) != 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    size_t num_samples = len / 2;
+    zend_string *out = zend_string_alloc(num_samples, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
+    const int16_t *src = (const int16_t *) ZSTR_VAL(input);
+
+    for (size_t i = 0; i < num_samples; i++) {
+        dst[i] = linear_to_alaw[(uint16_t) src[i]];
+    }
+
+    dst[num_samples] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    encodePcmToPcmu: PCM 16-bit -> μ-law                                    */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(encodePcmToPcmu) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    if (len < 2 || (len & 1) != 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    size_t num_samples = len / 2;
+    zend_string *out = zend_string_alloc(num_samples, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
+    const int16_t *src = (const int16_t *) ZSTR_VAL(input);
+
+    for (size_t i = 0; i < num_samples; i++) {
+        dst[i] = linear_to_ulaw[(uint16_t) src[i]];
+    }
+
+    dst[num_samples] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    transcodePcmaToPcmu / transcodePcmuToPcma: G.711 <-> G.711              */
+/* ------------------------------------------------------------------------- */
+
+static void bcg729_g711_transcode(INTERNAL_FUNCTION_PARAMETERS, const uint8_t *table) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    if (len == 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    zend_string *out = zend_string_alloc(len, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = table[src[i]];
+    }
+
+    dst[len] = '\0';
+    RETURN_STR(out);
+}
+
+ZEND_FUNCTION(transcodePcmaToPcmu) {
+    bcg729_g711_transcode(INTERNAL_FUNCTION_PARAM_PASSTHRU, alaw_to_ulaw);
+}
+
+ZEND_FUNCTION(transcodePcmuToPcma) {
+    bcg729_g711_transcode(INTERNAL_FUNCTION_PARAM_PASSTHRU, ulaw_to_alaw);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    decodeL16ToPcm: L16 big-endian -> PCM little-endian                     */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(decodeL16ToPcm) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    if (len < 2 || (len & 1) != 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    zend_string *out = zend_string_alloc(len, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+
+    bcg729_swap16(dst, src, len);
+
+    dst[len] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    encodePcmToL16: PCM little-endian -> L16 big-endian                     */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(encodePcmToL16) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    if (len < 2 || (len & 1) != 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    zend_string *out = zend_string_alloc(len, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+
+    bcg729_swap16(dst, src, len);
+
+    dst[len] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    mixAudioChannels: mix de vários canais PCM 16-bit                       */
+/* ------------------------------------------------------------------------- */
+
+ZEND_FUNCTION(mixAudioChannels) {
+    zval *channels_array;
+    zend_long sample_rate = 8000;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_ARRAY(channels_array)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(sample_rate)
+    ZEND_PARSE_PARAMETERS_END();
+
+    HashTable *channels = Z_ARRVAL_P(channels_array);
+    uint32_t num_channels = zend_hash_num_elements(channels);
+
+    if (num_channels == 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    if (num_channels == 1) {
+        zval *first = zend_hash_index_find(channels, 0);
+        if (!first) {
+            first = zend_hash_get_current_data(channels);
+        }
+        if (first && Z_TYPE_P(first) == IS_STRING) {
+            RETURN_STR_COPY(Z_STR_P(first));
+        }
+        RETURN_EMPTY_STRING();
+    }
+
+    /* Descobre o número máximo de samples entre todos os canais */
+    size_t max_samples = 0;
+    zval *channel_data;
+
+    ZEND_HASH_FOREACH_VAL(channels, channel_data) {
+        if (Z_TYPE_P(channel_data) != IS_STRING) {
+            continue;
+        }
+        size_t len = Z_STRLEN_P(channel_data);
+        if ((len & 1) != 0) {
+            php_error_docref(NULL, E_WARNING, "Canal de áudio com tamanho inválido (deve ser múltiplo de 2)");
+            RETURN_FALSE;
+        }
+        size_t samples = len / 2;
+        if (samples > max_samples) {
+            max_samples = samples;
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    if (max_samples == 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    int32_t *mix_buffer = (int32_t *) ecalloc(max_samples, sizeof(int32_t));
+    if (!mix_buffer) {
+        php_error_docref(NULL, E_ERROR, "Falha ao alocar memória para mixagem");
+        RETURN_FALSE; /* ecalloc falhando já é fim de mundo de qualquer jeito */
+    }
+
+    uint32_t active_channels = 0;
+
+    ZEND_HASH_FOREACH_VAL(channels, channel_data) {
+        if (Z_TYPE_P(channel_data) != IS_STRING) {
+            continue;
+        }
+
+        const int16_t *samples = (const int16_t *) Z_STRVAL_P(channel_data);
+        size_t num_samples = Z_STRLEN_P(channel_data) / 2;
+
+        for (size_t i = 0; i < num_samples; i++) {
+            mix_buffer[i] += samples[i];
+        }
+        active_channels++;
+    } ZEND_HASH_FOREACH_END();
+
+    if (active_channels == 0) {
+        efree(mix_buffer);
+        RETURN_EMPTY_STRING();
+    }
+
+    size_t out_bytes = max_samples * 2;
+    zend_string *out = zend_string_alloc(out_bytes, 0);
+    int16_t *dst = (int16_t *) ZSTR_VAL(out);
+
+    double mix_factor = 1.0 / sqrt((double) active_channels);
+
+    for (size_t i = 0; i < max_samples; i++) {
+        int32_t mixed = (int32_t) (mix_buffer[i] * mix_factor);
+        int16_t output;
+        if (mixed > 32767) {
+            output = 32767;
+        } else if (mixed < -32768) {
+            output = -32768;
+        } else {
+            output = (int16_t) mixed;
+        }
+        dst[i] = output;
+    }
+
+    efree(mix_buffer);
+
+    ZSTR_VAL(out)[out_bytes] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    Classe bcg729Mixer: conferência com mix-minus (N-1)                     */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Cada tick soma todas as entradas uma única vez num acumulador int32
+ * reutilizado; a saída de cada participante é o total menos a própria
+ * entrada (mix-minus), então o custo é O(N) e não O(N²).
+ *
+ * Em vez do 1/sqrt(n) fixo do mixAudioChannels, cada saída tem o seu
+ * limitador: o ganho cai na hora quando o pico do bloco passa do fundo de
+ * escala (rampa linear dentro do bloco), volta em ~250 ms, e o que ainda
+ * sobra acima do joelho é comprimido por uma curva racional que nunca
+ * passa de 32767.
+ */
+
+#define BCG729_MIXER_KNEE       24576.0f
+#define BCG729_MIXER_RELEASE_MS 250.0
+#define BCG729_MIXER_MAX_FRAME  9600
+
+typedef struct {
+    float gain;                  /* ganho atual do limitador desta saída */
+    const int16_t *in;           /* entrada do tick atual (aponta para a string do chamador) */
+    size_t in_samples;
+} bcg729MixerPart;
+
+typedef struct {
+    zend_long frame_samples;
+    zend_long sample_rate;
+    float release;               /* coeficiente de retorno do ganho por bloco */
+    float mix_gain;              /* limitador da mixagem completa */
+    int32_t *acc;
+    HashTable parts;             /* id → bcg729MixerPart*, na ordem de entrada */
+    zend_bool initialized;
+    uint64_t ticks;
+    zend_object std;
+} bcg729Mixer;
+
+#define Z_BCG729_MIXER_P(zv)  ((bcg729Mixer *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729Mixer, std)))
+
+static zend_class_entry *bcg729_mixer_ce;
+static zend_object_handlers bcg729_mixer_handlers;
+
+static void bcg729_mixer_part_dtor(zval *zv) {
+    efree(Z_PTR_P(zv));
+}
+
+static zend_object *bcg729_mixer_create(zend_class_entry *ce) {
+    bcg729Mixer *obj = zend_object_alloc(sizeof(bcg729Mixer), ce);
+
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_mixer_handlers;
+
+    return &obj->std;
+}
+
+static void bcg729_mixer_release(bcg729Mixer *mixer) {
+    if (mixer->initialized) {
+        zend_hash_destroy(&mixer->parts);
+        efree(mixer->acc);
+        mixer->acc = NULL;
+        mixer->initialized = 0;
+    }
+}
+
+static void bcg729_mixer_free(zend_object *object) {
+    bcg729Mixer *obj = (bcg729Mixer *) ((char *) object - XtOffsetOf(bcg729Mixer, std));
+    bcg729_mixer_release(obj);
+    zend_object_std_dtor(&obj->std);
+}
+
+static bcg729Mixer *bcg729_mixer_fetch(zval *zv) {
+    bcg729Mixer *self = Z_BCG729_MIXER_P(zv);
+    if (!self->initialized) {
+        zend_throw_error(NULL, "bcg729Mixer was not initialized");
+        return NULL;
+    }
+    return self;
+}
+
+static bcg729MixerPart *bcg729_mixer_join(bcg729Mixer *mixer, zend_ulong id) {
+    bcg729MixerPart *part = zend_hash_index_find_ptr(&mixer->parts, id);
+    if (!part) {
+        part = emalloc(sizeof(bcg729MixerPart));
+        part->gain = 1.0f;
+        part->in = NULL;
+        part->in_samples = 0;
+        zend_hash_index_add_new_ptr(&mixer->parts, id, part);
+    }
+    return part;
+}
+
+/* Acima do joelho: knee + e·r / (e + r), contínua e limitada a ±32767 */
+static inline int16_t bcg729_soft_clip(float x) {
+    const float room = 32767.0f - BCG729_MIXER_KNEE;
+
+    if (x > BCG729_MIXER_KNEE) {
+        float e = x - BCG729_MIXER_KNEE;
+        x = BCG729_MIXER_KNEE + (e * room) / (e + room);
+    } else if (x < -BCG729_MIXER_KNEE) {
+        float e = -x - BCG729_MIXER_KNEE;
+        x = -(BCG729_MIXER_KNEE + (e * room) / (e + room));
+    }
+    return (int16_t) (x >= 0 ? x + 0.5f : x - 0.5f);
+}
+
+/*
+ * dst = limitador(acc - sub). sub pode ser NULL (mix completo) ou mais
+ * curto que o bloco (o resto conta como silêncio).
+ */
+static void bcg729_mixer_render(float *gain, float release, const int32_t *acc, const int16_t *sub, size_t sub_n, size_t n, int16_t *dst) {
+    int32_t peak = 0;
+
+    if (!sub) {
+        sub_n = 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = acc[i] - (i < sub_n ? sub[i] : 0);
+        int32_t a = v < 0 ? -v : v;
+        if (a > peak) {
+            peak = a;
+        }
+    }
+
+    float target = peak > 32767 ? 32767.0f / (float) peak : 1.0f;
+    float next = target < *gain ? target : *gain + ((target - *gain) * release);
+    float g = *gain;
+    float step = (next - g) / (float) n;
+
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = acc[i] - (i < sub_n ? sub[i] : 0);
+        dst[i] = bcg729_soft_clip((float) v * g);
+        g += step;
+    }
+
+    *gain = next;
+}
+
+ZEND_METHOD(bcg729Mixer, __construct) {
+    zend_long frame_samples = 160;
+    zend_long sample_rate = 8000;
+
+    ZEND_PARSE_PARAMETERS_START(0, 2)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(frame_samples)
+        Z_PARAM_LONG(sample_rate)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (frame_samples < 1 || frame_samples > BCG729_MIXER_MAX_FRAME) {
+        zend_argument_value_error(1, "must be between 1 and %d", BCG729_MIXER_MAX_FRAME);
+        RETURN_THROWS();
+    }
+    if (sample_rate < 8000 || sample_rate > 48000) {
+        zend_argument_value_error(2, "must be between 8000 and 48000");
+        RETURN_THROWS();
+    }
+
+    bcg729Mixer *self = Z_BCG729_MIXER_P(getThis());
+    bcg729_mixer_release(self);
+
+    self->frame_samples = frame_samples;
+    self->sample_rate = sample_rate;
+    self->release = (float) (1.0 - exp(-(double) frame_samples / (BCG729_MIXER_RELEASE_MS * sample_rate / 1000.0)));
+    self->mix_gain = 1.0f;
+    self->acc = emalloc(sizeof(int32_t) * (size_t) frame_samples);
+    self->ticks = 0;
+    zend_hash_init(&self->parts, 8, NULL, bcg729_mixer_part_dtor, 0);
+    self->initialized = 1;
+}
+
+/* Registra um participante (também feito implicitamente por mix()) */
+ZEND_METHOD(bcg729Mixer, join) {
+    zend_long id;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(id)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Mixer *self = bcg729_mixer_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    bcg729_mixer_join(self, (zend_ulong) id);
+}
+
+ZEND_METHOD(bcg729Mixer, leave) {
+    zend_long id;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(id)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Mixer *self = bcg729_mixer_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    RETURN_BOOL(zend_hash_index_del(&self->parts, (zend_ulong) id) == SUCCESS);
+}
+
+/*
+ * Um tick: $inputs é [id => PCM 16-bit LE] com até frameSamples amostras
+ * (ids ausentes = silêncio). Retorna ['mix' => total, 'outputs' => [id =>
+ * total menos o próprio id]] para todos os participantes registrados.
+ */
+ZEND_METHOD(bcg729Mixer, mix) {
+    zval *inputs;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ARRAY(inputs)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Mixer *self = bcg729_mixer_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+
+    size_t n = (size_t) self->frame_samples;
+    zend_ulong id;
+    zend_string *key;
+    zval *data;
+    bcg729MixerPart *part;
+
+    /* Valida tudo antes: um erro no meio não pode deixar ids já incluídos */
+    ZEND_HASH_FOREACH_KEY_VAL(Z_ARRVAL_P(inputs), id, key, data) {
+        ZVAL_DEREF(data);
+        if (key || Z_TYPE_P(data) != IS_STRING || (Z_STRLEN_P(data) & 1) || Z_STRLEN_P(data) > n * 2) {
+            zend_argument_value_error(1, "must map integer ids to PCM strings of at most %zu bytes", n * 2);
+            RETURN_THROWS();
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    ZEND_HASH_FOREACH_PTR(&self->parts, part) {
+        part->in = NULL;
+        part->in_samples = 0;
+    } ZEND_HASH_FOREACH_END();
+
+    ZEND_HASH_FOREACH_NUM_KEY_VAL(Z_ARRVAL_P(inputs), id, data) {
+        ZVAL_DEREF(data);
+        part = bcg729_mixer_join(self, id);
+        part->in = (const int16_t *) Z_STRVAL_P(data);
+        part->in_samples = Z_STRLEN_P(data) / 2;
+    } ZEND_HASH_FOREACH_END();
+
+    /* Passo único de acumulação */
+    memset(self->acc, 0, sizeof(int32_t) * n);
+    ZEND_HASH_FOREACH_PTR(&self->parts, part) {
+        for (size_t i = 0; i < part->in_samples; i++) {
+            self->acc[i] += part->in[i];
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    zval outputs;
+    array_init_size(&outputs, zend_hash_num_elements(&self->parts));
+
+    ZEND_HASH_FOREACH_NUM_KEY_PTR(&self->parts, id, part) {
+        zend_string *out = zend_string_alloc(n * 2, 0);
+        bcg729_mixer_render(&part->gain, self->release, self->acc, part->in, part->in_samples, n, (int16_t *) ZSTR_VAL(out));
+        ZSTR_VAL(out)[n * 2] = '\0';
+        add_index_str(&outputs, id, out);
+    } ZEND_HASH_FOREACH_END();
+
+    zend_string *mix = zend_string_alloc(n * 2, 0);
+    bcg729_mixer_render(&self->mix_gain, self->release, self->acc, NULL, 0, n, (int16_t *) ZSTR_VAL(mix));
+    ZSTR_VAL(mix)[n * 2] = '\0';
+
+    self->ticks++;
+
+    array_init_size(return_value, 2);
+    add_assoc_str(return_value, "mix", mix);
+    add_assoc_zval(return_value, "outputs", &outputs);
+}
+
+ZEND_METHOD(bcg729Mixer, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729Mixer *self = Z_BCG729_MIXER_P(getThis());
+
+    array_init(return_value);
+    add_assoc_long(return_value, "participants", self->initialized ? zend_hash_num_elements(&self->parts) : 0);
+    add_assoc_long(return_value, "frame_samples", self->frame_samples);
+    add_assoc_long(return_value, "sample_rate", self->sample_rate);
+    add_assoc_double(return_value, "mix_gain", self->mix_gain);
+    add_assoc_long(return_value, "ticks", (zend_long) self->ticks);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_mixer_construct, 0, 0, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, frameSamples, IS_LONG, 0, "160")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, sampleRate, IS_LONG, 0, "8000")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_mixer_join, 0, 1, IS_VOID, 0)
+    ZEND_ARG_TYPE_INFO(0, id, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_mixer_leave, 0, 1, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, id, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_mixer_mix, 0, 1, IS_ARRAY, 0)
+    ZEND_ARG_TYPE_INFO(0, inputs, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_mixer_info, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry bcg729_mixer_methods[] = {
+    ZEND_ME(bcg729Mixer, __construct, arginfo_mixer_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729Mixer, join,        arginfo_mixer_join,      ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Mixer, leave,       arginfo_mixer_leave,     ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Mixer, mix,         arginfo_mixer_mix,       ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Mixer, info,        arginfo_mixer_info,      ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
+
+/* ------------------------------------------------------------------------- */
+/*    Classe bcg729Channel                                                    */
+/* ------------------------------------------------------------------------- */
+
+ZEND_METHOD(bcg729Channel, __construct) {
+    zend_bool annexb = 0;
+    zend_long mode = BCG729_MODE_BOTH;
+
+    ZEND_PARSE_PARAMETERS_START(0, 2)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(annexb)
+        Z_PARAM_LONG(mode)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (mode != BCG729_MODE_ENCODE && mode != BCG729_MODE_DECODE && mode != BCG729_MODE_BOTH) {
+        zend_argument_value_error(2, "must be bcg729Channel::ENCODE_ONLY, bcg729Channel::DECODE_ONLY or bcg729Channel::BOTH");
+        RETURN_THROWS();
+    }
+
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+
+    /* Contextos já criados que não batem com a nova configuração voltam ao pool */
+    if (self->encoder && (!(mode & BCG729_MODE_ENCODE) || self->annexb != annexb)) {
+        bcg729_pool_release(bcg729_channel_encoder_kind(self), self->encoder);
+        self->encoder = NULL;
+        bcg729_history_free(&self->enc_hist);
+    }
+    if (self->decoder && !(mode & BCG729_MODE_DECODE)) {
+        bcg729_pool_release(BCG729_POOL_DECODER, self->decoder);
+        self->decoder = NULL;
+        bcg729_history_free(&self->dec_hist);
+    }
+
+    self->mode = mode;
+    self->annexb = annexb;
+}
+
+/*
+ * Payload G.729 conforme RFC 3551: N frames de 10 bytes seguidos de, no
+ * máximo, um SID de 2 bytes (Annex B). Retorna o número de frames de
+ * 10 ms que o payload gera, ou 0 se o tamanho for inválido.
+ */
+static size_t bcg729_payload_frames(size_t len) {
+    switch (len % 10) {
+        case 0:
+            return len / 10;
+        case 2:
+            return len / 10 + 1;
+        default:
+            return 0;
+    }
+}
+
+/* Decodifica o frame idx do payload: voz (10 bytes) ou SID (2 bytes) */
+static void bcg729_decode_payload_frame(bcg729Channel *self, const uint8_t *src, size_t len, size_t idx, int16_t *pcm) {
+    const uint8_t *frame = src + (idx * 10);
+
+    if ((idx * 10) + 10 <= len) {
+        bcg729Decoder(self->decoder, frame, 10, 0, 0, 0, pcm);
+        bcg729_history_decoder(&self->dec_hist, BCG729_HIST_VOICE, frame, 10);
+        self->decoder_in_cng = 0;
+    } else {
+        bcg729Decoder(self->decoder, frame, 2, 0, 1, 0, pcm);
+        bcg729_history_decoder(&self->dec_hist, BCG729_HIST_SID, frame, 2);
+        self->decoder_in_cng = 1;
+        self->stats.sid_decoded++;
+    }
+    self->stats.frames_decoded++;
+}
+
+/* Decodifica o payload inteiro direto no destino (80 amostras por frame) */
+static void bcg729_channel_decode_frames(bcg729Channel *self, const uint8_t *src, size_t len, size_t frames, int16_t *dst) {
+    uint64_t started = bcg729_clock_ns();
+
+    for (size_t i = 0; i < frames; i++) {
+        bcg729_decode_payload_frame(self, src, len, i, dst + (i * 80));
+    }
+
+    self->stats.decoder_ns += bcg729_clock_ns() - started;
+    self->stats.bytes_in += len;
+    self->stats.bytes_out += frames * 160;
+}
+
+/* Codifica frames de 160 bytes direto no destino; retorna os bytes escritos */
+static size_t bcg729_channel_encode_frames(bcg729Channel *self, const char *raw, size_t frames, uint8_t *dst) {
+    uint64_t started = bcg729_clock_ns();
+    size_t offset = 0;
+
+    for (size_t i = 0; i < frames; i++) {
+        uint8_t frame_len = 0;
+        bcg729Encoder(self->encoder, (const int16_t *) (raw + (i * 160)), dst + offset, &frame_len);
+        bcg729_history_encoder(&self->enc_hist, (const int16_t *) (raw + (i * 160)));
+        offset += frame_len;
+        self->stats.sid_encoded += (frame_len == 2);
+    }
+
+    self->stats.encoder_ns += bcg729_clock_ns() - started;
+    self->stats.frames_encoded += frames;
+    self->stats.bytes_in += frames * 160;
+    self->stats.bytes_out += offset;
+
+    return offset;
+}
+
+/*
+ * Prepara o buffer do chamador ($out por referência) para receber len
+ * bytes a partir de offset. Se a string não é compartilhada ela é
+ * reutilizada e só cresce quando falta espaço; caso contrário é copiada
+ * (copy-on-write). old_len recebe o tamanho anterior de $out.
+ */
+static char *bcg729_out_reserve(zval *out, zend_long offset, size_t len, size_t *old_len) {
+    ZVAL_DEREF(out);
+
+    size_t cur = Z_TYPE_P(out) == IS_STRING ? Z_STRLEN_P(out) : 0;
+    if (offset < 0 || (size_t) offset > cur || (offset & 1)) {
+        zend_argument_value_error(3, "must be an even offset between 0 and the length of $out");
+        return NULL;
+    }
+
+    size_t need = (size_t) offset + len;
+    size_t new_len = need > cur ? need : cur;
+    zend_string *buf;
+
+    if (Z_TYPE_P(out) != IS_STRING) {
+        buf = zend_string_alloc(new_len, 0);
+        zval_ptr_dtor(out);
+    } else if (!ZSTR_IS_INTERNED(Z_STR_P(out)) && GC_REFCOUNT(Z_STR_P(out)) == 1) {
+        buf = Z_STR_P(out);
+        if (new_len > cur) {
+            buf = zend_string_extend(buf, new_len, 0);
+        }
+        zend_string_forget_hash_val(buf);
+    } else {
+        buf = zend_string_alloc(new_len, 0);
+        memcpy(ZSTR_VAL(buf), Z_STRVAL_P(out), cur);
+        zval_ptr_dtor(out);
+    }
+
+    ZSTR_VAL(buf)[new_len] = '\0';
+    ZVAL_STR(out, buf);
+    *old_len = cur;
+
+    return ZSTR_VAL(buf) + offset;
+}
+
+ZEND_METHOD(bcg729Channel, decode) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    size_t frames = bcg729_payload_frames(len);
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (frames == 0) {
+        self->stats.rejected++;
+        RETURN_FALSE;
+    }
+
+    if (!bcg729_channel_decoder(self)) {
+        RETURN_FALSE;
+    }
+
+    size_t out_samples = frames * 80; /* 80 amostras por frame */
+    size_t out_bytes = out_samples * 2;
+
+    zend_string *out = zend_string_alloc(out_bytes, 0);
+    bcg729_channel_decode_frames(self, (const uint8_t *) ZSTR_VAL(input), len, frames, (int16_t *) ZSTR_VAL(out));
+
+    ZSTR_VAL(out)[out_bytes] = '\0';
+    RETURN_STR(out);
+}
+
+ZEND_METHOD(bcg729Channel, encode) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (len == 0 || (len % 160) != 0) {
+        self->stats.rejected++;
+        RETURN_FALSE;
+    }
+
+    if (!bcg729_channel_encoder(self)) {
+        RETURN_FALSE;
+    }
+
+    size_t frames = len / 160;
+
+    /* Tamanho máximo: 10 bytes por frame */
+    size_t max_out = frames * 10;
+    zend_string *out = zend_string_alloc(max_out, 0);
+    uint8_t *dst = (uint8_t *) ZSTR_VAL(out);
+    size_t offset = bcg729_channel_encode_frames(self, ZSTR_VAL(input), frames, dst);
+
+    dst[offset] = '\0';
+    ZSTR_LEN(out) = offset;
+    RETURN_STR(out);
+}
+
+/*
+ * decodeInto(string $in, string &$out, int $offset = 0): escreve o PCM em
+ * $out a partir de $offset, reaproveitando o buffer entre pacotes.
+ * Retorna os bytes escritos.
+ */
+ZEND_METHOD(bcg729Channel, decodeInto) {
+    zend_string *input;
+    zval *out;
+    zend_long offset = 0;
+
+    ZEND_PARSE_PARAMETERS_START(2, 3)
+        Z_PARAM_STR(input)
+        Z_PARAM_ZVAL(out)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(offset)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    size_t frames = bcg729_payload_frames(len);
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (frames == 0) {
+        self->stats.rejected++;
+        RETURN_FALSE;
+    }
+
+    if (!bcg729_channel_decoder(self)) {
+        RETURN_FALSE;
+    }
+
+    size_t out_bytes = frames * 160;
+    size_t old_len;
+    char *dst = bcg729_out_reserve(out, offset, out_bytes, &old_len);
+    if (!dst) {
+        RETURN_THROWS();
+    }
+
+    bcg729_channel_decode_frames(self, (const uint8_t *) ZSTR_VAL(input), len, frames, (int16_t *) dst);
+
+    RETURN_LONG((zend_long) out_bytes);
+}
+
+/*
+ * encodeInto(string $in, string &$out, int $offset = 0): escreve o G.729 em
+ * $out a partir de $offset. Com Annex B o tamanho varia por frame, então
+ * $out só cresce até onde foi de fato escrito. Retorna os bytes escritos.
+ */
+ZEND_METHOD(bcg729Channel, encodeInto) {
+    zend_string *input;
+    zval *out;
+    zend_long offset = 0;
+
+    ZEND_PARSE_PARAMETERS_START(2, 3)
+        Z_PARAM_STR(input)
+        Z_PARAM_ZVAL(out)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(offset)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (len == 0 || (len % 160) != 0) {
+        self->stats.rejected++;
+        RETURN_FALSE;
+    }
+
+    if (!bcg729_channel_encoder(self)) {
+        RETURN_FALSE;
+    }
+
+    size_t frames = len / 160;
+    size_t old_len;
+    char *dst = bcg729_out_reserve(out, offset, frames * 10, &old_len);
+    if (!dst) {
+        RETURN_THROWS();
+    }
+
+    size_t written = bcg729_channel_encode_frames(self, ZSTR_VAL(input), frames, (uint8_t *) dst);
+
+    /* Ajusta o tamanho se o Annex B gerou menos que o máximo reservado */
+    zval *ref = out;
+    ZVAL_DEREF(ref);
+    size_t final_len = (size_t) offset + written > old_len ? (size_t) offset + written : old_len;
+    ZSTR_LEN(Z_STR_P(ref)) = final_len;
+    Z_STRVAL_P(ref)[final_len] = '\0';
+
+    RETURN_LONG((zend_long) written);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    Batch: vários canais numa única chamada                                 */
+/* ------------------------------------------------------------------------- */
+
+/* Entrada do canal (mesma chave em $inputs); NULL se ausente ou não-string */
+static zend_string *bcg729_batch_input(HashTable *inputs, zend_string *key, zend_ulong idx) {
+    zval *in = key ? zend_hash_find(inputs, key) : zend_hash_index_find(inputs, idx);
+
+    if (!in) {
+        return NULL;
+    }
+    ZVAL_DEREF(in);
+    return Z_TYPE_P(in) == IS_STRING ? Z_STR_P(in) : NULL;
+}
+
+/* Tamanho máximo de saída para a entrada; 0 se o tamanho for inválido */
+static size_t bcg729_batch_max_out(const zend_string *in, zend_bool encode) {
+    size_t len = ZSTR_LEN(in);
+
+    if (encode) {
+        return (len == 0 || (len % 160) != 0) ? 0 : (len / 160) * 10;
+    }
+    return bcg729_payload_frames(len) * 160;
+}
+
+static void bcg729_batch_add(HashTable *ht, zend_string *key, zend_ulong idx, zval *value) {
+    if (key) {
+        zend_hash_update(ht, key, value);
+    } else {
+        zend_hash_index_update(ht, idx, value);
+    }
+}
+
+/* Um canal do lote; preenchido na thread do PHP, processado em qualquer thread */
+typedef struct {
+    bcg729Channel *self;
+    zend_string *key;
+    zend_ulong idx;
+    zend_string *in;
+    zend_string *out;   /* saída própria (modo não empacotado) */
+    char *dst;
+    size_t max_out;
+    size_t written;
+    zend_bool ready;
+} bcg729BatchJob;
+
+/* Roda um job: só toca no contexto do canal e nos buffers já alocados */
+static void bcg729_batch_run_job(bcg729BatchJob *job, zend_bool encode) {
+    if (!job->ready) {
+        return;
+    }
+    if (encode) {
+        job->written = bcg729_channel_encode_frames(job->self, ZSTR_VAL(job->in), ZSTR_LEN(job->in) / 160, (uint8_t *) job->dst);
+    } else {
+        bcg729_channel_decode_frames(job->self, (const uint8_t *) ZSTR_VAL(job->in), ZSTR_LEN(job->in),
+            job->max_out / 160, (int16_t *) job->dst);
+        job->written = job->max_out;
+    }
+}
+
+typedef struct {
+    bcg729BatchJob *jobs;
+    zend_bool encode;
+} bcg729BatchRun;
+
+static void bcg729_batch_task(void *ctx, size_t i) {
+    bcg729BatchRun *run = ctx;
+    bcg729_batch_run_job(&run->jobs[i], run->encode);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    Pool de threads nativas para os lotes (bcg729.threads)                  */
+/* ------------------------------------------------------------------------- */
+
+/* Tarefa i de um lote paralelo; nunca chama a Zend API */
+typedef void (*bcg729_task_fn)(void *ctx, size_t i);
+
+#ifdef BCG729_THREADS
+/*
+ * Pool único por processo, criado no primeiro uso. As workers nunca
+ * chamam a Zend API: só rodam tarefas sobre dados que a thread do PHP
+ * já preparou. A thread chamadora também processa tarefas e só retorna
+ * depois que todas terminaram.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;     /* lote novo disponível */
+    pthread_cond_t done_cv;     /* último job do lote terminou */
+    pthread_mutex_t submit;     /* um lote por vez (ZTS) */
+    pthread_t *threads;
+    int nthreads;
+    pid_t pid;                  /* após fork as threads não existem no filho */
+    unsigned long generation;
+    bcg729_task_fn fn;
+    void *ctx;
+    size_t count;
+    size_t next;
+    size_t pending;
+    zend_bool shutdown;
+} bcg729ThreadPool;
+
+static bcg729ThreadPool bcg729_tp;
+static pthread_mutex_t bcg729_tp_init_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Pega e roda tarefas até acabarem; chamado com bcg729_tp.lock travado */
+static void bcg729_tp_drain(void) {
+    while (bcg729_tp.next < bcg729_tp.count) {
+        size_t i = bcg729_tp.next++;
+        bcg729_task_fn fn = bcg729_tp.fn;
+        void *ctx = bcg729_tp.ctx;
+
+        pthread_mutex_unlock(&bcg729_tp.lock);
+        fn(ctx, i);
+        pthread_mutex_lock(&bcg729_tp.lock);
+
+        if (--bcg729_tp.pending == 0) {
+            pthread_cond_signal(&bcg729_tp.done_cv);
+        }
+    }
+}
+
+static void *bcg729_tp_worker(void *arg) {
+    unsigned long seen = 0;
+    (void) arg;
+
+    pthread_mutex_lock(&bcg729_tp.lock);
+    for (;;) {
+        while (!bcg729_tp.shutdown && bcg729_tp.generation == seen) {
+            pthread_cond_wait(&bcg729_tp.work_cv, &bcg729_tp.lock);
+        }
+        if (bcg729_tp.shutdown) {
+            break;
+        }
+        seen = bcg729_tp.generation;
+        bcg729_tp_drain();
+    }
+    pthread_mutex_unlock(&bcg729_tp.lock);
+
+    return NULL;
+}
+
+/* Cria as workers (bcg729.threads - 1, a chamadora é a última) se preciso */
+static zend_bool bcg729_tp_ensure(void) {
+    zend_long wanted = BCG729_G(threads);
+    zend_bool ok;
+
+    if (wanted <= 1) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&bcg729_tp_init_lock);
+
+    if (bcg729_tp.threads && bcg729_tp.pid != getpid()) {
+        /* Filho de fork: descarta o estado herdado, as threads ficaram no pai */
+        free(bcg729_tp.threads);
+        bcg729_tp.threads = NULL;
+        bcg729_tp.nthreads = 0;
+    }
+
+    if (!bcg729_tp.threads) {
+        sigset_t all, old;
+        int workers = (int) (wanted > 256 ? 256 : wanted) - 1;
+
+        pthread_mutex_init(&bcg729_tp.lock, NULL);
+        pthread_mutex_init(&bcg729_tp.submit, NULL);
+        pthread_cond_init(&bcg729_tp.work_cv, NULL);
+        pthread_cond_init(&bcg729_tp.done_cv, NULL);
+        bcg729_tp.generation = 0;
+        bcg729_tp.shutdown = 0;
+        bcg729_tp.fn = NULL;
+        bcg729_tp.ctx = NULL;
+        bcg729_tp.count = bcg729_tp.next = bcg729_tp.pending = 0;
+        bcg729_tp.threads = calloc((size_t) workers, sizeof(pthread_t));
+        bcg729_tp.pid = getpid();
+
+        /* Sinais (timeouts do PHP etc.) continuam indo só para a thread do PHP */
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &old);
+        for (int i = 0; bcg729_tp.threads && i < workers; i++) {
+            if (pthread_create(&bcg729_tp.threads[i], NULL, bcg729_tp_worker, NULL) != 0) {
+                break;
+            }
+            bcg729_tp.nthreads++;
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+    }
+
+    ok = bcg729_tp.nthreads > 0;
+    pthread_mutex_unlock(&bcg729_tp_init_lock);
+
+    return ok;
+}
+
+/* Threads disponíveis para um lote (1 se o pool está desligado) */
+static int bcg729_threads_available(void) {
+    return bcg729_tp_ensure() ? bcg729_tp.nthreads + 1 : 1;
+}
+
+/* Threads do pool já iniciado, sem criar nada (phpinfo, bcg729_stats) */
+static int bcg729_threads_running(void) {
+    int running;
+
+    pthread_mutex_lock(&bcg729_tp_init_lock);
+    running = bcg729_tp.threads && bcg729_tp.pid == getpid() ? bcg729_tp.nthreads + 1 : 1;
+    pthread_mutex_unlock(&bcg729_tp_init_lock);
+
+    return running;
+}
+
+static void bcg729_tp_shutdown(void) {
+    if (!bcg729_tp.threads || bcg729_tp.pid != getpid()) {
+        return;
+    }
+
+    pthread_mutex_lock(&bcg729_tp.lock);
+    bcg729_tp.shutdown = 1;
+    pthread_cond_broadcast(&bcg729_tp.work_cv);
+    pthread_mutex_unlock(&bcg729_tp.lock);
+
+    for (int i = 0; i < bcg729_tp.nthreads; i++) {
+        pthread_join(bcg729_tp.threads[i], NULL);
+    }
+
+    free(bcg729_tp.threads);
+    bcg729_tp.threads = NULL;
+    bcg729_tp.nthreads = 0;
+    pthread_mutex_destroy(&bcg729_tp.lock);
+    pthread_mutex_destroy(&bcg729_tp.submit);
+    pthread_cond_destroy(&bcg729_tp.work_cv);
+    pthread_cond_destroy(&bcg729_tp.done_cv);
+}
+
+/* Roda fn(ctx, 0..count-1) no pool; 0 se o pool está desligado ou ocupado */
+static zend_bool bcg729_threads_run(bcg729_task_fn fn, void *ctx, size_t count) {
+    if (count < 2 || !bcg729_tp_ensure()) {
+        return 0;
+    }
+    if (pthread_mutex_trylock(&bcg729_tp.submit) != 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&bcg729_tp.lock);
+    bcg729_tp.fn = fn;
+    bcg729_tp.ctx = ctx;
+    bcg729_tp.count = count;
+    bcg729_tp.next = 0;
+    bcg729_tp.pending = count;
+    bcg729_tp.generation++;
+    pthread_cond_broadcast(&bcg729_tp.work_cv);
+
+    bcg729_tp_drain();
+    while (bcg729_tp.pending > 0) {
+        pthread_cond_wait(&bcg729_tp.done_cv, &bcg729_tp.lock);
+    }
+
+    bcg729_tp.fn = NULL;
+    bcg729_tp.ctx = NULL;
+    bcg729_tp.count = 0;
+    pthread_mutex_unlock(&bcg729_tp.lock);
+    pthread_mutex_unlock(&bcg729_tp.submit);
+
+    return 1;
+}
+#else
+static zend_bool bcg729_threads_run(bcg729_task_fn fn, void *ctx, size_t count) {
+    (void) fn;
+    (void) ctx;
+    (void) count;
+    return 0;
+}
+
+static int bcg729_threads_available(void) {
+    return 1;
+}
+
+static int bcg729_threads_running(void) {
+    return 1;
+}
+
+static void bcg729_tp_shutdown(void) {
+}
+#endif
+
+/*
+ * encodeBatch/decodeBatch: $channels[k] processa $inputs[k]. Sem $packed
+ * retorna [k => string|false]; com $packed todas as saídas vão para uma
+ * única string: ['data' => ..., 'offsets' => [k => int], 'lengths' => [k => int]]
+ * (canais com entrada inválida ficam fora de offsets/lengths).
+ */
+static void bcg729_channel_batch(INTERNAL_FUNCTION_PARAMETERS, zend_bool encode) {
+    HashTable *channels, *inputs;
+    zend_bool packed = 0;
+    zend_string *key;
+    zend_ulong idx;
+    zval *zch;
+
+    ZEND_PARSE_PARAMETERS_START(2, 3)
+        Z_PARAM_ARRAY_HT(channels)
+        Z_PARAM_ARRAY_HT(inputs)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(packed)
+    ZEND_PARSE_PARAMETERS_END();
+
+    /* Valida todos os canais e soma o tamanho máximo antes de codificar */
+    size_t total = 0;
+    ZEND_HASH_FOREACH_KEY_VAL(channels, idx, key, zch) {
+        ZVAL_DEREF(zch);
+        if (Z_TYPE_P(zch) != IS_OBJECT || !instanceof_function(Z_OBJCE_P(zch), bcg729_ce)) {
+            zend_argument_type_error(1, "must contain only bcg729Channel objects");
+            RETURN_THROWS();
+        }
+        zend_string *in = bcg729_batch_input(inputs, key, idx);
+        if (in) {
+            total += bcg729_batch_max_out(in, encode);
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    uint32_t count = zend_hash_num_elements(channels);
+    bcg729BatchJob *jobs = safe_emalloc(count, sizeof(bcg729BatchJob), 0);
+    zend_string *data = packed ? zend_string_alloc(total, 0) : NULL;
+    size_t reserved = 0;
+    zend_bool shared = 0;
+    uint32_t n = 0;
+
+    /*
+     * Prepara os jobs na thread do PHP: contextos (que podem emitir warning)
+     * e strings de saída são criados aqui, para que o processamento possa
+     * rodar fora do engine.
+     */
+    ZEND_HASH_FOREACH_KEY_VAL(channels, idx, key, zch) {
+        bcg729BatchJob *job = &jobs[n++];
+        ZVAL_DEREF(zch);
+
+        job->self = Z_BCG729_CHANNEL_P(zch);
+        job->key = key;
+        job->idx = idx;
+        job->in = bcg729_batch_input(inputs, key, idx);
+        job->max_out = job->in ? bcg729_batch_max_out(job->in, encode) : 0;
+        job->out = NULL;
+        job->written = 0;
+        job->ready = job->max_out > 0
+            && (encode ? bcg729_channel_encoder(job->self) != NULL : bcg729_channel_decoder(job->self) != NULL);
+        if (job->in && job->max_out == 0) {
+            job->self->stats.rejected++;
+        }
+
+        if (!job->ready) {
+            continue;
+        }
+
+        /* O mesmo canal duas vezes no lote não pode rodar em paralelo */
+        if (job->self->in_batch) {
+            shared = 1;
+        }
+        job->self->in_batch = 1;
+
+        if (packed) {
+            job->dst = ZSTR_VAL(data) + reserved;
+            reserved += job->max_out;
+        } else {
+            job->out = zend_string_alloc(job->max_out, 0);
+            job->dst = ZSTR_VAL(job->out);
+        }
+    } ZEND_HASH_FOREACH_END();
+
+    bcg729BatchRun run = { jobs, encode };
+
+    if (shared || !bcg729_threads_run(bcg729_batch_task, &run, n)) {
+        for (uint32_t i = 0; i < n; i++) {
+            bcg729_batch_run_job(&jobs[i], encode);
+        }
+    }
+
+    zval offsets, lengths, tmp;
+    size_t pos = 0;
+
+    array_init_size(return_value, packed ? 3 : count);
+    if (packed) {
+        array_init_size(&offsets, count);
+        array_init_size(&lengths, count);
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        bcg729BatchJob *job = &jobs[i];
+
+        if (!job->ready) {
+            if (!packed) {
+                ZVAL_FALSE(&tmp);
+                bcg729_batch_add(Z_ARRVAL_P(return_value), job->key, job->idx, &tmp);
+            }
+            continue;
+        }
+        job->self->in_batch = 0;
+
+        if (packed) {
+            /* Compacta: com Annex B cada saída pode ser menor que o reservado */
+            if (job->dst != ZSTR_VAL(data) + pos) {
+                memmove(ZSTR_VAL(data) + pos, job->dst, job->written);
+            }
+            ZVAL_LONG(&tmp, (zend_long) pos);
+            bcg729_batch_add(Z_ARRVAL(offsets), job->key, job->idx, &tmp);
+            ZVAL_LONG(&tmp, (zend_long) job->written);
+            bcg729_batch_add(Z_ARRVAL(lengths), job->key, job->idx, &tmp);
+            pos += job->written;
+        } else {
+            ZSTR_LEN(job->out) = job->written;
+            ZSTR_VAL(job->out)[job->written] = '\0';
+            ZVAL_STR(&tmp, job->out);
+            bcg729_batch_add(Z_ARRVAL_P(return_value), job->key, job->idx, &tmp);
+        }
+    }
+
+    efree(jobs);
+
+    if (packed) {
+        ZSTR_LEN(data) = pos;
+        ZSTR_VAL(data)[pos] = '\0';
+        add_assoc_str(return_value, "data", data);
+        add_assoc_zval(return_value, "offsets", &offsets);
+        add_assoc_zval(return_value, "lengths", &lengths);
+    }
+}
+
+ZEND_METHOD(bcg729Channel, encodeBatch) {
+    bcg729_channel_batch(INTERNAL_FUNCTION_PARAM_PASSTHRU, 1);
+}
+
+ZEND_METHOD(bcg729Channel, decodeBatch) {
+    bcg729_channel_batch(INTERNAL_FUNCTION_PARAM_PASSTHRU, 0);
+}
+
+/* Codifica um frame de 80 amostras e o enfileira para pull() */
+static void bcg729_channel_push_frame(bcg729Channel *self, const int16_t *pcm) {
+    uint8_t g729[10];
+    uint8_t frame_len = 0;
+
+    uint64_t started = bcg729_clock_ns();
+    bcg729Encoder(self->encoder, pcm, g729, &frame_len);
+    self->stats.encoder_ns += bcg729_clock_ns() - started;
+    bcg729_history_encoder(&self->enc_hist, pcm);
+    self->stats.frames_encoded++;
+    self->stats.bytes_in += 160;
+    self->stats.bytes_out += frame_len;
+    self->stats.sid_encoded += (frame_len == 2);
+    if (frame_len > 0) {
+        smart_string_appendl(&self->pending, (const char *) g729, frame_len);
+    }
+    smart_string_appendc(&self->pending_lens, (char) frame_len);
+}
+
+/*
+ * Aceita PCM 16-bit LE de qualquer tamanho: codifica os frames completos
+ * e guarda até 159 bytes de sobra para a próxima chamada. Retorna o
+ * número de frames aguardando pull().
+ */
+ZEND_METHOD(bcg729Channel, push) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (!bcg729_channel_encoder(self)) {
+        RETURN_FALSE;
+    }
+
+    const char *src = ZSTR_VAL(input);
+    size_t len = ZSTR_LEN(input);
+
+    if (self->pcm_tail_len > 0) {
+        size_t need = 160 - self->pcm_tail_len;
+        if (len < need) {
+            memcpy((char *) self->pcm_tail + self->pcm_tail_len, src, len);
+            self->pcm_tail_len += len;
+            RETURN_LONG((zend_long) self->pending_lens.len);
+        }
+        memcpy((char *) self->pcm_tail + self->pcm_tail_len, src, need);
+        bcg729_channel_push_frame(self, self->pcm_tail);
+        self->pcm_tail_len = 0;
+        src += need;
+        len -= need;
+    }
+
+    for (; len >= 160; src += 160, len -= 160) {
+        int16_t pcm[80];
+        memcpy(pcm, src, 160); /* src pode estar desalinhado após a sobra */
+        bcg729_channel_push_frame(self, pcm);
+    }
+
+    memcpy(self->pcm_tail, src, len);
+    self->pcm_tail_len = len;
+
+    RETURN_LONG((zend_long) self->pending_lens.len);
+}
+
+/*
+ * Retira até $maxFrames frames codificados por push(). Um SID ou um frame
+ * não transmitido encerra o payload (RFC 3551): voz dos dois lados de uma
+ * lacuna de DTX nunca vai no mesmo pacote. String vazia quando não há nada
+ * pendente ou o próximo frame é não transmitido (consome só ele).
+ */
+ZEND_METHOD(bcg729Channel, pull) {
+    zend_long max_frames;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(max_frames)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (max_frames <= 0) {
+        zend_argument_value_error(1, "must be greater than 0");
+        RETURN_THROWS();
+    }
+
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    size_t queued = self->pending_lens.len;
+    if (queued == 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    const uint8_t *lens = (const uint8_t *) self->pending_lens.c;
+    size_t frames = 0, bytes = 0;
+
+    while (frames < queued && frames < (size_t) max_frames) {
+        uint8_t frame_len = lens[frames];
+        if (frame_len == 0) {
+            /* lacuna de DTX: encerra o payload; se vem primeiro, consome só ela */
+            if (frames == 0) {
+                frames = 1;
+            }
+            break;
+        }
+        frames++;
+        bytes += frame_len;
+        if (frame_len == 2) {
+            break;
+        }
+    }
+
+    memmove(self->pending_lens.c, self->pending_lens.c + frames, queued - frames);
+    self->pending_lens.len -= frames;
+
+    if (bytes == 0) {
+        /* só lacuna de DTX: pending pode nem ter sido alocado (após reset()/importState()) */
+        RETURN_EMPTY_STRING();
+    }
+
+    zend_string *out = zend_string_init(self->pending.c, bytes, 0);
+
+    memmove(self->pending.c, self->pending.c + bytes, self->pending.len - bytes);
+    self->pending.len -= bytes;
+
+    RETURN_STR(out);
+}
+
+/* Frames perdidos: PLC do decoder, ou ruído de conforto se o último frame foi SID */
+static void bcg729_channel_conceal_frames(bcg729Channel *self, size_t frames, int16_t *dst) {
+    static const uint8_t erased[10] = {0};
+    uint64_t started = bcg729_clock_ns();
+
+    for (size_t i = 0; i < frames; i++) {
+        if (self->decoder_in_cng) {
+            /* DTX: frame não transmitido depois de um SID gera ruído de conforto */
+            bcg729Decoder(self->decoder, NULL, 0, 0, 1, 0, dst + (i * 80));
+            bcg729_history_decoder(&self->dec_hist, BCG729_HIST_CNG, erased, 0);
+        } else {
+            bcg729Decoder(self->decoder, erased, 10, 1, 0, 0, dst + (i * 80));
+            bcg729_history_decoder(&self->dec_hist, BCG729_HIST_ERASED, erased, 0);
+        }
+    }
+
+    self->stats.decoder_ns += bcg729_clock_ns() - started;
+    self->stats.erasures += frames;
+    self->stats.bytes_out += frames * 160;
+}
+
+/* Ocultação de perda: roda o decoder com frameErasureFlag = 1, que
+ * extrapola a partir do estado atual em vez de injetar silêncio */
+#define BCG729_MAX_LOST_FRAMES 1000
+
+ZEND_METHOD(bcg729Channel, decodeLost) {
+    zend_long frames = 1;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(frames)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (frames < 1 || frames > BCG729_MAX_LOST_FRAMES) {
+        zend_argument_value_error(1, "must be between 1 and %d", BCG729_MAX_LOST_FRAMES);
+        RETURN_THROWS();
+    }
+
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (!bcg729_channel_decoder(self)) {
+        RETURN_FALSE;
+    }
+
+    size_t out_bytes = (size_t) frames * 160;
+    zend_string *out = zend_string_alloc(out_bytes, 0);
+    bcg729_channel_conceal_frames(self, (size_t) frames, (int16_t *) ZSTR_VAL(out));
+
+    ZSTR_VAL(out)[out_bytes] = '\0';
+    RETURN_STR(out);
+}
+
+/* G.729 -> G.711 frame a frame: o PCM só existe na pilha */
+static void bcg729_channel_decode_g711(INTERNAL_FUNCTION_PARAMETERS, const uint8_t *encode_table) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    size_t frames = bcg729_payload_frames(len);
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (frames == 0) {
+        self->stats.rejected++;
+        RETURN_FALSE;
+    }
+
+    if (!bcg729_channel_decoder(self)) {
+        RETURN_FALSE;
+    }
+
+    size_t out_bytes = frames * 80; /* 1 byte G.711 por amostra */
+
+    zend_string *out = zend_string_alloc(out_bytes, 0);
+    uint8_t *dst = (uint8_t *) ZSTR_VAL(out);
+    const uint8_t *src = (const uint8_t *) ZSTR_VAL(input);
+    uint64_t decoder_ns = 0;
+
+    for (size_t i = 0; i < frames; i++) {
+        int16_t pcm[80];
+        uint64_t started = bcg729_clock_ns();
+        bcg729_decode_payload_frame(self, src, len, i, pcm);
+        decoder_ns += bcg729_clock_ns() - started;
+        for (int j = 0; j < 80; j++) {
+            dst[j] = encode_table[(uint16_t) pcm[j]];
+        }
+        dst += 80;
+    }
+
+    self->stats.decoder_ns += decoder_ns;
+    self->stats.bytes_in += len;
+    self->stats.bytes_out += out_bytes;
+
+    ZSTR_VAL(out)[out_bytes] = '\0';
+    RETURN_STR(out);
+}
+
+/* G.711 -> G.729 frame a frame: expande 80 amostras na pilha e codifica */
+static void bcg729_channel_encode_g711(INTERNAL_FUNCTION_PARAMETERS, bcg729_g711_decode_fn expand) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    size_t len = ZSTR_LEN(input);
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    if (len == 0 || (len % 80) != 0) {
+        self->stats.rejected++;
+        RETURN_FALSE;
+    }
+
+    if (!bcg729_channel_encoder(self)) {
+        RETURN_FALSE;
+    }
+
+    size_t frames = len / 80;
+    size_t max_out = frames * 10;
+    zend_string *out = zend_string_alloc(max_out, 0);
+    uint8_t *dst = (uint8_t *) ZSTR_VAL(out);
+    size_t offset = 0;
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+
+    uint64_t encoder_ns = 0;
+
+    for (size_t i = 0; i < frames; i++) {
+        int16_t pcm[80];
+        uint8_t frame_len = 0;
+
+        expand(pcm, src + (i * 80), 80);
+        uint64_t started = bcg729_clock_ns();
+        bcg729Encoder(self->encoder, pcm, dst + offset, &frame_len);
+        encoder_ns += bcg729_clock_ns() - started;
+        bcg729_history_encoder(&self->enc_hist, pcm);
+        offset += frame_len;
+        self->stats.sid_encoded += (frame_len == 2);
+    }
+
+    self->stats.encoder_ns += encoder_ns;
+    self->stats.frames_encoded += frames;
+    self->stats.bytes_in += len;
+    self->stats.bytes_out += offset;
+
+    dst[offset] = '\0';
+    ZSTR_LEN(out) = offset;
+    RETURN_STR(out);
+}
+
+ZEND_METHOD(bcg729Channel, decodeToPcma) {
+    bcg729_channel_decode_g711(INTERNAL_FUNCTION_PARAM_PASSTHRU, linear_to_alaw);
+}
+
+ZEND_METHOD(bcg729Channel, decodeToPcmu) {
+    bcg729_channel_decode_g711(INTERNAL_FUNCTION_PARAM_PASSTHRU, linear_to_ulaw);
+}
+
+ZEND_METHOD(bcg729Channel, encodeFromPcma) {
+    bcg729_channel_encode_g711(INTERNAL_FUNCTION_PARAM_PASSTHRU, bcg729_alaw_decode);
+}
+
+ZEND_METHOD(bcg729Channel, encodeFromPcmu) {
+    bcg729_channel_encode_g711(INTERNAL_FUNCTION_PARAM_PASSTHRU, bcg729_ulaw_decode);
+}
+
+static void bcg729_stats_to_array(zval *arr, const bcg729ChannelStats *st) {
+    add_assoc_long(arr, "frames_encoded", (zend_long) st->frames_encoded);
+    add_assoc_long(arr, "frames_decoded", (zend_long) st->frames_decoded);
+    add_assoc_long(arr, "bytes_in", (zend_long) st->bytes_in);
+    add_assoc_long(arr, "bytes_out", (zend_long) st->bytes_out);
+    add_assoc_long(arr, "rejected", (zend_long) st->rejected);
+    add_assoc_long(arr, "erasures", (zend_long) st->erasures);
+    add_assoc_long(arr, "sid_encoded", (zend_long) st->sid_encoded);
+    add_assoc_long(arr, "sid_decoded", (zend_long) st->sid_decoded);
+    add_assoc_long(arr, "encoder_ns", (zend_long) st->encoder_ns);
+    add_assoc_long(arr, "decoder_ns", (zend_long) st->decoder_ns);
+}
+
+/* Totais do processo (ou da thread, em ZTS): canais destruídos + canais vivos */
+static uint32_t bcg729_stats_total(bcg729ChannelStats *total) {
+    uint32_t live = 0;
+
+    *total = BCG729_G(retired_stats);
+    for (bcg729Channel *ch = BCG729_G(live_channels); ch; ch = ch->live_next) {
+        bcg729_stats_add(total, &ch->stats);
+        live++;
+    }
+    return live;
+}
+
+ZEND_METHOD(bcg729Channel, info) {
+    array_init(return_value);
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+    add_assoc_bool(return_value, "decoder_initialized", self->decoder != NULL);
+    add_assoc_bool(return_value, "encoder_initialized", self->encoder != NULL);
+    add_assoc_bool(return_value, "annex_b", self->annexb);
+    add_assoc_long(return_value, "mode", self->mode);
+    /* inclui o anel de exportState(), alocado junto com o contexto */
+    add_assoc_long(return_value, "decoder_bytes", self->decoder
+        ? (zend_long) (bcg729_decoder_ctx_bytes + (size_t) self->dec_hist.cap * BCG729_HIST_DEC_ITEM) : 0);
+    add_assoc_long(return_value, "encoder_bytes", self->encoder
+        ? (zend_long) ((self->annexb ? bcg729_encoder_vad_ctx_bytes : bcg729_encoder_ctx_bytes)
+            + (size_t) self->enc_hist.cap * BCG729_HIST_PCM_ITEM) : 0);
+    add_assoc_long(return_value, "pending_frames", (zend_long) self->pending_lens.len);
+    add_assoc_long(return_value, "buffered_pcm_bytes", (zend_long) self->pcm_tail_len);
+    add_assoc_long(return_value, "state_frames", (zend_long) (self->enc_hist.count + self->dec_hist.count));
+    add_assoc_bool(return_value, "state_exact", self->enc_hist.exact && self->dec_hist.exact);
+    bcg729_stats_to_array(return_value, &self->stats);
+}
+
+/* Volta o codec ao estado inicial trocando os contextos por outros do pool */
+ZEND_METHOD(bcg729Channel, reset) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+
+    if (self->decoder) {
+        void *used = self->decoder;
+        self->decoder = bcg729_pool_acquire(BCG729_POOL_DECODER);
+        bcg729_pool_release(BCG729_POOL_DECODER, used);
+        bcg729_history_init(&self->dec_hist, BCG729_HIST_DEC_ITEM);
+    }
+    if (self->encoder) {
+        int kind = bcg729_channel_encoder_kind(self);
+        void *used = self->encoder;
+        self->encoder = bcg729_pool_acquire(kind);
+        bcg729_pool_release(kind, used);
+        bcg729_history_init(&self->enc_hist, BCG729_HIST_PCM_ITEM);
+    }
+
+    self->decoder_in_cng = 0;
+    bcg729_channel_stream_clear(self);
+}
+
+ZEND_METHOD(bcg729Channel, close) {
+    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
+
+    bcg729_channel_release(self);
+    bcg729_channel_stream_clear(self);
+    bcg729_history_free(&self->enc_hist);
+    bcg729_history_free(&self->dec_hist);
+    self->closed = 1;
+
+    RETURN_TRUE;
+}
+
+/*
+ * Estado serializado (exportState/importState, __serialize/__unserialize):
+ *
+ *   0  "BG7S"
+ *   4  versão (2)
+ *   5  flags (BCG729_STATE_*)
+ *   6  modo
+ *   7  bytes de PCM guardados por push() (0..159)
+ *   8  frames no histórico do encoder (u16 LE)
+ *  10  frames no histórico do decoder (u16 LE)
+ *  12  bytes aguardando pull() (u32 LE)
+ *  16  frames aguardando pull() (u32 LE)
+ *  20  sobra de PCM, histórico do encoder (160 bytes/frame), SID fixo do
+ *      decoder (2 bytes, só com BCG729_STATE_SID), histórico do decoder
+ *      (11 bytes/frame), bytes e tamanhos aguardando pull()
+ *
+ * PCM na ordem de bytes da máquina, como no resto da extensão.
+ */
+#define BCG729_STATE_MAGIC   "BG7S"
+#define BCG729_STATE_VERSION 2
+#define BCG729_STATE_HEADER  20
+
+#define BCG729_STATE_ANNEXB      0x01
+#define BCG729_STATE_IN_CNG      0x02
+#define BCG729_STATE_ENCODER     0x04
+#define BCG729_STATE_DECODER     0x08
+#define BCG729_STATE_ENC_EXACT   0x10
+#define BCG729_STATE_DEC_EXACT   0x20
+#define BCG729_STATE_SID         0x40
+
+static void bcg729_put_le16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+}
+
+static void bcg729_put_le32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char) v;
+    p[1] = (unsigned char) (v >> 8);
+    p[2] = (unsigned char) (v >> 16);
+    p[3] = (unsigned char) (v >> 24);
+}
+
+static uint32_t bcg729_get_le16(const unsigned char *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8);
+}
+
+static uint32_t bcg729_get_le32(const unsigned char *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static zend_string *bcg729_channel_export(bcg729Channel *self) {
+    if (self->closed) {
+        php_error_docref(NULL, E_WARNING, "Cannot export the state of a closed channel");
+        return NULL;
+    }
+    if ((self->encoder && !self->enc_hist.exact && self->enc_hist.count == 0)
+        || (self->decoder && !self->dec_hist.exact && self->dec_hist.count == 0)) {
+        php_error_docref(NULL, E_WARNING, "Channel state was not recorded (bcg729.state_frames = 0)");
+        return NULL;
+    }
+
+    uint32_t enc_count = self->encoder ? self->enc_hist.count : 0;
+    uint32_t dec_count = self->decoder ? self->dec_hist.count : 0;
+    zend_bool sid = self->decoder && self->dec_hist.has_sid;
+    size_t len = BCG729_STATE_HEADER + self->pcm_tail_len
+        + ((size_t) enc_count * BCG729_HIST_PCM_ITEM) + (sid ? 2 : 0) + ((size_t) dec_count * BCG729_HIST_DEC_ITEM)
+        + self->pending.len + self->pending_lens.len;
+    zend_string *out = zend_string_alloc(len, 0);
+    uint8_t *p = (uint8_t *) ZSTR_VAL(out);
+    uint8_t flags = 0;
+
+    flags |= self->annexb ? BCG729_STATE_ANNEXB : 0;
+    flags |= self->decoder_in_cng ? BCG729_STATE_IN_CNG : 0;
+    flags |= self->encoder ? BCG729_STATE_ENCODER : 0;
+    flags |= self->decoder ? BCG729_STATE_DECODER : 0;
+    flags |= (self->encoder && self->enc_hist.exact) ? BCG729_STATE_ENC_EXACT : 0;
+    flags |= (self->decoder && self->dec_hist.exact) ? BCG729_STATE_DEC_EXACT : 0;
+    flags |= sid ? BCG729_STATE_SID : 0;
+
+    memcpy(p, BCG729_STATE_MAGIC, 4);
+    p[4] = BCG729_STATE_VERSION;
+    p[5] = flags;
+    p[6] = (uint8_t) self->mode;
+    p[7] = (uint8_t) self->pcm_tail_len;
+    bcg729_put_le16(p + 8, (uint16_t) enc_count);
+    bcg729_put_le16(p + 10, (uint16_t) dec_count);
+    bcg729_put_le32(p + 12, (uint32_t) self->pending.len);
+    bcg729_put_le32(p + 16, (uint32_t) self->pending_lens.len);
+    p += BCG729_STATE_HEADER;
+
+    memcpy(p, self->pcm_tail, self->pcm_tail_len);
+    p += self->pcm_tail_len;
+    for (uint32_t i = 0; i < enc_count; i++, p += BCG729_HIST_PCM_ITEM) {
+        memcpy(p, bcg729_history_item(&self->enc_hist, BCG729_HIST_PCM_ITEM, i), BCG729_HIST_PCM_ITEM);
+    }
+    if (sid) {
+        memcpy(p, self->dec_hist.sid, 2);
+        p += 2;
+    }
+    for (uint32_t i = 0; i < dec_count; i++, p += BCG729_HIST_DEC_ITEM) {
+        memcpy(p, bcg729_history_item(&self->dec_hist, BCG729_HIST_DEC_ITEM, i), BCG729_HIST_DEC_ITEM);
+    }
+    if (self->pending_lens.len) {
+        if (self->pending.len) {
+            memcpy(p, self->pending.c, self->pending.len);
+            p += self->pending.len;
+        }
+        memcpy(p, self->pending_lens.c, self->pending_lens.len);
+    }
+
+    ZSTR_VAL(out)[len] = '\0';
+    return out;
+}
+
+/* Confere tamanhos e limites do estado serializado; 0 se malformado */
+static zend_bool bcg729_state_valid(const uint8_t *p, size_t len) {
+    if (len < BCG729_STATE_HEADER || memcmp(p, BCG729_STATE_MAGIC, 4) != 0) {
+        return 0;
+    }
+    if (p[4] != BCG729_STATE_VERSION) {
+        php_error_docref(NULL, E_WARNING, "Unsupported channel state version %u", (unsigned) p[4]);
+        return 0;
+    }
+
+    uint8_t flags = p[5];
+    uint32_t enc_count = bcg729_get_le16(p + 8), dec_count = bcg729_get_le16(p + 10);
+    uint64_t pending = bcg729_get_le32(p + 12), pending_frames = bcg729_get_le32(p + 16);
+
+    if ((p[6] != BCG729_MODE_ENCODE && p[6] != BCG729_MODE_DECODE && p[6] != BCG729_MODE_BOTH)
+        || p[7] >= 160
+        || enc_count > BCG729_HIST_MAX_FRAMES || dec_count > BCG729_HIST_MAX_FRAMES
+        || ((flags & BCG729_STATE_ENCODER) && !(p[6] & BCG729_MODE_ENCODE))
+        || ((flags & BCG729_STATE_DECODER) && !(p[6] & BCG729_MODE_DECODE))
+        || (!(flags & BCG729_STATE_ENCODER) && enc_count > 0)
+        || (!(flags & BCG729_STATE_DECODER) && (dec_count > 0 || (flags & BCG729_STATE_SID)))) {
+        return 0;
+    }
+
+    size_t sid = (flags & BCG729_STATE_SID) ? 2 : 0;
+    uint64_t expected = BCG729_STATE_HEADER + (uint64_t) p[7] + ((uint64_t) enc_count * BCG729_HIST_PCM_ITEM)
+        + sid + ((uint64_t) dec_count * BCG729_HIST_DEC_ITEM) + pending + pending_frames;
+    if (expected != len) {
+        return 0;
+    }
+
+    /* tamanhos de pull() precisam somar exatamente os bytes pendentes */
+    const uint8_t *lens = p + len - pending_frames;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < pending_frames; i++) {
+        if (lens[i] != 0 && lens[i] != 2 && lens[i] != 10) {
+            return 0;
+        }
+        sum += lens[i];
+    }
+    if (sum != pending) {
+        return 0;
+    }
+
+    const uint8_t *dec = p + BCG729_STATE_HEADER + p[7] + ((size_t) enc_count * BCG729_HIST_PCM_ITEM) + sid;
+    for (uint32_t i = 0; i < dec_count; i++) {
+        if (dec[(size_t) i * BCG729_HIST_DEC_ITEM] > BCG729_HIST_CNG) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Reconstrói o canal a partir de bcg729_channel_export(): contextos novos
+ * do pool recebem de novo as mesmas entradas (sem contar nos contadores
+ * nem gerar saída), e a sobra de push()/pull() é restaurada.
+ */
+static zend_bool bcg729_channel_import(bcg729Channel *self, const zend_string *state) {
+    const uint8_t *p = (const uint8_t *) ZSTR_VAL(state);
+
+    if (!bcg729_state_valid(p, ZSTR_LEN(state))) {
+        php_error_docref(NULL, E_WARNING, "Invalid channel state");
+        return 0;
+    }
+
+    uint8_t flags = p[5];
+    uint32_t enc_count = bcg729_get_le16(p + 8), dec_count = bcg729_get_le16(p + 10);
+    size_t pending = bcg729_get_le32(p + 12), pending_frames = bcg729_get_le32(p + 16);
+
+    bcg729_channel_release(self);
+    bcg729_channel_stream_clear(self);
+    bcg729_history_free(&self->enc_hist);
+    bcg729_history_free(&self->dec_hist);
+
+    self->closed = 0;
+    self->mode = p[6];
+    self->annexb = (flags & BCG729_STATE_ANNEXB) != 0;
+    self->decoder_in_cng = (flags & BCG729_STATE_IN_CNG) != 0;
+    self->pcm_tail_len = p[7];
+    memcpy(self->pcm_tail, p + BCG729_STATE_HEADER, self->pcm_tail_len);
+    p += BCG729_STATE_HEADER + self->pcm_tail_len;
+
+    if (flags & BCG729_STATE_ENCODER) {
+        bcg729EncoderChannelContextStruct *enc = bcg729_channel_encoder(self);
+
+        for (uint32_t i = 0; i < enc_count; i++, p += BCG729_HIST_PCM_ITEM) {
+            int16_t pcm[80];
+            uint8_t scratch[10];
+            uint8_t frame_len = 0;
+
+            memcpy(pcm, p, sizeof(pcm));
+            bcg729Encoder(enc, pcm, scratch, &frame_len);
+            bcg729_history_encoder(&self->enc_hist, pcm);
+        }
+        self->enc_hist.exact = (flags & BCG729_STATE_ENC_EXACT) && self->enc_hist.count == enc_count;
+    }
+
+    if (flags & BCG729_STATE_DECODER) {
+        static const uint8_t erased[10] = {0};
+        bcg729DecoderChannelContextStruct *dec = bcg729_channel_decoder(self);
+
+        if (flags & BCG729_STATE_SID) {
+            /* SID anterior à janela: dá os parâmetros de CNG ao replay */
+            int16_t pcm[80];
+
+            bcg729Decoder(dec, p, 2, 0, 1, 0, pcm);
+            memcpy(self->dec_hist.sid, p, 2);
+            self->dec_hist.has_sid = 1;
+            p += 2;
+        }
+
+        for (uint32_t i = 0; i < dec_count; i++, p += BCG729_HIST_DEC_ITEM) {
+            int16_t pcm[80];
+
+            switch (p[0]) {
+                case BCG729_HIST_VOICE:
+                    bcg729Decoder(dec, p + 1, 10, 0, 0, 0, pcm);
+                    bcg729_history_decoder(&self->dec_hist, BCG729_HIST_VOICE, p + 1, 10);
+                    break;
+                case BCG729_HIST_SID:
+                    bcg729Decoder(dec, p + 1, 2, 0, 1, 0, pcm);
+                    bcg729_history_decoder(&self->dec_hist, BCG729_HIST_SID, p + 1, 2);
+                    break;
+                case BCG729_HIST_ERASED:
+                    bcg729Decoder(dec, erased, 10, 1, 0, 0, pcm);
+                    bcg729_history_decoder(&self->dec_hist, BCG729_HIST_ERASED, erased, 0);
+                    break;
+                default:
+                    bcg729Decoder(dec, NULL, 0, 0, 1, 0, pcm);
+                    bcg729_history_decoder(&self->dec_hist, BCG729_HIST_CNG, erased, 0);
+                    break;
+            }
+        }
+        self->dec_hist.exact = (flags & BCG729_STATE_DEC_EXACT) && self->dec_hist.count == dec_count;
+    }
+
+    if (pending_frames > 0) {
+        smart_string_appendl(&self->pending, (const char *) p, pending);
+        smart_string_appendl(&self->pending_lens, (const char *) p + pending, pending_frames);
+    }
+
+    return 1;
+}
+
+/*
+ * Estado do codec num blob binário versionado, para migrar a chamada
+ * para outro worker com importState(); false se o canal estiver fechado
+ * ou o histórico estiver desativado.
+ */
+ZEND_METHOD(bcg729Channel, exportState) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    zend_string *state = bcg729_channel_export(Z_BCG729_CHANNEL_P(getThis()));
+    if (!state) {
+        RETURN_FALSE;
+    }
+    RETURN_STR(state);
+}
+
+ZEND_METHOD(bcg729Channel, importState) {
+    zend_string *state;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(state)
+    ZEND_PARSE_PARAMETERS_END();
+
+    RETURN_BOOL(bcg729_channel_import(Z_BCG729_CHANNEL_P(getThis()), state));
+}
+
+ZEND_METHOD(bcg729Channel, __serialize) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    zend_string *state = bcg729_channel_export(Z_BCG729_CHANNEL_P(getThis()));
+    if (!state) {
+        zend_throw_exception_ex(zend_ce_exception, 0, "bcg729Channel state cannot be serialized");
+        RETURN_THROWS();
+    }
+
+    array_init_size(return_value, 1);
+    add_assoc_str(return_value, "state", state);
+}
+
+ZEND_METHOD(bcg729Channel, __unserialize) {
+    HashTable *data;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_ARRAY_HT(data)
+    ZEND_PARSE_PARAMETERS_END();
+
+    zval *state = zend_hash_str_find(data, "state", sizeof("state") - 1);
+    if (!state || Z_TYPE_P(state) != IS_STRING || !bcg729_channel_import(Z_BCG729_CHANNEL_P(getThis()), Z_STR_P(state))) {
+        zend_throw_exception_ex(zend_ce_exception, 0, "Invalid serialized bcg729Channel state");
+        RETURN_THROWS();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/*    bcg729_transcode_file: arquivo -> arquivo em blocos                     */
+/* ------------------------------------------------------------------------- */
+
+#define BCG729_FMT_G729 1
+#define BCG729_FMT_PCMA 2
+#define BCG729_FMT_PCMU 3
+#define BCG729_FMT_PCM  4   /* 16-bit LE */
+#define BCG729_FMT_L16  5   /* 16-bit BE */
+#define BCG729_FMT_WAV  6
+
+#define BCG729_WAVE_FORMAT_PCM   1
+#define BCG729_WAVE_FORMAT_ALAW  6
+#define BCG729_WAVE_FORMAT_MULAW 7
+
+#define BCG729_XCODE_CHUNK_FRAMES     500    /* 5 s de áudio por bloco */
+#define BCG729_XCODE_MAX_CHUNK_FRAMES 60000
+#define BCG729_XCODE_MIN_SLICE        4096   /* amostras mínimas por thread */
+
+static int bcg729_format_from_name(const zend_string *name) {
+    if (zend_string_equals_literal_ci(name, "g729")) {
+        return BCG729_FMT_G729;
+    }
+    if (zend_string_equals_literal_ci(name, "pcma") || zend_string_equals_literal_ci(name, "alaw")) {
+        return BCG729_FMT_PCMA;
+    }
+    if (zend_string_equals_literal_ci(name, "pcmu") || zend_string_equals_literal_ci(name, "ulaw")) {
+        return BCG729_FMT_PCMU;
+    }
+    if (zend_string_equals_literal_ci(name, "pcm")) {
+        return BCG729_FMT_PCM;
+    }
+    if (zend_string_equals_literal_ci(name, "l16")) {
+        return BCG729_FMT_L16;
+    }
+    if (zend_string_equals_literal_ci(name, "wav")) {
+        return BCG729_FMT_WAV;
+    }
+    return 0;
+}
+
+/* Bytes por amostra dos formatos sem estado */
+static size_t bcg729_format_sample_bytes(int fmt) {
+    return (fmt == BCG729_FMT_PCMA || fmt == BCG729_FMT_PCMU) ? 1 : 2;
+}
+
+/* Cabeçalho RIFF/WAVE canônico de 44 bytes, mono */
+static void bcg729_wav_header(unsigned char h[44], int fmt, uint32_t rate, uint32_t data_bytes) {
+    uint16_t bytes = (uint16_t) bcg729_format_sample_bytes(fmt);
+    uint16_t tag = fmt == BCG729_FMT_PCMA ? BCG729_WAVE_FORMAT_ALAW
+                 : fmt == BCG729_FMT_PCMU ? BCG729_WAVE_FORMAT_MULAW : BCG729_WAVE_FORMAT_PCM;
+
+    memcpy(h, "RIFF", 4);
+    bcg729_put_le32(h + 4, data_bytes > UINT32_MAX - 36 ? UINT32_MAX : 36 + data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    bcg729_put_le32(h + 16, 16);
+    bcg729_put_le16(h + 20, tag);
+    bcg729_put_le16(h + 22, 1);
+    bcg729_put_le32(h + 24, rate);
+    bcg729_put_le32(h + 28, rate * bytes);
+    bcg729_put_le16(h + 32, bytes);
+    bcg729_put_le16(h + 34, (uint16_t) (bytes * 8));
+    memcpy(h + 36, "data", 4);
+    bcg729_put_le32(h + 40, data_bytes);
+}
+
+/* Lê até n bytes, repetindo leituras curtas; menos que n só no EOF/erro */
+static size_t bcg729_stream_read_full(php_stream *stream, char *buf, size_t n) {
+    size_t got = 0;
+
+    while (got < n) {
+        ssize_t r = php_stream_read(stream, buf + got, n - got);
+        if (r <= 0) {
+            break;
+        }
+        got += (size_t) r;
+    }
+    return got;
+}
+
+static zend_bool bcg729_stream_write_full(php_stream *stream, const char *buf, size_t n) {
+    while (n > 0) {
+        ssize_t w = php_stream_write(stream, buf, n);
+        if (w <= 0) {
+            return 0;
+        }
+        buf += w;
+        n -= (size_t) w;
+    }
+    return 1;
+}
+
+/* Leitura "completa" via callback: o parser de WAV não depende da origem */
+typedef size_t (*bcg729_read_fn)(void *handle, char *buf, size_t n);
+
+static size_t bcg729_php_stream_read_fn(void *handle, char *buf, size_t n) {
+    return bcg729_stream_read_full((php_stream *) handle, buf, n);
+}
+
+/* Descarta n bytes lendo (funciona também em streams sem seek) */
+static zend_bool bcg729_read_skip(bcg729_read_fn read, void *handle, size_t n) {
+    char tmp[512];
+
+    while (n > 0) {
+        size_t step = n < sizeof(tmp) ? n : sizeof(tmp);
+        if (read(handle, tmp, step) != step) {
+            return 0;
+        }
+        n -= step;
+    }
+    return 1;
+}
+
+/*
+ * Lê o cabeçalho RIFF até o início do chunk data. Aceita mono PCM 16-bit,
+ * A-law e μ-law; retorna o formato (BCG729_FMT_*) ou 0 se não suportado.
+ * data_bytes recebe o tamanho declarado (0 = até o fim do arquivo).
+ */
+static int bcg729_wav_read_header(bcg729_read_fn read, void *handle, uint32_t *rate, uint32_t *data_bytes) {
+    unsigned char h[16];
+    int fmt = 0;
+
+    if (read(handle, (char *) h, 12) != 12
+        || memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0) {
+        return 0;
+    }
+
+    for (;;) {
+        if (read(handle, (char *) h, 8) != 8) {
+            return 0;
+        }
+
+        uint32_t size = bcg729_get_le32(h + 4);
+
+        if (memcmp(h, "data", 4) == 0) {
+            *data_bytes = size == UINT32_MAX ? 0 : size;
+            return fmt;
+        }
+
+        if (memcmp(h, "fmt ", 4) == 0 && size >= 16) {
+            if (read(handle, (char *) h, 16) != 16) {
+                return 0;
+            }
+            unsigned tag = h[0] | (h[1] << 8);
+            unsigned channels = h[2] | (h[3] << 8);
+            unsigned bits = h[14] | (h[15] << 8);
+
+            *rate = bcg729_get_le32(h + 4);
+            if (channels != 1) {
+                fmt = 0;
+            } else if (tag == BCG729_WAVE_FORMAT_PCM && bits == 16) {
+                fmt = BCG729_FMT_PCM;
+            } else if (tag == BCG729_WAVE_FORMAT_ALAW && bits == 8) {
+                fmt = BCG729_FMT_PCMA;
+            } else if (tag == BCG729_WAVE_FORMAT_MULAW && bits == 8) {
+                fmt = BCG729_FMT_PCMU;
+            }
+            size -= 16;
+        }
+
+        /* chunks RIFF são alinhados em 2 bytes */
+        if (!bcg729_read_skip(read, handle, (size_t) size + (size & 1))) {
+            return 0;
+        }
+    }
+}
+
+/* Formato sem estado -> PCM linear */
+static void bcg729_xcode_to_pcm(int fmt, const unsigned char *in, size_t samples, int16_t *pcm) {
+    switch (fmt) {
+        case BCG729_FMT_PCMA:
+            bcg729_alaw_decode(pcm, in, samples);
+            break;
+        case BCG729_FMT_PCMU:
+            bcg729_ulaw_decode(pcm, in, samples);
+            break;
+        case BCG729_FMT_L16:
+            bcg729_swap16((unsigned char *) pcm, in, samples * 2);
+            break;
+        default:
+            memcpy(pcm, in, samples * 2);
+            break;
+    }
+}
+
+/* PCM linear -> formato sem estado */
+static void bcg729_xcode_from_pcm(int fmt, const int16_t *pcm, size_t samples, unsigned char *out) {
+    switch (fmt) {
+        case BCG729_FMT_PCMA:
+            for (size_t i = 0; i < samples; i++) {
+                out[i] = linear_to_alaw[(uint16_t) pcm[i]];
+            }
+            break;
+        case BCG729_FMT_PCMU:
+            for (size_t i = 0; i < samples; i++) {
+                out[i] = linear_to_ulaw[(uint16_t) pcm[i]];
+            }
+            break;
+        case BCG729_FMT_L16:
+            bcg729_swap16(out, (const unsigned char *) pcm, samples * 2);
+            break;
+        default:
+            memcpy(out, pcm, samples * 2);
+            break;
+    }
+}
+
+/* Converte as amostras [start, end) entre dois formatos sem estado */
+static void bcg729_xcode_stateless(int in_fmt, int out_fmt, const unsigned char *in, unsigned char *out, size_t start, size_t end) {
+    size_t ib = bcg729_format_sample_bytes(in_fmt);
+    size_t ob = bcg729_format_sample_bytes(out_fmt);
+
+    in += start * ib;
+    out += start * ob;
+
+    if (in_fmt == out_fmt) {
+        memcpy(out, in, (end - start) * ib);
+        return;
+    }
+    if (ib == 1 && ob == 1) {
+        const uint8_t *table = in_fmt == BCG729_FMT_PCMA ? alaw_to_ulaw : ulaw_to_alaw;
+        for (size_t i = 0; i < end - start; i++) {
+            out[i] = table[in[i]];
+        }
+        return;
+    }
+
+    while (start < end) {
+        int16_t pcm[1024];
+        size_t n = end - start < 1024 ? end - start : 1024;
+
+        bcg729_xcode_to_pcm(in_fmt, in, n, pcm);
+        bcg729_xcode_from_pcm(out_fmt, pcm, n, out);
+        in += n * ib;
+        out += n * ob;
+        start += n;
+    }
+}
+
+typedef struct {
+    int in_fmt;
+    int out_fmt;
+    const unsigned char *in;
+    unsigned char *out;
+    size_t samples;
+    size_t slice;
+} bcg729XcodeRun;
+
+static void bcg729_xcode_task(void *ctx, size_t i) {
+    bcg729XcodeRun *run = ctx;
+    size_t start = i * run->slice;
+    size_t end = start + run->slice < run->samples ? start + run->slice : run->samples;
+
+    if (start < end) {
+        bcg729_xcode_stateless(run->in_fmt, run->out_fmt, run->in, run->out, start, end);
+    }
+}
+
+/*
+ * Bloco com G.729 em algum dos lados: sequencial, frame a frame, com os
+ * contextos mantendo estado entre blocos. A última amostra parcial é
+ * completada com silêncio. Retorna os bytes escritos em out.
+ */
+static size_t bcg729_xcode_g729(bcg729DecoderChannelContextStruct *dec, bcg729EncoderChannelContextStruct *enc,
+                                int in_fmt, int out_fmt, const unsigned char *in, size_t samples, unsigned char *out) {
+    size_t ib = bcg729_format_sample_bytes(in_fmt);
+    size_t ob = bcg729_format_sample_bytes(out_fmt);
+    size_t frames = (samples + 79) / 80;
+    size_t pos = 0;
+
+    for (size_t f = 0; f < frames; f++) {
+        int16_t pcm[80];
+
+        if (in_fmt == BCG729_FMT_G729) {
+            bcg729Decoder(dec, in + (f * 10), 10, 0, 0, 0, pcm);
+        } else {
+            size_t n = samples - (f * 80) < 80 ? samples - (f * 80) : 80;
+            if (n < 80) {
+                memset(pcm, 0, sizeof(pcm));
+            }
+            bcg729_xcode_to_pcm(in_fmt, in + (f * 80 * ib), n, pcm);
+        }
+
+        if (out_fmt == BCG729_FMT_G729) {
+            uint8_t frame_len = 0;
+            bcg729Encoder(enc, pcm, out + pos, &frame_len);
+            pos += frame_len;
+        } else {
+            bcg729_xcode_from_pcm(out_fmt, pcm, 80, out + pos);
+            pos += 80 * ob;
+        }
+    }
+
+    return pos;
+}
+
+static double bcg729_now(void) {
+    return (double) bcg729_clock_ns() / 1e9;
+}
+
+/*
+ * bcg729_transcode_file(string $src, string $dst, string $from, string $to, array $opts = []): array|false
+ *
+ * Lê $src em blocos de tamanho fixo, converte em C e grava em $dst, com
+ * memória limitada ao tamanho do bloco. Formatos: g729, pcma/alaw,
+ * pcmu/ulaw, pcm (16-bit LE), l16 (16-bit BE) e wav (mono PCM/A-law/μ-law).
+ * Opções: chunk_frames (frames de 10 ms por bloco), threads (divide
+ * conversões sem estado pelo pool de bcg729.threads), annex_b (VAD no
+ * encoder G.729) e wav_format (pcm, pcma ou pcmu ao gravar WAV).
+ */
+ZEND_FUNCTION(bcg729_transcode_file) {
+    zend_string *src_path, *dst_path, *from_name, *to_name;
+    HashTable *opts = NULL;
+
+    ZEND_PARSE_PARAMETERS_START(4, 5)
+        Z_PARAM_PATH_STR(src_path)
+        Z_PARAM_PATH_STR(dst_path)
+        Z_PARAM_STR(from_name)
+        Z_PARAM_STR(to_name)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_ARRAY_HT(opts)
+    ZEND_PARSE_PARAMETERS_END();
+
+    int from = bcg729_format_from_name(from_name);
+    if (!from) {
+        zend_argument_value_error(3, "must be one of \"g729\", \"pcma\", \"pcmu\", \"pcm\", \"l16\" or \"wav\"");
+        RETURN_THROWS();
+    }
+    int to = bcg729_format_from_name(to_name);
+    if (!to) {
+        zend_argument_value_error(4, "must be one of \"g729\", \"pcma\", \"pcmu\", \"pcm\", \"l16\" or \"wav\"");
+        RETURN_THROWS();
+    }
+
+    zend_long chunk_frames = BCG729_XCODE_CHUNK_FRAMES;
+    zend_bool use_threads = 0, annexb = 0;
+    int out_fmt = to == BCG729_FMT_WAV ? BCG729_FMT_PCM : to;
+    zval *opt;
+
+    if (opts) {
+        if ((opt = zend_hash_str_find(opts, "chunk_frames", sizeof("chunk_frames") - 1))) {
+            chunk_frames = zval_get_long(opt);
+            if (chunk_frames < 1 || chunk_frames > BCG729_XCODE_MAX_CHUNK_FRAMES) {
+                zend_argument_value_error(5, "option \"chunk_frames\" must be between 1 and %d", BCG729_XCODE_MAX_CHUNK_FRAMES);
+                RETURN_THROWS();
+            }
+        }
+        if ((opt = zend_hash_str_find(opts, "threads", sizeof("threads") - 1))) {
+            use_threads = zend_is_true(opt);
+        }
+        if ((opt = zend_hash_str_find(opts, "annex_b", sizeof("annex_b") - 1))) {
+            annexb = zend_is_true(opt);
+        }
+        if (to == BCG729_FMT_WAV && (opt = zend_hash_str_find(opts, "wav_format", sizeof("wav_format") - 1))) {
+            zend_string *name = zval_get_string(opt);
+            out_fmt = bcg729_format_from_name(name);
+            zend_string_release(name);
+            if (out_fmt != BCG729_FMT_PCM && out_fmt != BCG729_FMT_PCMA && out_fmt != BCG729_FMT_PCMU) {
+                zend_argument_value_error(5, "option \"wav_format\" must be \"pcm\", \"pcma\" or \"pcmu\"");
+                RETURN_THROWS();
+            }
+        }
+    }
+
+    php_stream *in = php_stream_open_wrapper(ZSTR_VAL(src_path), "rb", REPORT_ERRORS, NULL);
+    if (!in) {
+        RETURN_FALSE;
+    }
+
+    int in_fmt = from;
+    uint32_t rate = 8000, data_bytes = 0;
+
+    if (from == BCG729_FMT_WAV) {
+        in_fmt = bcg729_wav_read_header(bcg729_php_stream_read_fn, in, &rate, &data_bytes);
+        if (!in_fmt) {
+            php_error_docref(NULL, E_WARNING, "%s is not a mono PCM 16-bit, A-law or mu-law WAV file", ZSTR_VAL(src_path));
+            php_stream_close(in);
+            RETURN_FALSE;
+        }
+    }
+
+    if ((in_fmt == BCG729_FMT_G729 || out_fmt == BCG729_FMT_G729) && rate != 8000) {
+        php_error_docref(NULL, E_WARNING, "G.729 requires 8000 Hz audio, %s is %u Hz", ZSTR_VAL(src_path), rate);
+        php_stream_close(in);
+        RETURN_FALSE;
+    }
+
+    php_stream *out = php_stream_open_wrapper(ZSTR_VAL(dst_path), "wb", REPORT_ERRORS, NULL);
+    if (!out) {
+        php_stream_close(in);
+        RETURN_FALSE;
+    }
+
+    unsigned char header[44];
+    zend_bool ok = 1;
+
+    if (to == BCG729_FMT_WAV) {
+        bcg729_wav_header(header, out_fmt, rate, 0);
+        ok = bcg729_stream_write_full(out, (const char *) header, sizeof(header));
+    }
+
+    zend_bool stateful = in_fmt == BCG729_FMT_G729 || out_fmt == BCG729_FMT_G729;
+    int enc_kind = annexb ? BCG729_POOL_ENCODER_VAD : BCG729_POOL_ENCODER;
+    bcg729DecoderChannelContextStruct *dec = in_fmt == BCG729_FMT_G729 ? bcg729_pool_acquire(BCG729_POOL_DECODER) : NULL;
+    bcg729EncoderChannelContextStruct *enc = out_fmt == BCG729_FMT_G729 ? bcg729_pool_acquire(enc_kind) : NULL;
+
+    size_t ib = in_fmt == BCG729_FMT_G729 ? 10 : bcg729_format_sample_bytes(in_fmt) * 80;  /* por frame */
+    size_t ob = out_fmt == BCG729_FMT_G729 ? 10 : bcg729_format_sample_bytes(out_fmt) * 80;
+    size_t in_cap = (size_t) chunk_frames * ib;
+    char *in_buf = emalloc(in_cap);
+    unsigned char *out_buf = emalloc((size_t) chunk_frames * ob);
+    int threads = use_threads && !stateful ? bcg729_threads_available() : 1;
+
+    uint64_t remaining = data_bytes ? data_bytes : UINT64_MAX;
+    uint64_t bytes_in = 0, bytes_out = 0, samples_total = 0;
+    zend_long chunks = 0;
+    double started = bcg729_now();
+
+    while (ok && remaining > 0) {
+        size_t want = remaining < in_cap ? (size_t) remaining : in_cap;
+        size_t got = bcg729_stream_read_full(in, in_buf, want);
+        size_t samples, produced;
+
+        if (got == 0) {
+            break;
+        }
+        remaining -= got;
+        bytes_in += got;
+
+        if (in_fmt == BCG729_FMT_G729) {
+            samples = (got / 10) * 80; /* frame incompleto no fim é descartado */
+        } else {
+            samples = got / bcg729_format_sample_bytes(in_fmt);
+        }
+
+        if (stateful) {
+            produced = bcg729_xcode_g729(dec, enc, in_fmt, out_fmt, (const unsigned char *) in_buf, samples, out_buf);
+        } else {
+            bcg729XcodeRun run = { in_fmt, out_fmt, (const unsigned char *) in_buf, out_buf, samples, samples };
+            size_t tasks = 1;
+
+            if (threads > 1 && samples >= 2 * BCG729_XCODE_MIN_SLICE) {
+                tasks = samples / BCG729_XCODE_MIN_SLICE < (size_t) threads ? samples / BCG729_XCODE_MIN_SLICE : (size_t) threads;
+                run.slice = (samples + tasks - 1) / tasks;
+            }
+            if (tasks == 1 || !bcg729_threads_run(bcg729_xcode_task, &run, tasks)) {
+                bcg729_xcode_stateless(in_fmt, out_fmt, run.in, out_buf, 0, samples);
+            }
+            produced = samples * bcg729_format_sample_bytes(out_fmt);
+        }
+
+        if (!bcg729_stream_write_full(out, (const char *) out_buf, produced)) {
+            php_error_docref(NULL, E_WARNING, "Failed to write to %s", ZSTR_VAL(dst_path));
+            ok = 0;
+            break;
+        }
+
+        bytes_out += produced;
+        samples_total += samples;
+        chunks++;
+
+        if (got < want) {
+            break;
+        }
+    }
+
+    /* Corrige os tamanhos RIFF/data agora que o total é conhecido */
+    if (ok && to == BCG729_FMT_WAV) {
+        bcg729_wav_header(header, out_fmt, rate, bytes_out > UINT32_MAX ? UINT32_MAX : (uint32_t) bytes_out);
+        if (php_stream_seek(out, 0, SEEK_SET) != 0
+            || !bcg729_stream_write_full(out, (const char *) header, sizeof(header))) {
+            php_error_docref(NULL, E_WARNING, "Could not rewrite the WAV header of %s (stream not seekable)", ZSTR_VAL(dst_path));
+        }
+    }
+
+    double elapsed = bcg729_now() - started;
+
+    if (dec) {
+        bcg729_pool_release(BCG729_POOL_DECODER, dec);
+    }
+    if (enc) {
+        bcg729_pool_release(enc_kind, enc);
+    }
+    efree(in_buf);
+    efree(out_buf);
+    php_stream_close(in);
+    php_stream_close(out);
+
+    if (!ok) {
+        RETURN_FALSE;
+    }
+
+    double audio_seconds = (double) samples_total / (double) rate;
+
+    array_init_size(return_value, 9);
+    add_assoc_long(return_value, "samples", (zend_long) samples_total);
+    add_assoc_long(return_value, "bytes_in", (zend_long) bytes_in);
+    add_assoc_long(return_value, "bytes_out", (zend_long) bytes_out);
+    add_assoc_long(return_value, "chunks", chunks);
+    add_assoc_long(return_value, "threads", threads);
+    add_assoc_long(return_value, "sample_rate", (zend_long) rate);
+    add_assoc_double(return_value, "audio_seconds", audio_seconds);
+    add_assoc_double(return_value, "elapsed", elapsed);
+    add_assoc_double(return_value, "speed", elapsed > 0 ? audio_seconds / elapsed : 0.0);
+}
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_transcode_file, 0, 4, MAY_BE_ARRAY | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, src, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, dst, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, from, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, to, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, opts, IS_ARRAY, 0, "[]")
+ZEND_END_ARG_INFO()
+
+/* ------------------------------------------------------------------------- */
+/*    mixEncoded: mix direto de entradas G.711/PCM com ganho por canal        */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Processa em blocos de BCG729_MIX_BLOCK amostras que cabem no L1: cada
+ * entrada é expandida (kernels G.711) num buffer de pilha e acumulada com
+ * ganho Q12 (kernel MAC 16×16→32); o bloco é saturado e codificado no
+ * formato de saída antes de passar ao próximo. Nenhuma string PCM
+ * intermediária por entrada.
+ */
+
+#define BCG729_MIX_BLOCK     256
+#define BCG729_MIX_UNITY_Q12 4096
+
+ZEND_FUNCTION(mixEncoded) {
+    HashTable *inputs, *gains = NULL;
+    zend_string *in_name, *out_name;
+
+    ZEND_PARSE_PARAMETERS_START(3, 4)
+        Z_PARAM_ARRAY_HT(inputs)
+        Z_PARAM_STR(in_name)
+        Z_PARAM_STR(out_name)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_ARRAY_HT(gains)
+    ZEND_PARSE_PARAMETERS_END();
+
+    int in_fmt = bcg729_format_from_name(in_name);
+    int out_fmt = bcg729_format_from_name(out_name);
+    if (in_fmt != BCG729_FMT_PCM && in_fmt != BCG729_FMT_PCMA && in_fmt != BCG729_FMT_PCMU) {
+        zend_argument_value_error(2, "must be \"pcm\", \"pcma\" or \"pcmu\"");
+        RETURN_THROWS();
+    }
+    if (out_fmt != BCG729_FMT_PCM && out_fmt != BCG729_FMT_PCMA && out_fmt != BCG729_FMT_PCMU) {
+        zend_argument_value_error(3, "must be \"pcm\", \"pcma\" or \"pcmu\"");
+        RETURN_THROWS();
+    }
+
+    uint32_t count = zend_hash_num_elements(inputs);
+    if (count == 0) {
+        RETURN_EMPTY_STRING();
+    }
+
+    size_t in_sb = bcg729_format_sample_bytes(in_fmt);
+    size_t out_sb = bcg729_format_sample_bytes(out_fmt);
+    const unsigned char **src = safe_emalloc(count, sizeof(*src), 0);
+    size_t *lens = safe_emalloc(count, sizeof(*lens), 0);
+    int16_t *gain_q12 = safe_emalloc(count, sizeof(*gain_q12), 0);
+    size_t max_samples = 0;
+    uint32_t n = 0;
+    zend_ulong idx;
+    zend_string *key;
+    zval *data;
+
+    ZEND_HASH_FOREACH_KEY_VAL(inputs, idx, key, data) {
+        ZVAL_DEREF(data);
+        if (Z_TYPE_P(data) != IS_STRING || (Z_STRLEN_P(data) % in_sb) != 0) {
+            efree(src);
+            efree(lens);
+            efree(gain_q12);
+            zend_argument_value_error(1, "must contain only strings with whole %s samples", ZSTR_VAL(in_name));
+            RETURN_THROWS();
+        }
+
+        double gain = 1.0;
+        zval *zg = NULL;
+        if (gains) {
+            zg = key ? zend_hash_find(gains, key) : zend_hash_index_find(gains, idx);
+        }
+        if (zg) {
+            ZVAL_DEREF(zg);
+            gain = zval_get_double(zg);
+            if (!(gain >= 0.0 && gain < 8.0)) {
+                efree(src);
+                efree(lens);
+                efree(gain_q12);
+                zend_argument_value_error(4, "must contain gains between 0.0 and 8.0 (exclusive)");
+                RETURN_THROWS();
+            }
+        }
+
+        src[n] = (const unsigned char *) Z_STRVAL_P(data);
+        lens[n] = Z_STRLEN_P(data) / in_sb;
+        /* ganhos a partir de 32767/4096 (~7.9998) arredondam para 32768: satura em Q12 */
+        long q12 = lrint(gain * BCG729_MIX_UNITY_Q12);
+        gain_q12[n] = (int16_t) (q12 > INT16_MAX ? INT16_MAX : q12);
+        if (lens[n] > max_samples) {
+            max_samples = lens[n];
+        }
+        n++;
+    } ZEND_HASH_FOREACH_END();
+
+    zend_string *out = zend_string_alloc(max_samples * out_sb, 0);
+    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
+    int32_t acc[BCG729_MIX_BLOCK];
+    int16_t pcm[BCG729_MIX_BLOCK];
+
+    for (size_t base = 0; base < max_samples; base += BCG729_MIX_BLOCK) {
+        size_t block = max_samples - base < BCG729_MIX_BLOCK ? max_samples - base : BCG729_MIX_BLOCK;
+        memset(acc, 0, sizeof(int32_t) * block);
+
+        for (uint32_t c = 0; c < n; c++) {
+            if (lens[c] <= base || gain_q12[c] == 0) {
+                continue;
+            }
+            size_t take = lens[c] - base < block ? lens[c] - base : block;
+            const int16_t *samples;
+
+            if (in_fmt == BCG729_FMT_PCMA) {
+                bcg729_alaw_decode(pcm, src[c] + base, take);
+                samples = pcm;
+            } else if (in_fmt == BCG729_FMT_PCMU) {
+                bcg729_ulaw_decode(pcm, src[c] + base, take);
+                samples = pcm;
+            } else {
+                samples = (const int16_t *) (src[c] + (base * 2));
+            }
+            bcg729_mac_q12(acc, samples, gain_q12[c], take);
+        }
+
+        for (size_t i = 0; i < block; i++) {
+            int32_t v = acc[i];
+            pcm[i] = (int16_t) (v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+        }
+
+        if (out_fmt == BCG729_FMT_PCMA) {
+            for (size_t i = 0; i < block; i++) {
+                dst[base + i] = linear_to_alaw[(uint16_t) pcm[i]];
+            }
+        } else if (out_fmt == BCG729_FMT_PCMU) {
+            for (size_t i = 0; i < block; i++) {
+                dst[base + i] = linear_to_ulaw[(uint16_t) pcm[i]];
+            }
+        } else {
+            memcpy(dst + (base * 2), pcm, block * 2);
+        }
+    }
+
+    efree(src);
+    efree(lens);
+    efree(gain_q12);
+
+    ZSTR_VAL(out)[max_samples * out_sb] = '\0';
+    RETURN_STR(out);
+}
+
+/* ------------------------------------------------------------------------- */
+/*    analyzePcm / bcg729Analyzer: níveis, clipping e VAD por energia         */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Uma passada por frame (kernel SIMD acima) dá energia, pico, trocas de
+ * sinal e amostras clipadas. O VAD compara o nível do frame em dBFS com
+ * um piso de ruído adaptativo (desce rápido, sobe devagar) mais uma
+ * margem, com hangover para não picotar o fim das palavras.
+ *
+ * O resultado é colunar (um array por métrica) para não criar um array
+ * PHP por frame.
+ */
+
+#define BCG729_ANALYZE_MAX_FRAME 48000
+#define BCG729_ANALYZE_SILENCE_DB (-100.0)
+
+typedef struct {
+    zend_long frame_samples;
+    zend_long sample_rate;
+    double margin_db;            /* nível acima do piso de ruído para ser voz */
+    double floor_db;             /* abaixo disso nunca é voz */
+    uint32_t hangover_frames;
+    double noise_db;             /* piso de ruído estimado */
+    uint32_t hangover;           /* frames de voz restantes após o último frame forte */
+    int16_t prev;                /* última amostra, para as trocas de sinal */
+    uint64_t frames;
+    uint64_t speech_frames;
+} bcg729VadState;
+
+static void bcg729_vad_init(bcg729VadState *vad, zend_long frame_samples, zend_long sample_rate, double margin_db, double floor_db, zend_long hangover_ms) {
+    vad->frame_samples = frame_samples;
+    vad->sample_rate = sample_rate;
+    vad->margin_db = margin_db;
+    vad->floor_db = floor_db;
+    vad->hangover_frames = (uint32_t) ((hangover_ms * sample_rate) / (1000 * frame_samples));
+    vad->noise_db = -70.0;
+    vad->hangover = 0;
+    vad->prev = 0;
+    vad->frames = 0;
+    vad->speech_frames = 0;
+}
+
+static double bcg729_level_db(double rms) {
+    return rms > 0 ? 20.0 * log10(rms / 32768.0) : BCG729_ANALYZE_SILENCE_DB;
+}
+
+/* Colunas de saída; frames analisados são acrescentados por bcg729_analyze_frame */
+typedef struct {
+    zval rms;
+    zval peak;
+    zval zcr;
+    zval clipped;
+    zval speech;
+} bcg729AnalyzeColumns;
+
+static void bcg729_analyze_columns_init(bcg729AnalyzeColumns *c, uint32_t frames) {
+    array_init_size(&c->rms, frames);
+    array_init_size(&c->peak, frames);
+    array_init_size(&c->zcr, frames);
+    array_init_size(&c->clipped, frames);
+    array_init_size(&c->speech, frames);
+}
+
+static void bcg729_analyze_frame(bcg729VadState *vad, const int16_t *x, size_t n, bcg729AnalyzeColumns *c) {
+    bcg729FrameStats st;
+    bcg729_frame_stats(x, n, vad->prev, &st);
+    vad->prev = x[n - 1];
+
+    double rms = sqrt((double) st.energy / (double) n);
+    double level = bcg729_level_db(rms);
+    zend_bool speech;
+
+    if (level > vad->floor_db && level > vad->noise_db + vad->margin_db) {
+        vad->hangover = vad->hangover_frames;
+        speech = 1;
+    } else if (vad->hangover > 0) {
+        vad->hangover--;
+        speech = 1;
+    } else {
+        speech = 0;
+    }
+
+    /* piso de ruído: acompanha quedas em ~5 frames, subidas em ~500 */
+    vad->noise_db += (level - vad->noise_db) * (level < vad->noise_db ? 0.2 : 0.002);
+
+    vad->frames++;
+    vad->speech_frames += speech;
+
+    add_next_index_double(&c->rms, rms);
+    add_next_index_long(&c->peak, st.peak);
+    add_next_index_double(&c->zcr, (double) st.crossings / (double) n);
+    add_next_index_long(&c->clipped, st.clipped);
+    add_next_index_bool(&c->speech, speech);
+}
+
+static void bcg729_analyze_result(zval *return_value, bcg729AnalyzeColumns *c, const bcg729VadState *vad) {
+    array_init_size(return_value, 7);
+    add_assoc_zval(return_value, "rms", &c->rms);
+    add_assoc_zval(return_value, "peak", &c->peak);
+    add_assoc_zval(return_value, "zcr", &c->zcr);
+    add_assoc_zval(return_value, "clipped", &c->clipped);
+    add_assoc_zval(return_value, "speech", &c->speech);
+    add_assoc_double(return_value, "noise_floor_db", vad->noise_db);
+}
+
+static zend_bool bcg729_analyze_args(zend_long frame_samples, uint32_t arg) {
+    if (frame_samples < 1 || frame_samples > BCG729_ANALYZE_MAX_FRAME) {
+        zend_argument_value_error(arg, "must be between 1 and %d", BCG729_ANALYZE_MAX_FRAME);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * analyzePcm(string $pcm, int $frameSamples = 80): array
+ * Colunas rms, peak, zcr, clipped e speech (um item por frame; o último
+ * pode ser parcial) e o piso de ruído estimado ao fim.
+ */
+ZEND_FUNCTION(analyzePcm) {
+    zend_string *input;
+    zend_long frame_samples = 80;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_STR(input)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(frame_samples)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!bcg729_analyze_args(frame_samples, 2)) {
+        RETURN_THROWS();
+    }
+    if (ZSTR_LEN(input) & 1) {
+        RETURN_FALSE;
+    }
+
+    size_t samples = ZSTR_LEN(input) / 2;
+    size_t fs = (size_t) frame_samples;
+    const int16_t *x = (const int16_t *) ZSTR_VAL(input);
+    bcg729VadState vad;
+    bcg729AnalyzeColumns cols;
+
+    bcg729_vad_init(&vad, frame_samples, 8000, 10.0, -60.0, 200);
+    if (samples > 0) {
+        vad.prev = x[0];
+    }
+    bcg729_analyze_columns_init(&cols, (uint32_t) ((samples + fs - 1) / fs));
+
+    for (size_t off = 0; off < samples; off += fs) {
+        bcg729_analyze_frame(&vad, x + off, samples - off < fs ? samples - off : fs, &cols);
+    }
+
+    bcg729_analyze_result(return_value, &cols, &vad);
+}
+
+typedef struct {
+    bcg729VadState vad;
+    int16_t *tail;               /* frame incompleto entre chamadas */
+    size_t tail_len;             /* em amostras */
+    unsigned char odd_byte;      /* byte solto quando a entrada tem tamanho ímpar */
+    zend_bool has_odd;
+    zend_object std;
+} bcg729Analyzer;
+
+#define Z_BCG729_ANALYZER_P(zv)  ((bcg729Analyzer *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729Analyzer, std)))
+
+static zend_class_entry *bcg729_analyzer_ce;
+static zend_object_handlers bcg729_analyzer_handlers;
+
+static zend_object *bcg729_analyzer_create(zend_class_entry *ce) {
+    bcg729Analyzer *obj = zend_object_alloc(sizeof(bcg729Analyzer), ce);
+
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_analyzer_handlers;
+
+    return &obj->std;
+}
+
+static void bcg729_analyzer_free(zend_object *object) {
+    bcg729Analyzer *obj = (bcg729Analyzer *) ((char *) object - XtOffsetOf(bcg729Analyzer, std));
+    if (obj->tail) {
+        efree(obj->tail);
+    }
+    zend_object_std_dtor(&obj->std);
+}
+
+static bcg729Analyzer *bcg729_analyzer_fetch(zval *zv) {
+    bcg729Analyzer *self = Z_BCG729_ANALYZER_P(zv);
+    if (!self->tail) {
+        zend_throw_error(NULL, "bcg729Analyzer was not initialized");
+        return NULL;
+    }
+    return self;
+}
+
+ZEND_METHOD(bcg729Analyzer, __construct) {
+    zend_long frame_samples = 80, sample_rate = 8000, hangover_ms = 200;
+    double margin_db = 10.0, floor_db = -60.0;
+
+    ZEND_PARSE_PARAMETERS_START(0, 5)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(frame_samples)
+        Z_PARAM_LONG(sample_rate)
+        Z_PARAM_DOUBLE(margin_db)
+        Z_PARAM_DOUBLE(floor_db)
+        Z_PARAM_LONG(hangover_ms)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (!bcg729_analyze_args(frame_samples, 1)) {
+        RETURN_THROWS();
+    }
+    if (sample_rate < 8000 || sample_rate > 48000) {
+        zend_argument_value_error(2, "must be between 8000 and 48000");
+        RETURN_THROWS();
+    }
+    if (hangover_ms < 0 || hangover_ms > 10000) {
+        zend_argument_value_error(5, "must be between 0 and 10000");
+        RETURN_THROWS();
+    }
+
+    bcg729Analyzer *self = Z_BCG729_ANALYZER_P(getThis());
+    if (self->tail) {
+        efree(self->tail);
+    }
+    bcg729_vad_init(&self->vad, frame_samples, sample_rate, margin_db, floor_db, hangover_ms);
+    self->tail = safe_emalloc((size_t) frame_samples, sizeof(int16_t), 0);
+    self->tail_len = 0;
+    self->has_odd = 0;
+}
+
+/*
+ * Acrescenta PCM de qualquer tamanho e analisa os frames completos; a
+ * sobra fica para a próxima chamada. Mesmo formato de retorno de
+ * analyzePcm(), com as colunas vazias se nenhum frame fechou.
+ */
+ZEND_METHOD(bcg729Analyzer, process) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Analyzer *self = bcg729_analyzer_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+
+    size_t fs = (size_t) self->vad.frame_samples;
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+    size_t len = ZSTR_LEN(input);
+    bcg729AnalyzeColumns cols;
+
+    bcg729_analyze_columns_init(&cols, (uint32_t) ((self->tail_len + (len / 2) + 1) / fs));
+
+    if (self->has_odd && len > 0) {
+        unsigned char pair[2] = { self->odd_byte, src[0] };
+        memcpy(self->tail + self->tail_len, pair, 2);
+        self->tail_len++;
+        self->has_odd = 0;
+        src++;
+        len--;
+        if (self->tail_len == fs) {
+            bcg729_analyze_frame(&self->vad, self->tail, fs, &cols);
+            self->tail_len = 0;
+        }
+    }
+
+    /* completa o frame pendente */
+    if (self->tail_len > 0) {
+        size_t need = (fs - self->tail_len) * 2;
+        size_t take = len < need ? len & ~(size_t) 1 : need;
+        memcpy(self->tail + self->tail_len, src, take);
+        self->tail_len += take / 2;
+        src += take;
+        len -= take;
+        if (self->tail_len == fs) {
+            bcg729_analyze_frame(&self->vad, self->tail, fs, &cols);
+            self->tail_len = 0;
+        }
+    }
+
+    /* frames inteiros direto da entrada (cópia só se desalinhada) */
+    for (; self->tail_len == 0 && len >= fs * 2; src += fs * 2, len -= fs * 2) {
+        if (((uintptr_t) src & 1) == 0) {
+            bcg729_analyze_frame(&self->vad, (const int16_t *) src, fs, &cols);
+        } else {
+            memcpy(self->tail, src, fs * 2);
+            bcg729_analyze_frame(&self->vad, self->tail, fs, &cols);
+        }
+    }
+
+    if (len > 0) {
+        size_t whole = len & ~(size_t) 1;
+        memcpy(self->tail + self->tail_len, src, whole);
+        self->tail_len += whole / 2;
+        if (len & 1) {
+            self->odd_byte = src[whole];
+            self->has_odd = 1;
+        }
+    }
+
+    bcg729_analyze_result(return_value, &cols, &self->vad);
+}
+
+/* Zera piso de ruído, hangover e a sobra pendente */
+ZEND_METHOD(bcg729Analyzer, reset) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729Analyzer *self = bcg729_analyzer_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+
+    bcg729VadState *vad = &self->vad;
+    uint32_t hangover_frames = vad->hangover_frames;
+    bcg729_vad_init(vad, vad->frame_samples, vad->sample_rate, vad->margin_db, vad->floor_db, 0);
+    vad->hangover_frames = hangover_frames;
+    self->tail_len = 0;
+    self->has_odd = 0;
+}
+
+ZEND_METHOD(bcg729Analyzer, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729Analyzer *self = Z_BCG729_ANALYZER_P(getThis());
+    const bcg729VadState *vad = &self->vad;
+
+    array_init(return_value);
+    add_assoc_long(return_value, "frame_samples", vad->frame_samples);
+    add_assoc_long(return_value, "sample_rate", vad->sample_rate);
+    add_assoc_double(return_value, "noise_floor_db", vad->noise_db);
+    add_assoc_bool(return_value, "speech", vad->hangover > 0);
+    add_assoc_long(return_value, "frames", (zend_long) vad->frames);
+    add_assoc_long(return_value, "speech_frames", (zend_long) vad->speech_frames);
+    add_assoc_long(return_value, "buffered_samples", (zend_long) self->tail_len);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_analyzer_construct, 0, 0, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, frameSamples, IS_LONG, 0, "80")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, sampleRate, IS_LONG, 0, "8000")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, marginDb, IS_DOUBLE, 0, "10.0")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, floorDb, IS_DOUBLE, 0, "-60.0")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, hangoverMs, IS_LONG, 0, "200")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_analyzer_process, 0, 1, IS_ARRAY, 0)
+    ZEND_ARG_TYPE_INFO(0, pcm, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_analyzer_void, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_analyzer_info, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry bcg729_analyzer_methods[] = {
+    ZEND_ME(bcg729Analyzer, __construct, arginfo_analyzer_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729Analyzer, process,     arginfo_analyzer_process,   ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Analyzer, reset,       arginfo_analyzer_void,      ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Analyzer, info,        arginfo_analyzer_info,      ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
+
+/* ------------------------------------------------------------------------- */
+/*    Classes bcg729WavWriter / bcg729WavReader                               */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Gravação/leitura de WAV mono (PCM 16-bit, A-law, μ-law) sobre php_stream,
+ * como bcg729_transcode_file(): respeita open_basedir, o CWD virtual (ZTS) e
+ * os stream wrappers. O buffer do stream é desligado e o objeto usa o seu
+ * próprio: uma escrita a cada BCG729_WAV_BUFFER bytes em vez de uma por
+ * pacote. O stream é um recurso do request, então é fechado no dtor_obj
+ * (antes do fim da lista de recursos), não no free_obj.
+ */
+
+#define BCG729_WAV_BUFFER     32768
+#define BCG729_WAV_MAX_FRAME  48000
+
+typedef struct {
+    php_stream *stream;
+    int fmt;                 /* BCG729_FMT_PCM / PCMA / PCMU */
+    uint32_t rate;
+    uint64_t data_bytes;     /* já aceitos por write(), inclusive os do buffer */
+    unsigned char *buf;
+    size_t buf_len;
+    zend_object std;
+} bcg729WavWriter;
+
+typedef struct {
+    php_stream *stream;
+    int fmt;
+    uint32_t rate;
+    uint64_t data_bytes;     /* declarado no cabeçalho (0 = até o EOF) */
+    uint64_t consumed;       /* bytes de áudio já entregues */
+    zend_off_t data_start;
+    zend_long frame_samples;
+    unsigned char *buf;
+    size_t buf_pos;
+    size_t buf_len;
+    zend_object std;
+} bcg729WavReader;
+
+#define Z_BCG729_WAV_WRITER_P(zv)  ((bcg729WavWriter *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729WavWriter, std)))
+#define Z_BCG729_WAV_READER_P(zv)  ((bcg729WavReader *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729WavReader, std)))
+
+static zend_class_entry *bcg729_wav_writer_ce;
+static zend_class_entry *bcg729_wav_reader_ce;
+static zend_object_handlers bcg729_wav_writer_handlers;
+static zend_object_handlers bcg729_wav_reader_handlers;
+
+static const char *bcg729_format_name(int fmt) {
+    switch (fmt) {
+        case BCG729_FMT_PCMA:
+            return "pcma";
+        case BCG729_FMT_PCMU:
+            return "pcmu";
+        default:
+            return "pcm";
+    }
+}
+
+/* Abre pelo wrapper do PHP, sem o buffer do stream; lança exceção em caso de erro */
+static php_stream *bcg729_wav_open(const zend_string *path, const char *mode) {
+    php_stream *stream = php_stream_open_wrapper(ZSTR_VAL(path), mode, 0, NULL);
+    if (!stream) {
+        zend_throw_exception_ex(zend_ce_exception, 0, "Could not open %s", ZSTR_VAL(path));
+        return NULL;
+    }
+    php_stream_set_option(stream, PHP_STREAM_OPTION_READ_BUFFER, PHP_STREAM_BUFFER_NONE, NULL);
+    return stream;
+}
+
+/* --- writer --------------------------------------------------------------- */
+
+/* Descarrega o buffer e regrava o cabeçalho com os tamanhos atuais */
+static zend_bool bcg729_wav_writer_sync(bcg729WavWriter *w) {
+    unsigned char header[44];
+    zend_bool ok = bcg729_stream_write_full(w->stream, (const char *) w->buf, w->buf_len);
+
+    w->buf_len = 0;
+    bcg729_wav_header(header, w->fmt, w->rate, w->data_bytes > UINT32_MAX ? UINT32_MAX : (uint32_t) w->data_bytes);
+
+    /* Cabeçalho via seek + write; falha em streams sem seek */
+    zend_off_t end = php_stream_tell(w->stream);
+    if (end < 0 || php_stream_seek(w->stream, 0, SEEK_SET) != 0
+        || !bcg729_stream_write_full(w->stream, (const char *) header, sizeof(header))
+        || php_stream_seek(w->stream, end, SEEK_SET) != 0) {
+        ok = 0;
+    }
+    php_stream_flush(w->stream);
+    return ok;
+}
+
+static zend_bool bcg729_wav_writer_close(bcg729WavWriter *w) {
+    zend_bool ok = 1;
+
+    if (w->stream) {
+        ok = bcg729_wav_writer_sync(w);
+        if (php_stream_close(w->stream) != 0) {
+            ok = 0;
+        }
+        w->stream = NULL;
+    }
+    if (w->buf) {
+        efree(w->buf);
+        w->buf = NULL;
+    }
+    return ok;
+}
+
+static zend_object *bcg729_wav_writer_create(zend_class_entry *ce) {
+    bcg729WavWriter *obj = zend_object_alloc(sizeof(bcg729WavWriter), ce);
+
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_wav_writer_handlers;
+
+    return &obj->std;
+}
+
+static void bcg729_wav_writer_dtor(zend_object *object) {
+    bcg729_wav_writer_close((bcg729WavWriter *) ((char *) object - XtOffsetOf(bcg729WavWriter, std)));
+    zend_objects_destroy_object(object);
+}
+
+/* Sem dtor_obj (fatal error) o stream já foi liberado com a lista de recursos */
+static void bcg729_wav_writer_free(zend_object *object) {
+    bcg729WavWriter *obj = (bcg729WavWriter *) ((char *) object - XtOffsetOf(bcg729WavWriter, std));
+    if (obj->buf) {
+        efree(obj->buf);
+    }
+    zend_object_std_dtor(&obj->std);
+}
+
+static bcg729WavWriter *bcg729_wav_writer_fetch(zval *zv) {
+    bcg729WavWriter *self = Z_BCG729_WAV_WRITER_P(zv);
+    if (!self->stream) {
+        php_error_docref(NULL, E_WARNING, "WAV writer is closed or not initialized");
+        return NULL;
+    }
+    return self;
+}
+
+ZEND_METHOD(bcg729WavWriter, __construct) {
+    zend_string *path, *format = NULL;
+    zend_long rate = 8000;
+
+    ZEND_PARSE_PARAMETERS_START(1, 3)
+        Z_PARAM_PATH_STR(path)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_STR(format)
+        Z_PARAM_LONG(rate)
+    ZEND_PARSE_PARAMETERS_END();
+
+    int fmt = format ? bcg729_format_from_name(format) : BCG729_FMT_PCM;
+    if (fmt != BCG729_FMT_PCM && fmt != BCG729_FMT_PCMA && fmt != BCG729_FMT_PCMU) {
+        zend_argument_value_error(2, "must be \"pcm\", \"pcma\" or \"pcmu\"");
+        RETURN_THROWS();
+    }
+    if (rate <= 0 || rate > 384000) {
+        zend_argument_value_error(3, "must be between 1 and 384000");
+        RETURN_THROWS();
+    }
+
+    bcg729WavWriter *self = Z_BCG729_WAV_WRITER_P(getThis());
+    bcg729_wav_writer_close(self);
+
+    php_stream *stream = bcg729_wav_open(path, "wb");
+    if (!stream) {
+        RETURN_THROWS();
+    }
+
+    self->stream = stream;
+    self->fmt = fmt;
+    self->rate = (uint32_t) rate;
+    self->data_bytes = 0;
+    self->buf = emalloc(BCG729_WAV_BUFFER);
+    self->buf_len = 0;
+
+    /* Cabeçalho provisório; tamanhos corrigidos em flush()/close() */
+    unsigned char header[44];
+    bcg729_wav_header(header, fmt, self->rate, 0);
+    if (!bcg729_stream_write_full(stream, (const char *) header, sizeof(header))) {
+        zend_throw_exception_ex(zend_ce_exception, 0, "Could not write to %s", ZSTR_VAL(path));
+        bcg729_wav_writer_close(self);
+        RETURN_THROWS();
+    }
+}
+
+/* Acrescenta amostras no formato do arquivo; retorna os bytes aceitos */
+ZEND_METHOD(bcg729WavWriter, write) {
+    zend_string *data;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(data)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729WavWriter *self = bcg729_wav_writer_fetch(getThis());
+    if (!self) {
+        RETURN_FALSE;
+    }
+
+    size_t len = ZSTR_LEN(data);
+    if (len % bcg729_format_sample_bytes(self->fmt) != 0) {
+        RETURN_FALSE;
+    }
+
+    const unsigned char *src = (const unsigned char *) ZSTR_VAL(data);
+
+    if (self->buf_len + len > BCG729_WAV_BUFFER) {
+        if (!bcg729_stream_write_full(self->stream, (const char *) self->buf, self->buf_len)) {
+            php_error_docref(NULL, E_WARNING, "Write failed");
+            RETURN_FALSE;
+        }
+        self->buf_len = 0;
+    }
+
+    if (len >= BCG729_WAV_BUFFER) {
+        /* Bloco grande: vai direto, sem passar pelo buffer */
+        if (!bcg729_stream_write_full(self->stream, (const char *) src, len)) {
+            php_error_docref(NULL, E_WARNING, "Write failed");
+            RETURN_FALSE;
+        }
+    } else {
+        memcpy(self->buf + self->buf_len, src, len);
+        self->buf_len += len;
+    }
+
+    self->data_bytes += len;
+    RETURN_LONG((zend_long) len);
+}
+
+/* Grava o buffer e atualiza o cabeçalho: o arquivo fica válido a qualquer momento */
+ZEND_METHOD(bcg729WavWriter, flush) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729WavWriter *self = bcg729_wav_writer_fetch(getThis());
+    if (!self) {
+        RETURN_FALSE;
+    }
+    RETURN_BOOL(bcg729_wav_writer_sync(self));
+}
+
+ZEND_METHOD(bcg729WavWriter, close) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729WavWriter *self = Z_BCG729_WAV_WRITER_P(getThis());
+    RETURN_BOOL(bcg729_wav_writer_close(self));
+}
+
+ZEND_METHOD(bcg729WavWriter, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729WavWriter *self = Z_BCG729_WAV_WRITER_P(getThis());
+    uint64_t samples = self->data_bytes / bcg729_format_sample_bytes(self->fmt ? self->fmt : BCG729_FMT_PCM);
+
+    array_init(return_value);
+    add_assoc_bool(return_value, "open", self->stream != NULL);
+    add_assoc_string(return_value, "format", bcg729_format_name(self->fmt));
+    add_assoc_long(return_value, "sample_rate", self->rate);
+    add_assoc_long(return_value, "data_bytes", (zend_long) self->data_bytes);
+    add_assoc_long(return_value, "samples", (zend_long) samples);
+    add_assoc_long(return_value, "buffered_bytes", (zend_long) self->buf_len);
+    add_assoc_double(return_value, "duration", self->rate ? (double) samples / self->rate : 0.0);
+}
+
+/* --- reader --------------------------------------------------------------- */
+
+static void bcg729_wav_reader_close(bcg729WavReader *r) {
+    if (r->stream) {
+        php_stream_close(r->stream);
+        r->stream = NULL;
+    }
+    if (r->buf) {
+        efree(r->buf);
+        r->buf = NULL;
+    }
+}
+
+static zend_object *bcg729_wav_reader_create(zend_class_entry *ce) {
+    bcg729WavReader *obj = zend_object_alloc(sizeof(bcg729WavReader), ce);
+
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_wav_reader_handlers;
+
+    return &obj->std;
+}
+
+static void bcg729_wav_reader_dtor(zend_object *object) {
+    bcg729_wav_reader_close((bcg729WavReader *) ((char *) object - XtOffsetOf(bcg729WavReader, std)));
+    zend_objects_destroy_object(object);
+}
+
+static void bcg729_wav_reader_free(zend_object *object) {
+    bcg729WavReader *obj = (bcg729WavReader *) ((char *) object - XtOffsetOf(bcg729WavReader, std));
+    if (obj->buf) {
+        efree(obj->buf);
+    }
+    zend_object_std_dtor(&obj->std);
+}
+
+static bcg729WavReader *bcg729_wav_reader_fetch(zval *zv) {
+    bcg729WavReader *self = Z_BCG729_WAV_READER_P(zv);
+    if (!self->stream) {
+        php_error_docref(NULL, E_WARNING, "WAV reader is closed or not initialized");
+        return NULL;
+    }
+    return self;
+}
+
+/* Copia até n bytes de áudio para dst, reabastecendo o buffer; retorna o total */
+static size_t bcg729_wav_reader_fill(bcg729WavReader *r, unsigned char *dst, size_t n) {
+    size_t got = 0;
+
+    if (r->data_bytes && r->consumed + n > r->data_bytes) {
+        n = (size_t) (r->data_bytes - r->consumed);
+    }
+
+    while (got < n) {
+        if (r->buf_pos == r->buf_len) {
+            r->buf_pos = 0;
+            r->buf_len = bcg729_stream_read_full(r->stream, (char *) r->buf, BCG729_WAV_BUFFER);
+            if (r->buf_len == 0) {
+                break;
+            }
+        }
+        size_t step = r->buf_len - r->buf_pos < n - got ? r->buf_len - r->buf_pos : n - got;
+        memcpy(dst + got, r->buf + r->buf_pos, step);
+        r->buf_pos += step;
+        got += step;
+    }
+
+    r->consumed += got;
+    return got;
+}
+
+ZEND_METHOD(bcg729WavReader, __construct) {
+    zend_string *path;
+    zend_long frame_samples = 80;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_PATH_STR(path)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(frame_samples)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (frame_samples <= 0 || frame_samples > BCG729_WAV_MAX_FRAME) {
+        zend_argument_value_error(2, "must be between 1 and %d", BCG729_WAV_MAX_FRAME);
+        RETURN_THROWS();
+    }
+
+    bcg729WavReader *self = Z_BCG729_WAV_READER_P(getThis());
+    bcg729_wav_reader_close(self);
+
+    php_stream *stream = bcg729_wav_open(path, "rb");
+    if (!stream) {
+        RETURN_THROWS();
+    }
+
+    uint32_t rate = 8000, data_bytes = 0;
+    int fmt = bcg729_wav_read_header(bcg729_php_stream_read_fn, stream, &rate, &data_bytes);
+    if (!fmt) {
+        php_stream_close(stream);
+        zend_throw_exception_ex(zend_ce_exception, 0, "%s is not a mono PCM 16-bit, A-law or mu-law WAV file", ZSTR_VAL(path));
+        RETURN_THROWS();
+    }
+
+    self->stream = stream;
+    self->fmt = fmt;
+    self->rate = rate;
+    self->data_bytes = data_bytes;
+    self->consumed = 0;
+    self->data_start = php_stream_tell(stream);
+    self->frame_samples = frame_samples;
+    self->buf = emalloc(BCG729_WAV_BUFFER);
+    self->buf_pos = self->buf_len = 0;
+}
+
+/*
+ * Próximo frame de frame_samples amostras no formato do arquivo, ou PCM
+ * 16-bit LE com $asPcm (A-law/μ-law expandidos em C). O último frame
+ * parcial é completado com silêncio; false no fim dos dados.
+ */
+ZEND_METHOD(bcg729WavReader, readFrame) {
+    zend_bool as_pcm = 0;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(as_pcm)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729WavReader *self = bcg729_wav_reader_fetch(getThis());
+    if (!self) {
+        RETURN_FALSE;
+    }
+
+    size_t samples = (size_t) self->frame_samples;
+    size_t sb = bcg729_format_sample_bytes(self->fmt);
+    zend_bool expand = as_pcm && sb == 1;
+    zend_string *out = zend_string_alloc(samples * (expand ? 2 : sb), 0);
+    unsigned char *raw = expand ? emalloc(samples) : (unsigned char *) ZSTR_VAL(out);
+
+    size_t got = bcg729_wav_reader_fill(self, raw, samples * sb);
+    if (got < sb) {
+        if (expand) {
+            efree(raw);
+        }
+        zend_string_efree(out);
+        RETURN_FALSE;
+    }
+
+    if (got < samples * sb) {
+        /* silêncio: 0 no PCM, 0xD5 no A-law, 0xFF no μ-law */
+        int fill = self->fmt == BCG729_FMT_PCMA ? 0xD5 : self->fmt == BCG729_FMT_PCMU ? 0xFF : 0;
+        memset(raw + got, fill, samples * sb - got);
+    }
+
+    if (expand) {
+        if (self->fmt == BCG729_FMT_PCMA) {
+            bcg729_alaw_decode((int16_t *) ZSTR_VAL(out), raw, samples);
+        } else {
+            bcg729_ulaw_decode((int16_t *) ZSTR_VAL(out), raw, samples);
+        }
+        efree(raw);
+    }
+
+    ZSTR_VAL(out)[ZSTR_LEN(out)] = '\0';
+    RETURN_STR(out);
+}
+
+/* Volta ao início dos dados de áudio */
+ZEND_METHOD(bcg729WavReader, rewind) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729WavReader *self = bcg729_wav_reader_fetch(getThis());
+    if (!self) {
+        RETURN_FALSE;
+    }
+    if (self->data_start < 0 || php_stream_seek(self->stream, self->data_start, SEEK_SET) != 0) {
+        RETURN_FALSE;
+    }
+    self->consumed = 0;
+    self->buf_pos = self->buf_len = 0;
+    RETURN_TRUE;
+}
+
+ZEND_METHOD(bcg729WavReader, close) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729_wav_reader_close(Z_BCG729_WAV_READER_P(getThis()));
+    RETURN_TRUE;
+}
+
+ZEND_METHOD(bcg729WavReader, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729WavReader *self = Z_BCG729_WAV_READER_P(getThis());
+    size_t sb = bcg729_format_sample_bytes(self->fmt ? self->fmt : BCG729_FMT_PCM);
+
+    array_init(return_value);
+    add_assoc_bool(return_value, "open", self->stream != NULL);
+    add_assoc_string(return_value, "format", bcg729_format_name(self->fmt));
+    add_assoc_long(return_value, "sample_rate", self->rate);
+    add_assoc_long(return_value, "frame_samples", self->frame_samples);
+    add_assoc_long(return_value, "data_bytes", (zend_long) self->data_bytes);
+    add_assoc_long(return_value, "samples", (zend_long) (self->data_bytes / sb));
+    add_assoc_long(return_value, "position", (zend_long) (self->consumed / sb));
+    add_assoc_double(return_value, "duration", self->rate ? (double) (self->data_bytes / sb) / self->rate : 0.0);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_wav_writer_construct, 0, 0, 1)
+    ZEND_ARG_TYPE_INFO(0, path, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, format, IS_STRING, 0, "\"pcm\"")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, sampleRate, IS_LONG, 0, "8000")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_wav_write, 0, 1, MAY_BE_LONG | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, data, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_wav_bool, 0, 0, _IS_BOOL, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_wav_info, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_wav_reader_construct, 0, 0, 1)
+    ZEND_ARG_TYPE_INFO(0, path, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, frameSamples, IS_LONG, 0, "80")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_wav_read_frame, 0, 0, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, asPcm, _IS_BOOL, 0, "false")
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry bcg729_wav_writer_methods[] = {
+    ZEND_ME(bcg729WavWriter, __construct, arginfo_wav_writer_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729WavWriter, write,       arginfo_wav_write,            ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729WavWriter, flush,       arginfo_wav_bool,             ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729WavWriter, close,       arginfo_wav_bool,             ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729WavWriter, info,        arginfo_wav_info,             ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
+
+static const zend_function_entry bcg729_wav_reader_methods[] = {
+    ZEND_ME(bcg729WavReader, __construct, arginfo_wav_reader_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729WavReader, readFrame,   arginfo_wav_read_frame,       ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729WavReader, rewind,      arginfo_wav_bool,             ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729WavReader, close,       arginfo_wav_bool,             ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729WavReader, info,        arginfo_wav_info,             ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
+
+/* ------------------------------------------------------------------------- */
+/*    Classe bcg729Rtp                                                        */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Sessão RTP (RFC 3550) para os payloads que a extensão entende: G.729
+ * (PT 18), PCMU (PT 0) e PCMA (PT 8). O parse não copia o payload — só
+ * devolve offset/tamanho dentro do pacote — e decode() entrega esse trecho
+ * direto ao decoder. Na saída, mantém sequence/timestamp e fatia o payload
+ * em pacotes de ptime ms.
+ */
+
+#define BCG729_RTP_PT_PCMU   0
+#define BCG729_RTP_PT_PCMA   8
+#define BCG729_RTP_PT_G729   18
+#define BCG729_RTP_HEADER    12
+#define BCG729_RTP_MAX_PTIME 200
+
+typedef struct {
+    uint8_t marker;
+    uint8_t payload_type;
+    uint8_t padding;
+    uint8_t csrc_count;
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    const uint8_t *csrc;     /* csrc_count × 4 bytes, big-endian */
+    const uint8_t *ext;      /* dados da extensão (sem o cabeçalho de 4 bytes) ou NULL */
+    uint16_t ext_profile;
+    size_t ext_len;
+    size_t payload_offset;
+    size_t payload_len;
+} bcg729RtpHeader;
+
+typedef struct {
+    int payload_type;
+    zend_long ptime;         /* ms por pacote gerado */
+    uint32_t ssrc;
+    uint16_t sequence;       /* próximo a ser enviado */
+    uint32_t timestamp;      /* próximo a ser enviado */
+    uint64_t packets_sent;
+    uint64_t octets_sent;
+    uint64_t packets_received;
+    uint64_t packets_rejected;
+    zend_object std;
+} bcg729Rtp;
+
+#define Z_BCG729_RTP_P(zv)  ((bcg729Rtp *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729Rtp, std)))
+
+static zend_class_entry *bcg729_rtp_ce;
+static zend_object_handlers bcg729_rtp_handlers;
+
+static uint16_t bcg729_get_be16(const uint8_t *p) {
+    return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static uint32_t bcg729_get_be32(const uint8_t *p) {
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static void bcg729_put_be16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t) (v >> 8);
+    p[1] = (uint8_t) v;
+}
+
+static void bcg729_put_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t) (v >> 24);
+    p[1] = (uint8_t) (v >> 16);
+    p[2] = (uint8_t) (v >> 8);
+    p[3] = (uint8_t) v;
+}
+
+/* Valida e decompõe o cabeçalho; 0 se o pacote estiver malformado */
+static zend_bool bcg729_rtp_parse(const uint8_t *pkt, size_t len, bcg729RtpHeader *h) {
+    if (len < BCG729_RTP_HEADER || (pkt[0] >> 6) != 2) {
+        return 0;
+    }
+
+    h->padding = (pkt[0] >> 5) & 1;
+    h->csrc_count = pkt[0] & 0x0f;
+    h->marker = pkt[1] >> 7;
+    h->payload_type = pkt[1] & 0x7f;
+    h->sequence = bcg729_get_be16(pkt + 2);
+    h->timestamp = bcg729_get_be32(pkt + 4);
+    h->ssrc = bcg729_get_be32(pkt + 8);
+
+    size_t offset = BCG729_RTP_HEADER + ((size_t) h->csrc_count * 4);
+    if (offset > len) {
+        return 0;
+    }
+    h->csrc = pkt + BCG729_RTP_HEADER;
+    h->ext = NULL;
+    h->ext_profile = 0;
+    h->ext_len = 0;
+
+    if (pkt[0] & 0x10) {
+        if (offset + 4 > len) {
+            return 0;
+        }
+        h->ext_profile = bcg729_get_be16(pkt + offset);
+        h->ext_len = (size_t) bcg729_get_be16(pkt + offset + 2) * 4;
+        h->ext = pkt + offset + 4;
+        offset += 4 + h->ext_len;
+        if (offset > len) {
+            return 0;
+        }
+    }
+
+    size_t pad = 0;
+    if (h->padding) {
+        pad = pkt[len - 1];
+        if (pad == 0 || pad > len - offset) {
+            return 0;
+        }
+    }
+
+    h->payload_offset = offset;
+    h->payload_len = len - offset - pad;
+    return 1;
+}
+
+/* Parse + conferência do payload type da sessão, com contadores */
+static zend_bool bcg729_rtp_accept(bcg729Rtp *self, const zend_string *packet, bcg729RtpHeader *h) {
+    if (!bcg729_rtp_parse((const uint8_t *) ZSTR_VAL(packet), ZSTR_LEN(packet), h)
+        || h->payload_type != self->payload_type) {
+        self->packets_rejected++;
+        return 0;
+    }
+    self->packets_received++;
+    return 1;
+}
+
+/* Amostras (8 kHz) representadas por len bytes de payload; 0 se inválido */
+static size_t bcg729_rtp_payload_samples(int payload_type, size_t len) {
+    if (payload_type == BCG729_RTP_PT_G729) {
+        return bcg729_payload_frames(len) * 80;
+    }
+    return len;
+}
+
+/* Semente para SSRC/sequence/timestamp iniciais (RFC 3550 §5.1 pede valores aleatórios) */
+static uint64_t bcg729_rtp_seed(const void *salt) {
+    uint64_t z = (uint64_t) (bcg729_now() * 1e9) ^ ((uint64_t) getpid() << 32) ^ (uint64_t) (uintptr_t) salt;
+
+    /* splitmix64 */
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static zend_object *bcg729_rtp_create(zend_class_entry *ce) {
+    bcg729Rtp *obj = zend_object_alloc(sizeof(bcg729Rtp), ce);
+
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_rtp_handlers;
+
+    return &obj->std;
+}
+
+static void bcg729_rtp_free(zend_object *object) {
+    zend_object_std_dtor(object);
+}
+
+/* ptime só é zero antes do __construct */
+static bcg729Rtp *bcg729_rtp_fetch(zval *zv) {
+    bcg729Rtp *self = Z_BCG729_RTP_P(zv);
+    if (self->ptime == 0) {
+        zend_throw_error(NULL, "bcg729Rtp was not initialized");
+        return NULL;
+    }
+    return self;
+}
+
+ZEND_METHOD(bcg729Rtp, __construct) {
+    zend_long payload_type = BCG729_RTP_PT_G729;
+    zend_long ptime = 20;
+    zend_long ssrc = 0, sequence = 0, timestamp = 0;
+    zend_bool ssrc_null = 1, sequence_null = 1, timestamp_null = 1;
+
+    ZEND_PARSE_PARAMETERS_START(0, 5)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(payload_type)
+        Z_PARAM_LONG(ptime)
+        Z_PARAM_LONG_OR_NULL(ssrc, ssrc_null)
+        Z_PARAM_LONG_OR_NULL(sequence, sequence_null)
+        Z_PARAM_LONG_OR_NULL(timestamp, timestamp_null)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (payload_type != BCG729_RTP_PT_G729 && payload_type != BCG729_RTP_PT_PCMU && payload_type != BCG729_RTP_PT_PCMA) {
+        zend_argument_value_error(1, "must be 18 (G.729), 0 (PCMU) or 8 (PCMA)");
+        RETURN_THROWS();
+    }
+    if (ptime < 10 || ptime > BCG729_RTP_MAX_PTIME || (ptime % 10) != 0) {
+        zend_argument_value_error(2, "must be a multiple of 10 between 10 and %d", BCG729_RTP_MAX_PTIME);
+        RETURN_THROWS();
+    }
+
+    bcg729Rtp *self = Z_BCG729_RTP_P(getThis());
+    uint64_t seed = bcg729_rtp_seed(self);
+
+    self->payload_type = (int) payload_type;
+    self->ptime = ptime;
+    self->ssrc = ssrc_null ? (uint32_t) seed : (uint32_t) ssrc;
+    self->sequence = sequence_null ? (uint16_t) (seed >> 32) : (uint16_t) sequence;
+    self->timestamp = timestamp_null ? (uint32_t) (seed >> 16) : (uint32_t) timestamp;
+}
+
+/*
+ * Decompõe o pacote. Retorna false se estiver malformado ou se o payload
+ * type não for o da sessão. O payload não é copiado: use payload_offset e
+ * payload_length (ou payload()/decode()).
+ */
+ZEND_METHOD(bcg729Rtp, parse) {
+    zend_string *packet;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(packet)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Rtp *self = bcg729_rtp_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    bcg729RtpHeader h;
+    if (!bcg729_rtp_accept(self, packet, &h)) {
+        RETURN_FALSE;
+    }
+
+    zval csrc, ext;
+    array_init_size(&csrc, h.csrc_count);
+    for (uint8_t i = 0; i < h.csrc_count; i++) {
+        add_next_index_long(&csrc, (zend_long) bcg729_get_be32(h.csrc + (i * 4)));
+    }
+
+    array_init_size(return_value, 11);
+    add_assoc_bool(return_value, "marker", h.marker);
+    add_assoc_long(return_value, "payload_type", h.payload_type);
+    add_assoc_long(return_value, "sequence", h.sequence);
+    add_assoc_long(return_value, "timestamp", (zend_long) h.timestamp);
+    add_assoc_long(return_value, "ssrc", (zend_long) h.ssrc);
+    add_assoc_zval(return_value, "csrc", &csrc);
+
+    if (h.ext) {
+        array_init_size(&ext, 2);
+        add_assoc_long(&ext, "profile", h.ext_profile);
+        add_assoc_stringl(&ext, "data", (const char *) h.ext, h.ext_len);
+        add_assoc_zval(return_value, "extension", &ext);
+    } else {
+        add_assoc_null(return_value, "extension");
+    }
+
+    add_assoc_bool(return_value, "padding", h.padding);
+    add_assoc_long(return_value, "payload_offset", (zend_long) h.payload_offset);
+    add_assoc_long(return_value, "payload_length", (zend_long) h.payload_len);
+    add_assoc_long(return_value, "samples", (zend_long) bcg729_rtp_payload_samples(h.payload_type, h.payload_len));
+}
+
+/* Só o payload do pacote (mesmas regras de parse()) */
+ZEND_METHOD(bcg729Rtp, payload) {
+    zend_string *packet;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(packet)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Rtp *self = bcg729_rtp_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    bcg729RtpHeader h;
+    if (!bcg729_rtp_accept(self, packet, &h)) {
+        RETURN_FALSE;
+    }
+
+    if (h.payload_offset == 0 && h.payload_len == ZSTR_LEN(packet)) {
+        RETURN_STR_COPY(packet);
+    }
+    RETURN_STRINGL(ZSTR_VAL(packet) + h.payload_offset, h.payload_len);
+}
+
+/*
+ * Pacote RTP → PCM 16-bit LE sem substr() no PHP: G.729 vai para o
+ * decoder do canal a partir do offset do payload; G.711 é expandido em C
+ * (o canal é opcional nesse caso).
+ */
+ZEND_METHOD(bcg729Rtp, decode) {
+    zend_string *packet;
+    zval *zch = NULL;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_STR(packet)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_OBJECT_OF_CLASS_OR_NULL(zch, bcg729_ce)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Rtp *self = bcg729_rtp_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    bcg729RtpHeader h;
+    if (!bcg729_rtp_accept(self, packet, &h)) {
+        RETURN_FALSE;
+    }
+
+    const uint8_t *payload = (const uint8_t *) ZSTR_VAL(packet) + h.payload_offset;
+    size_t samples = bcg729_rtp_payload_samples(h.payload_type, h.payload_len);
+    if (samples == 0) {
+        RETURN_FALSE;
+    }
+
+    bcg729Channel *channel = NULL;
+    if (h.payload_type == BCG729_RTP_PT_G729) {
+        if (!zch) {
+            zend_argument_value_error(2, "must be a bcg729Channel for G.729 payloads");
+            RETURN_THROWS();
+        }
+        channel = Z_BCG729_CHANNEL_P(zch);
+        if (!bcg729_channel_decoder(channel)) {
+            RETURN_FALSE;
+        }
+    }
+
+    zend_string *out = zend_string_alloc(samples * 2, 0);
+    int16_t *dst = (int16_t *) ZSTR_VAL(out);
+
+    switch (h.payload_type) {
+        case BCG729_RTP_PT_G729:
+            bcg729_channel_decode_frames(channel, payload, h.payload_len, samples / 80, dst);
+            break;
+        case BCG729_RTP_PT_PCMA:
+            bcg729_alaw_decode(dst, payload, samples);
+            break;
+        default:
+            bcg729_ulaw_decode(dst, payload, samples);
+            break;
+    }
+
+    ZSTR_VAL(out)[samples * 2] = '\0';
+    RETURN_STR(out);
+}
+
+/*
+ * Fatia o payload (G.729 ou G.711, no formato da sessão) em pacotes de
+ * ptime ms, avançando sequence e timestamp. Um SID final (Annex B) vai
+ * junto do último pacote. $marker marca só o primeiro pacote.
+ */
+ZEND_METHOD(bcg729Rtp, packetize) {
+    zend_string *payload;
+    zend_bool marker = 0;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_STR(payload)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_BOOL(marker)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729Rtp *self = bcg729_rtp_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    size_t len = ZSTR_LEN(payload);
+    if (len == 0 || bcg729_rtp_payload_samples(self->payload_type, len) == 0) {
+        RETURN_FALSE;
+    }
+
+    zend_bool g729 = self->payload_type == BCG729_RTP_PT_G729;
+    size_t chunk = g729 ? (size_t) self->ptime : (size_t) self->ptime * 8; /* 10 bytes G.729 ou 80 G.711 por 10 ms */
+    const uint8_t *src = (const uint8_t *) ZSTR_VAL(payload);
+    size_t offset = 0;
+
+    array_init_size(return_value, (uint32_t) ((len + chunk - 1) / chunk));
+
+    while (offset < len) {
+        size_t n = len - offset <= chunk ? len - offset : chunk;
+        if (g729 && len - offset - n == 2) {
+            n += 2; /* SID não viaja sozinho se couber no último pacote */
+        }
+
+        zend_string *pkt = zend_string_alloc(BCG729_RTP_HEADER + n, 0);
+        uint8_t *h = (uint8_t *) ZSTR_VAL(pkt);
+
+        h[0] = 0x80;
+        h[1] = (uint8_t) (((marker && offset == 0) ? 0x80 : 0) | self->payload_type);
+        bcg729_put_be16(h + 2, self->sequence);
+        bcg729_put_be32(h + 4, self->timestamp);
+        bcg729_put_be32(h + 8, self->ssrc);
+        memcpy(h + BCG729_RTP_HEADER, src + offset, n);
+        ZSTR_VAL(pkt)[BCG729_RTP_HEADER + n] = '\0';
+
+        add_next_index_str(return_value, pkt);
+
+        self->sequence++;
+        self->timestamp += (uint32_t) bcg729_rtp_payload_samples(self->payload_type, n);
+        self->packets_sent++;
+        self->octets_sent += n;
+        offset += n;
+    }
+}
+
+/* Avança o timestamp sem enviar nada (períodos de DTX sem SID) */
+ZEND_METHOD(bcg729Rtp, advance) {
+    zend_long samples;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_LONG(samples)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (samples < 0) {
+        zend_argument_value_error(1, "must be greater than or equal to 0");
+        RETURN_THROWS();
+    }
+
+    bcg729Rtp *self = bcg729_rtp_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    self->timestamp += (uint32_t) samples;
+}
+
+ZEND_METHOD(bcg729Rtp, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729Rtp *self = bcg729_rtp_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+
+    array_init(return_value);
+    add_assoc_long(return_value, "payload_type", self->payload_type);
+    add_assoc_long(return_value, "ptime", self->ptime);
+    add_assoc_long(return_value, "ssrc", (zend_long) self->ssrc);
+    add_assoc_long(return_value, "sequence", self->sequence);
+    add_assoc_long(return_value, "timestamp", (zend_long) self->timestamp);
+    add_assoc_long(return_value, "packets_sent", (zend_long) self->packets_sent);
+    add_assoc_long(return_value, "octets_sent", (zend_long) self->octets_sent);
+    add_assoc_long(return_value, "packets_received", (zend_long) self->packets_received);
+    add_assoc_long(return_value, "packets_rejected", (zend_long) self->packets_rejected);
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_rtp_construct, 0, 0, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, payloadType, IS_LONG, 0, "18")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, ptime, IS_LONG, 0, "20")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, ssrc, IS_LONG, 1, "null")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, sequence, IS_LONG, 1, "null")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, timestamp, IS_LONG, 1, "null")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_rtp_parse, 0, 1, MAY_BE_ARRAY | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, packet, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_rtp_payload, 0, 1, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, packet, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_rtp_decode, 0, 1, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, packet, IS_STRING, 0)
+    ZEND_ARG_OBJ_INFO_WITH_DEFAULT_VALUE(0, channel, bcg729Channel, 1, "null")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_rtp_packetize, 0, 1, MAY_BE_ARRAY | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, payload, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, marker, _IS_BOOL, 0, "false")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_rtp_advance, 0, 1, IS_VOID, 0)
+    ZEND_ARG_TYPE_INFO(0, samples, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_rtp_info, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry bcg729_rtp_methods[] = {
+    ZEND_ME(bcg729Rtp, __construct, arginfo_rtp_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729Rtp, parse,       arginfo_rtp_parse,     ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Rtp, payload,     arginfo_rtp_payload,   ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Rtp, decode,      arginfo_rtp_decode,    ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Rtp, packetize,   arginfo_rtp_packetize, ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Rtp, advance,     arginfo_rtp_advance,   ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Rtp, info,        arginfo_rtp_info,      ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
+
+/* ------------------------------------------------------------------------- */
+/*    Classe bcg729JitterBuffer                                               */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Jitter buffer adaptativo: anel indexado pelo sequence RTP, com os
+ * payloads copiados para um único bloco pré-alocado (nada de arrays PHP
+ * nem zvals por pacote). O jitter de chegada segue o estimador da
+ * RFC 3550 §6.4.1 e define o atraso-alvo; a cada tick de ptime, pop()
+ * entrega o PCM do próximo pacote ou a ocultação do decoder.
+ *
+ * Os slots são indexados pela posição relativa a play_seq, não por
+ * sequence % capacidade: qualquer capacidade funciona na volta de
+ * 65535 para 0.
+ *
+ * Adaptação: um underrun (nada no anel) toca PLC sem avançar o sequence,
+ * o que aumenta o atraso em um ptime; com o anel acima do alvo + 2
+ * pacotes, o pacote mais antigo é descartado para encolher o atraso.
+ *
+ * O playout conta amostras, não pacotes: cada tick entrega exatamente
+ * ptime ms, consumindo vários pacotes menores ou só parte de um maior
+ * (o resto fica para o próximo tick). Os slots comportam o ptime máximo
+ * do RTP, então um peer com ptime diferente do configurado não perde
+ * áudio.
+ */
+
+#define BCG729_JB_MAX_CAPACITY 1024
+
+typedef struct {
+    uint16_t sequence;
+    uint16_t len;
+    zend_bool used;
+} bcg729JbSlot;
+
+typedef struct {
+    int payload_type;
+    zend_long ptime;             /* ms por tick */
+    zend_long min_delay;         /* ms */
+    zend_long max_delay;         /* ms */
+    uint32_t capacity;           /* slots no anel */
+    size_t slot_bytes;           /* payload máximo por slot (BCG729_RTP_MAX_PTIME) */
+    bcg729JbSlot *slots;
+    uint8_t *data;               /* capacity × slot_bytes */
+    zend_bool started;           /* primeiro pacote já visto */
+    zend_bool playing;           /* atraso inicial já atingido */
+    uint16_t play_seq;           /* próximo sequence a tocar */
+    uint64_t play_pos;           /* posição estendida de play_seq (não dá a volta em 65535) */
+    uint16_t max_seq;            /* maior sequence recebido */
+    uint32_t play_offset;        /* amostras já tocadas do pacote em play_seq */
+    uint32_t gap;                /* amostras de ocultação ainda devidas por um pacote perdido */
+    uint32_t packet_samples;     /* duração dos pacotes de voz recebidos (0: usa o ptime) */
+    uint32_t ssrc;
+    uint32_t buffered;
+    double jitter;               /* em amostras (8 kHz) */
+    double last_transit;
+    zend_bool has_transit;
+    uint64_t received;
+    uint64_t late;
+    uint64_t lost;
+    uint64_t discarded;
+    uint64_t concealed;          /* amostras geradas por PLC/CNG */
+    zend_object std;
+} bcg729JitterBuffer;
+
+#define Z_BCG729_JB_P(zv)  ((bcg729JitterBuffer *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729JitterBuffer, std)))
+
+static zend_class_entry *bcg729_jb_ce;
+static zend_object_handlers bcg729_jb_handlers;
+
+static zend_object *bcg729_jb_create(zend_class_entry *ce) {
+    bcg729JitterBuffer *obj = zend_object_alloc(sizeof(bcg729JitterBuffer), ce);
+
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_jb_handlers;
+
+    return &obj->std;
+}
+
+static void bcg729_jb_release(bcg729JitterBuffer *jb) {
+    if (jb->slots) {
+        efree(jb->slots);
+        jb->slots = NULL;
+    }
+    if (jb->data) {
+        efree(jb->data);
+        jb->data = NULL;
+    }
+}
+
+static void bcg729_jb_free(zend_object *object) {
+    bcg729JitterBuffer *obj = (bcg729JitterBuffer *) ((char *) object - XtOffsetOf(bcg729JitterBuffer, std));
+    bcg729_jb_release(obj);
+    zend_object_std_dtor(&obj->std);
+}
+
+/* Esvazia o anel e volta ao estado de pré-buffer (contadores preservados) */
+static void bcg729_jb_flush(bcg729JitterBuffer *jb) {
+    memset(jb->slots, 0, sizeof(bcg729JbSlot) * jb->capacity);
+    jb->started = 0;
+    jb->playing = 0;
+    jb->buffered = 0;
+    jb->has_transit = 0;
+    jb->play_offset = 0;
+    jb->gap = 0;
+}
+
+/* Distância com sinal entre dois sequences (aritmética de 16 bits) */
+static int bcg729_jb_seq_diff(uint16_t a, uint16_t b) {
+    return (int16_t) (uint16_t) (a - b);
+}
+
+/* Duração de um pacote do peer em ms (o ptime configurado até chegar voz) */
+static double bcg729_jb_packet_ms(const bcg729JitterBuffer *jb) {
+    return jb->packet_samples ? (double) jb->packet_samples / 8 : (double) jb->ptime;
+}
+
+/* Atraso-alvo em pacotes do peer: um ptime + 3 × jitter, limitado a [min, max] */
+static uint32_t bcg729_jb_target(const bcg729JitterBuffer *jb) {
+    double ptime_samples = (double) jb->ptime * 8;
+    double target_ms = ((ptime_samples + (3 * jb->jitter)) / 8);
+
+    if (target_ms < jb->min_delay) {
+        target_ms = (double) jb->min_delay;
+    }
+    if (target_ms > jb->max_delay) {
+        target_ms = (double) jb->max_delay;
+    }
+    return (uint32_t) ceil(target_ms / bcg729_jb_packet_ms(jb));
+}
+
+/* Índice no anel: posição estendida de seq (relativa a play_seq) módulo a capacidade */
+static uint32_t bcg729_jb_index(const bcg729JitterBuffer *jb, uint16_t seq) {
+    return (uint32_t) ((jb->play_pos + (int64_t) bcg729_jb_seq_diff(seq, jb->play_seq)) % jb->capacity);
+}
+
+static bcg729JbSlot *bcg729_jb_slot(bcg729JitterBuffer *jb, uint16_t seq) {
+    return &jb->slots[bcg729_jb_index(jb, seq)];
+}
+
+/* Move play_seq (para frente ou, no pré-buffer, para trás) junto com a posição estendida */
+static void bcg729_jb_move(bcg729JitterBuffer *jb, int delta) {
+    jb->play_seq = (uint16_t) (jb->play_seq + delta);
+    jb->play_pos += (int64_t) delta;
+}
+
+static void bcg729_jb_drop(bcg729JitterBuffer *jb, bcg729JbSlot *slot) {
+    slot->used = 0;
+    jb->buffered--;
+}
+
+ZEND_METHOD(bcg729JitterBuffer, __construct) {
+    zend_long payload_type = BCG729_RTP_PT_G729;
+    zend_long ptime = 20, min_delay = 40, max_delay = 200, capacity = 64;
+
+    ZEND_PARSE_PARAMETERS_START(0, 5)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(payload_type)
+        Z_PARAM_LONG(ptime)
+        Z_PARAM_LONG(min_delay)
+        Z_PARAM_LONG(max_delay)
+        Z_PARAM_LONG(capacity)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (payload_type != BCG729_RTP_PT_G729 && payload_type != BCG729_RTP_PT_PCMU && payload_type != BCG729_RTP_PT_PCMA) {
+        zend_argument_value_error(1, "must be 18 (G.729), 0 (PCMU) or 8 (PCMA)");
+        RETURN_THROWS();
+    }
+    if (ptime < 10 || ptime > BCG729_RTP_MAX_PTIME || (ptime % 10) != 0) {
+        zend_argument_value_error(2, "must be a multiple of 10 between 10 and %d", BCG729_RTP_MAX_PTIME);
+        RETURN_THROWS();
+    }
+    if (min_delay < 0) {
+        zend_argument_value_error(3, "must be greater than or equal to 0");
+        RETURN_THROWS();
+    }
+    if (max_delay < min_delay || max_delay < ptime) {
+        zend_argument_value_error(4, "must be greater than or equal to $minDelay and $ptime");
+        RETURN_THROWS();
+    }
+    if (capacity < 2 || capacity > BCG729_JB_MAX_CAPACITY || capacity * ptime < max_delay) {
+        zend_argument_value_error(5, "must be between 2 and %d and hold $maxDelay worth of packets", BCG729_JB_MAX_CAPACITY);
+        RETURN_THROWS();
+    }
+
+    bcg729JitterBuffer *self = Z_BCG729_JB_P(getThis());
+    bcg729_jb_release(self);
+    memset(&self->payload_type, 0, XtOffsetOf(bcg729JitterBuffer, std));
+
+    self->payload_type = (int) payload_type;
+    self->ptime = ptime;
+    self->min_delay = min_delay;
+    self->max_delay = max_delay;
+    self->capacity = (uint32_t) capacity;
+    /* Qualquer ptime do peer cabe: G.729 até 20 frames + SID; G.711 8 bytes por ms */
+    self->slot_bytes = payload_type == BCG729_RTP_PT_G729 ? BCG729_RTP_MAX_PTIME + 2 : BCG729_RTP_MAX_PTIME * 8;
+    self->slots = ecalloc(self->capacity, sizeof(bcg729JbSlot));
+    self->data = emalloc(self->capacity * self->slot_bytes);
+}
+
+/*
+ * Insere um pacote RTP. $arrival é o instante de chegada em segundos
+ * (microtime(true)); omitido, usa o relógio monotônico. Retorna false se
+ * o pacote foi recusado (malformado, payload type errado, atrasado,
+ * duplicado ou fora da janela do anel).
+ */
+ZEND_METHOD(bcg729JitterBuffer, put) {
+    zend_string *packet;
+    double arrival = 0;
+    zend_bool arrival_null = 1;
+
+    ZEND_PARSE_PARAMETERS_START(1, 2)
+        Z_PARAM_STR(packet)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_DOUBLE_OR_NULL(arrival, arrival_null)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729JitterBuffer *self = Z_BCG729_JB_P(getThis());
+    if (!self->slots) {
+        zend_throw_error(NULL, "bcg729JitterBuffer was not initialized");
+        RETURN_THROWS();
+    }
+
+    bcg729RtpHeader h;
+    if (!bcg729_rtp_parse((const uint8_t *) ZSTR_VAL(packet), ZSTR_LEN(packet), &h)
+        || h.payload_type != self->payload_type
+        || h.payload_len == 0 || h.payload_len > self->slot_bytes
+        || bcg729_rtp_payload_samples(h.payload_type, h.payload_len) == 0) {
+        self->discarded++;
+        RETURN_FALSE;
+    }
+
+    /* Novo SSRC ou salto de sequence maior que o anel: recomeça o pré-buffer */
+    if (self->started && (h.ssrc != self->ssrc
+        || bcg729_jb_seq_diff(h.sequence, self->play_seq) >= (int) self->capacity)) {
+        bcg729_jb_flush(self);
+    }
+
+    if (!self->started) {
+        self->started = 1;
+        self->ssrc = h.ssrc;
+        self->play_seq = h.sequence;
+        self->play_pos = (uint64_t) 1 << 40; /* folga para recuar no pré-buffer */
+        self->max_seq = h.sequence;
+    }
+
+    int ahead = bcg729_jb_seq_diff(h.sequence, self->play_seq);
+    if (ahead < 0) {
+        if (!self->playing) {
+            /* ainda no pré-buffer: chegou fora de ordem, antecipa o início */
+            bcg729_jb_move(self, ahead);
+        } else {
+            self->late++;
+            RETURN_FALSE;
+        }
+    }
+
+    bcg729JbSlot *slot = bcg729_jb_slot(self, h.sequence);
+    if (slot->used) {
+        if (slot->sequence == h.sequence) {
+            self->discarded++; /* duplicado */
+            RETURN_FALSE;
+        }
+        bcg729_jb_drop(self, slot);
+        self->discarded++;
+    }
+
+    slot->used = 1;
+    slot->sequence = h.sequence;
+    slot->len = (uint16_t) h.payload_len;
+    memcpy(self->data + (size_t) bcg729_jb_index(self, h.sequence) * self->slot_bytes, ZSTR_VAL(packet) + h.payload_offset, h.payload_len);
+    self->buffered++;
+    self->received++;
+
+    if (bcg729_jb_seq_diff(h.sequence, self->max_seq) > 0) {
+        self->max_seq = h.sequence;
+    }
+    if (h.payload_type != BCG729_RTP_PT_G729 || (h.payload_len % 10) == 0) {
+        /* pacotes com SID não dizem o ptime do peer */
+        self->packet_samples = (uint32_t) bcg729_rtp_payload_samples(h.payload_type, h.payload_len);
+    }
+
+    /* RFC 3550 §6.4.1: J += (|D| - J) / 16, em unidades de timestamp */
+    double now = arrival_null ? bcg729_now() : arrival;
+    double transit = (now * 8000) - (double) h.timestamp;
+    if (self->has_transit) {
+        double d = transit - self->last_transit;
+        /* ignora o salto de timestamp após DTX ou wrap de 32 bits */
+        if (fabs(d) < 8000) {
+            self->jitter += (fabs(d) - self->jitter) / 16;
+        }
+    }
+    self->last_transit = transit;
+    self->has_transit = 1;
+
+    RETURN_TRUE;
+}
+
+/* Decodifica as amostras [offset, offset + count) de um payload no destino */
+static void bcg729_jb_decode(bcg729JitterBuffer *jb, bcg729Channel *channel, const uint8_t *payload, size_t len, size_t offset, size_t count, int16_t *dst) {
+    if (channel) {
+        uint64_t started = bcg729_clock_ns();
+
+        for (size_t i = 0; i < count / 80; i++) {
+            bcg729_decode_payload_frame(channel, payload, len, (offset / 80) + i, dst + (i * 80));
+        }
+        channel->stats.decoder_ns += bcg729_clock_ns() - started;
+        channel->stats.bytes_in += offset == 0 ? len : 0;
+        channel->stats.bytes_out += count * 2;
+    } else if (jb->payload_type == BCG729_RTP_PT_PCMA) {
+        bcg729_alaw_decode(dst, payload + offset, count);
+    } else {
+        bcg729_ulaw_decode(dst, payload + offset, count);
+    }
+}
+
+/* Ocultação: PLC/CNG do decoder no G.729 (múltiplos de 80 amostras), silêncio no G.711 */
+static void bcg729_jb_conceal(bcg729JitterBuffer *jb, bcg729Channel *channel, size_t count, int16_t *dst) {
+    if (channel) {
+        bcg729_channel_conceal_frames(channel, count / 80, dst);
+    } else {
+        memset(dst, 0, count * 2);
+    }
+    jb->concealed += count;
+}
+
+/*
+ * Um tick de playout (ptime ms): PCM 16-bit LE dos próximos pacotes, ou a
+ * ocultação do decoder para o que não chegou. Retorna false enquanto o
+ * atraso inicial não foi atingido. Para G.729 o canal é obrigatório.
+ */
+ZEND_METHOD(bcg729JitterBuffer, pop) {
+    zval *zch = NULL;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_OBJECT_OF_CLASS_OR_NULL(zch, bcg729_ce)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729JitterBuffer *self = Z_BCG729_JB_P(getThis());
+    if (!self->slots) {
+        zend_throw_error(NULL, "bcg729JitterBuffer was not initialized");
+        RETURN_THROWS();
+    }
+
+    bcg729Channel *channel = NULL;
+    if (self->payload_type == BCG729_RTP_PT_G729) {
+        if (!zch) {
+            zend_argument_value_error(1, "must be a bcg729Channel for G.729 payloads");
+            RETURN_THROWS();
+        }
+        channel = Z_BCG729_CHANNEL_P(zch);
+        if (!bcg729_channel_decoder(channel)) {
+            RETURN_FALSE;
+        }
+    }
+
+    uint32_t target = bcg729_jb_target(self);
+    int span = self->started ? bcg729_jb_seq_diff(self->max_seq, self->play_seq) + 1 : 0;
+    uint32_t depth = span > 0 ? (uint32_t) span : 0;
+
+    if (!self->playing) {
+        if (!self->started || depth < target) {
+            RETURN_FALSE;
+        }
+        self->playing = 1;
+    }
+
+    /* Atraso acima do alvo: descarta o mais antigo (se ainda não começou a tocar) */
+    if (depth > target + 2 && self->play_offset == 0 && self->gap == 0) {
+        bcg729JbSlot *old = bcg729_jb_slot(self, self->play_seq);
+        if (old->used && old->sequence == self->play_seq) {
+            bcg729_jb_drop(self, old);
+            self->discarded++;
+        }
+        bcg729_jb_move(self, 1);
+    }
+
+    size_t samples = (size_t) self->ptime * 8;
+    size_t filled = 0;
+    zend_string *out = zend_string_alloc(samples * 2, 0);
+    int16_t *dst = (int16_t *) ZSTR_VAL(out);
+
+    while (filled < samples) {
+        size_t want = samples - filled;
+
+        if (self->gap > 0) {
+            /* resto da duração de um pacote perdido */
+            size_t take = self->gap < want ? self->gap : want;
+            bcg729_jb_conceal(self, channel, take, dst + filled);
+            self->gap -= (uint32_t) take;
+            filled += take;
+            continue;
+        }
+
+        bcg729JbSlot *slot = bcg729_jb_slot(self, self->play_seq);
+        if (slot->used && slot->sequence == self->play_seq) {
+            const uint8_t *payload = self->data + (size_t) bcg729_jb_index(self, self->play_seq) * self->slot_bytes;
+            size_t got = bcg729_rtp_payload_samples(self->payload_type, slot->len);
+            size_t take = got - self->play_offset < want ? got - self->play_offset : want;
+
+            bcg729_jb_decode(self, channel, payload, slot->len, self->play_offset, take, dst + filled);
+            self->play_offset += (uint32_t) take;
+            filled += take;
+
+            if (self->play_offset == got) {
+                bcg729_jb_drop(self, slot);
+                bcg729_jb_move(self, 1);
+                self->play_offset = 0;
+            }
+        } else if (self->buffered > 0) {
+            /* há pacotes depois deste: foi perdido, oculta a duração dele e segue */
+            self->lost++;
+            self->gap = self->packet_samples ? self->packet_samples : (uint32_t) samples;
+            bcg729_jb_move(self, 1);
+        } else {
+            /* anel vazio: underrun ou DTX (um SID completa o tick com CNG); o sequence espera */
+            bcg729_jb_conceal(self, channel, want, dst + filled);
+            filled += want;
+        }
+    }
+
+    ZSTR_VAL(out)[samples * 2] = '\0';
+    RETURN_STR(out);
+}
+
+/* Esvazia o anel e volta ao pré-buffer (usar após hold/transferência) */
+ZEND_METHOD(bcg729JitterBuffer, reset) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729JitterBuffer *self = Z_BCG729_JB_P(getThis());
+    if (self->slots) {
+        bcg729_jb_flush(self);
+        self->jitter = 0;
+    }
+}
+
+ZEND_METHOD(bcg729JitterBuffer, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729JitterBuffer *self = Z_BCG729_JB_P(getThis());
+    uint32_t target = self->slots ? bcg729_jb_target(self) : 0;
+
+    array_init(return_value);
+    add_assoc_bool(return_value, "playing", self->playing);
+    add_assoc_long(return_value, "buffered", self->buffered);
+    add_assoc_long(return_value, "capacity", self->capacity);
+    add_assoc_long(return_value, "next_sequence", self->play_seq);
+    add_assoc_double(return_value, "jitter_ms", self->jitter / 8);
+    add_assoc_long(return_value, "target_delay_ms", self->slots ? (zend_long) ceil(target * bcg729_jb_packet_ms(self)) : 0);
+    add_assoc_long(return_value, "received", (zend_long) self->received);
+    add_assoc_long(return_value, "late", (zend_long) self->late);
+    add_assoc_long(return_value, "lost", (zend_long) self->lost);
+    add_assoc_long(return_value, "discarded", (zend_long) self->discarded);
+    add_assoc_long(return_value, "concealed_frames", (zend_long) (self->concealed / 80));
+}
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_jb_construct, 0, 0, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, payloadType, IS_LONG, 0, "18")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, ptime, IS_LONG, 0, "20")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, minDelay, IS_LONG, 0, "40")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, maxDelay, IS_LONG, 0, "200")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, capacity, IS_LONG, 0, "64")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_jb_put, 0, 1, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, packet, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, arrival, IS_DOUBLE, 1, "null")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_jb_pop, 0, 0, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_OBJ_INFO_WITH_DEFAULT_VALUE(0, channel, bcg729Channel, 1, "null")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_jb_void, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_jb_info, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+static const zend_function_entry bcg729_jb_methods[] = {
+    ZEND_ME(bcg729JitterBuffer, __construct, arginfo_jb_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729JitterBuffer, put,         arginfo_jb_put,       ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729JitterBuffer, pop,         arginfo_jb_pop,       ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729JitterBuffer, reset,       arginfo_jb_void,      ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729JitterBuffer, info,        arginfo_jb_info,      ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
+
+/* ------------------------------------------------------------------------- */
+/*    Classe bcg729DtmfDetector                                               */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Detector DTMF em streaming: 8 filtros de Goertzel em ponto fixo (Q14)
+ * sobre blocos de 102 amostras a 8 kHz (~12,75 ms, escalado para outras
+ * taxas). Um bloco só conta como dígito se as duas componentes passam do
+ * nível mínimo, dominam a energia do bloco e as vizinhas do grupo, e o
+ * twist está dentro do limite. Início e fim exigem dois blocos seguidos
+ * concordando, como nos detectores clássicos.
+ */
+
+#define BCG729_DTMF_BLOCK        102      /* amostras por bloco a 8 kHz */
+#define BCG729_DTMF_MIN_DBFS     (-40.0)  /* nível mínimo de cada tom */
+#define BCG729_DTMF_NORMAL_TWIST 6.3      /* grupo baixo até 8 dB acima do alto */
+#define BCG729_DTMF_REVERSE_TWIST 2.5     /* grupo alto até 4 dB acima do baixo */
+#define BCG729_DTMF_RELATIVE_PEAK 6.3     /* 8 dB sobre as outras frequências do grupo */
+
+static const double bcg729_dtmf_freqs[8] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+static const char bcg729_dtmf_digits[4][4] = {
+    { '1', '2', '3', 'A' },
+    { '4', '5', '6', 'B' },
+    { '7', '8', '9', 'C' },
+    { '*', '0', '#', 'D' },
+};
+
+typedef struct {
+    zend_long sample_rate;
+    uint32_t block_samples;
+    int32_t coef[8];             /* 2cos(w) em Q14 */
+    double min_power;            /* potência de Goertzel de um tom no nível mínimo */
+    /* bloco em andamento */
+    int32_t s1[8];
+    int32_t s2[8];
+    uint64_t energy;
+    uint32_t filled;
+    /* estado de detecção */
+    char last_hit;               /* resultado do bloco anterior (0 = nada) */
+    char digit;                  /* dígito ativo */
+    uint64_t samples;            /* amostras processadas desde o início/reset */
+    uint64_t digit_start;
+    uint64_t digits;
+    zval events;                 /* eventos ainda não entregues */
+    zend_bool initialized;
+    zend_object std;
+} bcg729DtmfDetector;
+
+#define Z_BCG729_DTMF_P(zv)  ((bcg729DtmfDetector *)((char *)(Z_OBJ_P(zv)) - XtOffsetOf(bcg729DtmfDetector, std)))
+
+static zend_class_entry *bcg729_dtmf_ce;
+static zend_object_handlers bcg729_dtmf_handlers;
+
+static zend_object *bcg729_dtmf_create(zend_class_entry *ce) {
+    bcg729DtmfDetector *obj = zend_object_alloc(sizeof(bcg729DtmfDetector), ce);
+
+    zend_object_std_init(&obj->std, ce);
+    object_properties_init(&obj->std, ce);
+    obj->std.handlers = &bcg729_dtmf_handlers;
+    array_init(&obj->events);
+
+    return &obj->std;
+}
+
+static void bcg729_dtmf_free(zend_object *object) {
+    bcg729DtmfDetector *obj = (bcg729DtmfDetector *) ((char *) object - XtOffsetOf(bcg729DtmfDetector, std));
+    zval_ptr_dtor(&obj->events);
+    zend_object_std_dtor(&obj->std);
+}
+
+static bcg729DtmfDetector *bcg729_dtmf_fetch(zval *zv) {
+    bcg729DtmfDetector *self = Z_BCG729_DTMF_P(zv);
+    if (!self->initialized) {
+        zend_throw_error(NULL, "bcg729DtmfDetector was not initialized");
+        return NULL;
+    }
+    return self;
+}
+
+static void bcg729_dtmf_reset_state(bcg729DtmfDetector *self) {
+    memset(self->s1, 0, sizeof(self->s1));
+    memset(self->s2, 0, sizeof(self->s2));
+    self->energy = 0;
+    self->filled = 0;
+    self->last_hit = 0;
+    self->digit = 0;
+    self->samples = 0;
+    self->digit_start = 0;
+}
+
+static void bcg729_dtmf_event(bcg729DtmfDetector *self, const char *type, char digit, uint64_t sample) {
+    zval ev;
+    array_init_size(&ev, 5);
+    add_assoc_string(&ev, "event", (char *) type);
+    add_assoc_stringl(&ev, "digit", &digit, 1);
+    add_assoc_long(&ev, "sample", (zend_long) sample);
+    add_assoc_double(&ev, "time", (double) sample / (double) self->sample_rate);
+    if (type[0] == 'e') {
+        add_assoc_double(&ev, "duration", (double) (sample - self->digit_start) / (double) self->sample_rate);
+    }
+    add_next_index_zval(&self->events, &ev);
+}
+
+/* Potência de Goertzel do filtro k ao fim do bloco */
+static double bcg729_dtmf_power(const bcg729DtmfDetector *self, int k) {
+    int64_t s1 = self->s1[k], s2 = self->s2[k];
+    int64_t p = s1 * s1 + s2 * s2 - ((((int64_t) self->coef[k] * s1) >> 14) * s2);
+    return p > 0 ? (double) p : 0.0;
+}
+
+/* Classifica o bloco encerrado: dígito ou 0 */
+static char bcg729_dtmf_classify(const bcg729DtmfDetector *self) {
+    double power[8];
+    int row = 0, col = 4;
+
+    for (int k = 0; k < 8; k++) {
+        power[k] = bcg729_dtmf_power(self, k);
+    }
+    for (int k = 1; k < 4; k++) {
+        if (power[k] > power[row]) {
+            row = k;
+        }
+        if (power[k + 4] > power[col]) {
+            col = k + 4;
+        }
+    }
+
+    double r = power[row], c = power[col];
+    if (r < self->min_power || c < self->min_power) {
+        return 0;
+    }
+    if (c > r * BCG729_DTMF_REVERSE_TWIST || r > c * BCG729_DTMF_NORMAL_TWIST) {
+        return 0;
+    }
+    for (int k = 0; k < 4; k++) {
+        if ((k != row && power[k] * BCG729_DTMF_RELATIVE_PEAK > r)
+            || (k + 4 != col && power[k + 4] * BCG729_DTMF_RELATIVE_PEAK > c)) {
+            return 0;
+        }
+    }
+    /* um tom puro de amplitude A dá (A·N/2)², e a energia do bloco N·A²/2 */
+    if ((r + c) * 4.0 < (double) self->energy * (double) self->block_samples) {
+        return 0;
+    }
+
+    return bcg729_dtmf_digits[row][col - 4];
+}
+
+static void bcg729_dtmf_block_done(bcg729DtmfDetector *self) {
+    char hit = bcg729_dtmf_classify(self);
+    uint64_t prev_block = self->samples - 2 * (uint64_t) self->block_samples;
+
+    if (hit == self->last_hit && hit != self->digit) {
+        if (self->digit) {
+            bcg729_dtmf_event(self, "end", self->digit, prev_block);
+        }
+        if (hit) {
+            self->digit_start = prev_block;
+            self->digits++;
+            bcg729_dtmf_event(self, "start", hit, prev_block);
+        }
+        self->digit = hit;
+    }
+    self->last_hit = hit;
+
+    memset(self->s1, 0, sizeof(self->s1));
+    memset(self->s2, 0, sizeof(self->s2));
+    self->energy = 0;
+    self->filled = 0;
+}
+
+/* Passa n amostras pelos 8 filtros, fechando blocos conforme completam */
+static void bcg729_dtmf_feed(bcg729DtmfDetector *self, const int16_t *x, size_t n) {
+    while (n > 0) {
+        size_t take = self->block_samples - self->filled;
+        if (take > n) {
+            take = n;
+        }
+
+        int32_t s1[8], s2[8];
+        uint64_t energy = self->energy;
+        memcpy(s1, self->s1, sizeof(s1));
+        memcpy(s2, self->s2, sizeof(s2));
+
+        for (size_t i = 0; i < take; i++) {
+            int32_t v = x[i];
+            energy += (uint32_t) (v * v);
+            for (int k = 0; k < 8; k++) {
+                int32_t s0 = v + (int32_t) (((int64_t) self->coef[k] * s1[k]) >> 14) - s2[k];
+                s2[k] = s1[k];
+                s1[k] = s0;
+            }
+        }
+
+        memcpy(self->s1, s1, sizeof(s1));
+        memcpy(self->s2, s2, sizeof(s2));
+        self->energy = energy;
+        self->filled += (uint32_t) take;
+        self->samples += take;
+        x += take;
+        n -= take;
+
+        if (self->filled == self->block_samples) {
+            bcg729_dtmf_block_done(self);
+        }
+    }
+}
+
+/* Entrega os eventos pendentes e começa uma lista nova */
+static void bcg729_dtmf_take_events(bcg729DtmfDetector *self, zval *return_value) {
+    ZVAL_COPY_VALUE(return_value, &self->events);
+    array_init(&self->events);
+}
+
+ZEND_METHOD(bcg729DtmfDetector, __construct) {
+    zend_long sample_rate = 8000;
+
+    ZEND_PARSE_PARAMETERS_START(0, 1)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_LONG(sample_rate)
+    ZEND_PARSE_PARAMETERS_END();
+
+    if (sample_rate < 8000 || sample_rate > 48000) {
+        zend_argument_value_error(1, "must be between 8000 and 48000");
+        RETURN_THROWS();
+    }
+
+    bcg729DtmfDetector *self = Z_BCG729_DTMF_P(getThis());
+    self->sample_rate = sample_rate;
+    self->block_samples = (uint32_t) (BCG729_DTMF_BLOCK * sample_rate / 8000);
+    for (int k = 0; k < 8; k++) {
+        self->coef[k] = (int32_t) lrint(2.0 * cos(2.0 * M_PI * bcg729_dtmf_freqs[k] / (double) sample_rate) * 16384.0);
+    }
+    double amp = 32768.0 * pow(10.0, BCG729_DTMF_MIN_DBFS / 20.0) * (double) self->block_samples / 2.0;
+    self->min_power = amp * amp;
+    self->digits = 0;
+    bcg729_dtmf_reset_state(self);
+    zend_hash_clean(Z_ARRVAL(self->events));
+    self->initialized = 1;
+}
+
+/*
+ * Analisa PCM 16-bit LE de qualquer tamanho (o bloco parcial continua na
+ * próxima chamada) e retorna os eventos gerados desde a última entrega:
+ * ['event' => 'start'|'end', 'digit', 'sample', 'time', 'duration' (só no end)].
+ */
+ZEND_METHOD(bcg729DtmfDetector, process) {
+    zend_string *input;
+
+    ZEND_PARSE_PARAMETERS_START(1, 1)
+        Z_PARAM_STR(input)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729DtmfDetector *self = bcg729_dtmf_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+    if (ZSTR_LEN(input) & 1) {
+        RETURN_FALSE;
+    }
+
+    bcg729_dtmf_feed(self, (const int16_t *) ZSTR_VAL(input), ZSTR_LEN(input) / 2);
+    bcg729_dtmf_take_events(self, return_value);
+}
+
+/*
+ * Decodifica um payload G.729 (com o canal) ou G.711 e já passa o PCM
+ * pelo detector enquanto ainda está no cache. Retorna o PCM; os eventos
+ * ficam para events() ou para o próximo process().
+ */
+ZEND_METHOD(bcg729DtmfDetector, decode) {
+    zend_string *payload, *format_name = NULL;
+    zval *zch = NULL;
+
+    ZEND_PARSE_PARAMETERS_START(1, 3)
+        Z_PARAM_STR(payload)
+        Z_PARAM_OPTIONAL
+        Z_PARAM_STR(format_name)
+        Z_PARAM_OBJECT_OF_CLASS_OR_NULL(zch, bcg729_ce)
+    ZEND_PARSE_PARAMETERS_END();
+
+    bcg729DtmfDetector *self = bcg729_dtmf_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
+
+    int fmt = format_name ? bcg729_format_from_name(format_name) : BCG729_FMT_G729;
+    if (fmt != BCG729_FMT_G729 && fmt != BCG729_FMT_PCMA && fmt != BCG729_FMT_PCMU) {
+        zend_argument_value_error(2, "must be \"g729\", \"pcma\" or \"pcmu\"");
+        RETURN_THROWS();
+    }
+
+    const uint8_t *src = (const uint8_t *) ZSTR_VAL(payload);
+    size_t len = ZSTR_LEN(payload);
+    size_t samples = fmt == BCG729_FMT_G729 ? bcg729_payload_frames(len) * 80 : len;
+    if (samples == 0) {
+        RETURN_FALSE;
+    }
 
-    size_t len = ZSTR_LEN(input);
-    if (len < 2 || (len & 1) != 0) {
-        RETURN_EMPTY_STRING();
+    bcg729Channel *channel = NULL;
+    if (fmt == BCG729_FMT_G729) {
+        if (!zch) {
+            zend_argument_value_error(3, "must be a bcg729Channel for G.729 payloads");
+            RETURN_THROWS();
+        }
+        channel = Z_BCG729_CHANNEL_P(zch);
+        if (!bcg729_channel_decoder(channel)) {
+            RETURN_FALSE;
+        }
     }
 
-    zend_string *out = zend_string_alloc(len, 0);
-    unsigned char *dst = (unsigned char *) ZSTR_VAL(out);
-    const unsigned char *src = (const unsigned char *) ZSTR_VAL(input);
+    zend_string *out = zend_string_alloc(samples * 2, 0);
+    int16_t *dst = (int16_t *) ZSTR_VAL(out);
 
-    for (size_t i = 0; i < len; i += 2) {
-        dst[i]     = src[i + 1];  /* high byte */
-        dst[i + 1] = src[i];      /* low byte */
+    switch (fmt) {
+        case BCG729_FMT_G729:
+            bcg729_channel_decode_frames(channel, src, len, samples / 80, dst);
+            break;
+        case BCG729_FMT_PCMA:
+            bcg729_alaw_decode(dst, src, samples);
+            break;
+        default:
+            bcg729_ulaw_decode(dst, src, samples);
+            break;
     }
+    bcg729_dtmf_feed(self, dst, samples);
 
-    dst[len] = '\0';
+    ZSTR_VAL(out)[samples * 2] = '\0';
     RETURN_STR(out);
 }
 
-/* ------------------------------------------------------------------------- */
-/*    mixAudioChannels: mix de vários canais PCM 16-bit                       */
-/* ------------------------------------------------------------------------- */
+/* Eventos pendentes (gerados por decode()) */
+ZEND_METHOD(bcg729DtmfDetector, events) {
+    ZEND_PARSE_PARAMETERS_NONE();
 
-ZEND_FUNCTION(mixAudioChannels) {
-    zval *channels_array;
-    zend_long sample_rate = 8000;
+    bcg729DtmfDetector *self = bcg729_dtmf_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
+    }
 
-    ZEND_PARSE_PARAMETERS_START(1, 2)
-        Z_PARAM_ARRAY(channels_array)
-        Z_PARAM_OPTIONAL
-        Z_PARAM_LONG(sample_rate)
-    ZEND_PARSE_PARAMETERS_END();
+    bcg729_dtmf_take_events(self, return_value);
+}
 
-    HashTable *channels = Z_ARRVAL_P(channels_array);
-    uint32_t num_channels = zend_hash_num_elements(channels);
+/* Descarta bloco parcial, dígito ativo e eventos pendentes; o relógio volta a zero */
+ZEND_METHOD(bcg729DtmfDetector, reset) {
+    ZEND_PARSE_PARAMETERS_NONE();
 
-    if (num_channels == 0) {
-        RETURN_EMPTY_STRING();
+    bcg729DtmfDetector *self = bcg729_dtmf_fetch(getThis());
+    if (!self) {
+        RETURN_THROWS();
     }
 
-    if (num_channels == 1) {
-        zval *first = zend_hash_index_find(channels, 0);
-        if (!first) {
-            first = zend_hash_get_current_data(channels);
-        }
-        if (first && Z_TYPE_P(first) == IS_STRING) {
-            RETURN_STR_COPY(Z_STR_P(first));
-        }
-        RETURN_EMPTY_STRING();
-    }
+    bcg729_dtmf_reset_state(self);
+    zend_hash_clean(Z_ARRVAL(self->events));
+}
 
-    /* Descobre o número máximo de samples entre todos os canais */
-    size_t max_samples = 0;
-    zval *channel_data;
+ZEND_METHOD(bcg729DtmfDetector, info) {
+    ZEND_PARSE_PARAMETERS_NONE();
 
-    ZEND_HASH_FOREACH_VAL(channels, channel_data) {
-        if (Z_TYPE_P(channel_data) != IS_STRING) {
-            continue;
-        }
-        size_t len = Z_STRLEN_P(channel_data);
-        if ((len & 1) != 0) {
-            php_error_docref(NULL, E_WARNING, "Canal de áudio com tamanho inválido (deve ser múltiplo de 2)");
-            RETURN_FALSE;
-        }
-        size_t samples = len / 2;
-        if (samples > max_samples) {
-            max_samples = samples;
-        }
-    } ZEND_HASH_FOREACH_END();
+    bcg729DtmfDetector *self = Z_BCG729_DTMF_P(getThis());
 
-    if (max_samples == 0) {
-        RETURN_EMPTY_STRING();
+    array_init(return_value);
+    add_assoc_long(return_value, "sample_rate", self->sample_rate);
+    add_assoc_long(return_value, "block_samples", self->block_samples);
+    if (self->digit) {
+        add_assoc_stringl(return_value, "digit", &self->digit, 1);
+    } else {
+        add_assoc_null(return_value, "digit");
     }
+    add_assoc_long(return_value, "samples", (zend_long) self->samples);
+    add_assoc_long(return_value, "digits", (zend_long) self->digits);
+    add_assoc_long(return_value, "pending_events", (zend_long) zend_hash_num_elements(Z_ARRVAL(self->events)));
+}
 
-    int32_t *mix_buffer = (int32_t *) ecalloc(max_samples, sizeof(int32_t));
-    if (!mix_buffer) {
-        php_error_docref(NULL, E_ERROR, "Falha ao alocar memória para mixagem");
-        RETURN_FALSE; /* ecalloc falhando já é fim de mundo de qualquer jeito */
-    }
+ZEND_BEGIN_ARG_INFO_EX(arginfo_dtmf_construct, 0, 0, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, sampleRate, IS_LONG, 0, "8000")
+ZEND_END_ARG_INFO()
 
-    uint32_t active_channels = 0;
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_dtmf_process, 0, 1, MAY_BE_ARRAY | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, pcm, IS_STRING, 0)
+ZEND_END_ARG_INFO()
 
-    ZEND_HASH_FOREACH_VAL(channels, channel_data) {
-        if (Z_TYPE_P(channel_data) != IS_STRING) {
-            continue;
-        }
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_dtmf_decode, 0, 1, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, payload, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, format, IS_STRING, 0, "\"g729\"")
+    ZEND_ARG_OBJ_INFO_WITH_DEFAULT_VALUE(0, channel, bcg729Channel, 1, "null")
+ZEND_END_ARG_INFO()
 
-        const int16_t *samples = (const int16_t *) Z_STRVAL_P(channel_data);
-        size_t num_samples = Z_STRLEN_P(channel_data) / 2;
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_dtmf_array, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
 
-        for (size_t i = 0; i < num_samples; i++) {
-            mix_buffer[i] += samples[i];
-        }
-        active_channels++;
-    } ZEND_HASH_FOREACH_END();
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_dtmf_void, 0, 0, IS_VOID, 0)
+ZEND_END_ARG_INFO()
 
-    if (active_channels == 0) {
-        efree(mix_buffer);
-        RETURN_EMPTY_STRING();
-    }
+static const zend_function_entry bcg729_dtmf_methods[] = {
+    ZEND_ME(bcg729DtmfDetector, __construct, arginfo_dtmf_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729DtmfDetector, process,     arginfo_dtmf_process,   ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729DtmfDetector, decode,      arginfo_dtmf_decode,    ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729DtmfDetector, events,      arginfo_dtmf_array,     ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729DtmfDetector, reset,       arginfo_dtmf_void,      ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729DtmfDetector, info,        arginfo_dtmf_array,     ZEND_ACC_PUBLIC)
+    ZEND_FE_END
+};
 
-    size_t out_bytes = max_samples * 2;
-    zend_string *out = zend_string_alloc(out_bytes, 0);
-    int16_t *dst = (int16_t *) ZSTR_VAL(out);
+/* ------------------------------------------------------------------------- */
+/*    Stream filters (bcg729.*, g711.*)                                       */
+/* ------------------------------------------------------------------------- */
 
-    double mix_factor = 1.0 / sqrt((double) active_channels);
+/*
+ * Filtros para stream_filter_append()/stream_copy_to_stream(): cada
+ * bucket é convertido em C, e o frame incompleto fica no estado do filtro
+ * até o próximo bucket. No fechamento o encoder G.729 completa o último
+ * frame com silêncio e o resample libera o atraso do filtro.
+ *
+ *   bcg729.encode      PCM 16-bit LE -> G.729 (frames de 10 bytes)
+ *   bcg729.decode      G.729 -> PCM 16-bit LE
+ *   bcg729.resample    PCM 16-bit LE, parâmetros ['from' => Hz, 'to' => Hz]
+ *   g711.alaw.encode / g711.alaw.decode / g711.ulaw.encode / g711.ulaw.decode
+ */
+
+#define BCG729_SF_G729_ENCODE 1
+#define BCG729_SF_G729_DECODE 2
+#define BCG729_SF_ALAW_ENCODE 3
+#define BCG729_SF_ALAW_DECODE 4
+#define BCG729_SF_ULAW_ENCODE 5
+#define BCG729_SF_ULAW_DECODE 6
+#define BCG729_SF_RESAMPLE    7
 
-    for (size_t i = 0; i < max_samples; i++) {
-        int32_t mixed = (int32_t) (mix_buffer[i] * mix_factor);
-        int16_t output;
-        if (mixed > 32767) {
-            output = 32767;
-        } else if (mixed < -32768) {
-            output = -32768;
-        } else {
-            output = (int16_t) mixed;
-        }
-        dst[i] = output;
+typedef struct {
+    int kind;                    /* BCG729_SF_* */
+    size_t unit;                 /* bytes de entrada por unidade convertida */
+    void *ctx;                   /* contexto G.729 (do pool) */
+    bcg729Resampler rs;          /* estado do resample (só os campos do filtro) */
+    unsigned char carry[160];    /* unidade incompleta entre buckets */
+    size_t carry_len;
+} bcg729StreamFilter;
+
+/* Bytes de saída no pior caso para units unidades */
+static size_t bcg729_sf_max_out(const bcg729StreamFilter *sf, size_t units) {
+    switch (sf->kind) {
+        case BCG729_SF_G729_ENCODE:
+            return units * 10;
+        case BCG729_SF_G729_DECODE:
+            return units * 160;
+        case BCG729_SF_ALAW_DECODE:
+        case BCG729_SF_ULAW_DECODE:
+            return units * 2;
+        case BCG729_SF_RESAMPLE:
+            return bcg729_resampler_max_out(&sf->rs, units) * 2;
+        default:
+            return units;
     }
+}
 
-    efree(mix_buffer);
+/* Converte units unidades inteiras de in (alinhado) em out; retorna os bytes escritos */
+static size_t bcg729_sf_convert(bcg729StreamFilter *sf, const unsigned char *in, size_t units, unsigned char *out) {
+    size_t pos = 0;
 
-    ZSTR_VAL(out)[out_bytes] = '\0';
-    RETURN_STR(out);
+    switch (sf->kind) {
+        case BCG729_SF_G729_ENCODE:
+            for (size_t i = 0; i < units; i++) {
+                uint8_t frame_len = 0;
+                bcg729Encoder(sf->ctx, (const int16_t *) (in + (i * 160)), out + pos, &frame_len);
+                pos += frame_len;
+            }
+            return pos;
+        case BCG729_SF_G729_DECODE:
+            for (size_t i = 0; i < units; i++) {
+                bcg729Decoder(sf->ctx, in + (i * 10), 10, 0, 0, 0, (int16_t *) (out + (i * 160)));
+            }
+            return units * 160;
+        case BCG729_SF_ALAW_ENCODE:
+        case BCG729_SF_ULAW_ENCODE: {
+            const uint8_t *table = sf->kind == BCG729_SF_ALAW_ENCODE ? linear_to_alaw : linear_to_ulaw;
+            const int16_t *pcm = (const int16_t *) in;
+            for (size_t i = 0; i < units; i++) {
+                out[i] = table[(uint16_t) pcm[i]];
+            }
+            return units;
+        }
+        case BCG729_SF_ALAW_DECODE:
+            bcg729_alaw_decode((int16_t *) out, in, units);
+            return units * 2;
+        case BCG729_SF_ULAW_DECODE:
+            bcg729_ulaw_decode((int16_t *) out, in, units);
+            return units * 2;
+        default:
+            return bcg729_resampler_run(&sf->rs, (const int16_t *) in, units, out, 0) * 2;
+    }
 }
 
-/* ------------------------------------------------------------------------- */
-/*    Classe bcg729Channel                                                    */
-/* ------------------------------------------------------------------------- */
+static void bcg729_sf_emit(php_stream *stream, php_stream_bucket_brigade *buckets_out, unsigned char *out, size_t len) {
+    if (len == 0) {
+        efree(out);
+        return;
+    }
+    php_stream_bucket_append(buckets_out, php_stream_bucket_new(stream, (char *) out, len, 1, 0));
+}
 
-ZEND_METHOD(bcg729Channel, __construct) {}
+static php_stream_filter_status_t bcg729_sf_filter(php_stream *stream, php_stream_filter *thisfilter,
+        php_stream_bucket_brigade *buckets_in, php_stream_bucket_brigade *buckets_out,
+        size_t *bytes_consumed, int flags) {
+    bcg729StreamFilter *sf = (bcg729StreamFilter *) Z_PTR(thisfilter->abstract);
+    php_stream_bucket *bucket;
+    size_t consumed = 0;
+    zend_bool produced = 0;
+
+    while ((bucket = buckets_in->head) != NULL) {
+        php_stream_bucket_unlink(bucket);
+
+        /* sobra + bucket num bloco alinhado, convertido em unidades inteiras */
+        size_t avail = sf->carry_len + bucket->buflen;
+        size_t units = avail / sf->unit;
+        size_t whole = units * sf->unit;
+
+        if (units > 0) {
+            unsigned char *work = emalloc(whole);
+            size_t from_bucket = whole - sf->carry_len;
+            memcpy(work, sf->carry, sf->carry_len);
+            memcpy(work + sf->carry_len, bucket->buf, from_bucket);
+
+            unsigned char *out = safe_emalloc(1, bcg729_sf_max_out(sf, units), 1);
+            size_t len = bcg729_sf_convert(sf, work, units, out);
+            efree(work);
+            bcg729_sf_emit(stream, buckets_out, out, len);
+            produced |= len > 0;
+
+            sf->carry_len = bucket->buflen - from_bucket;
+            memcpy(sf->carry, bucket->buf + from_bucket, sf->carry_len);
+        } else {
+            memcpy(sf->carry + sf->carry_len, bucket->buf, bucket->buflen);
+            sf->carry_len += bucket->buflen;
+        }
 
-ZEND_METHOD(bcg729Channel, decode) {
-    zend_string *input;
+        consumed += bucket->buflen;
+        php_stream_bucket_delref(bucket);
+    }
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+    if (flags & PSFS_FLAG_FLUSH_CLOSE) {
+        unsigned char *out = NULL;
+        size_t len = 0;
+
+        if (sf->kind == BCG729_SF_G729_ENCODE && sf->carry_len > 0) {
+            /* último frame completado com silêncio */
+            memset(sf->carry + sf->carry_len, 0, 160 - sf->carry_len);
+            out = emalloc(10);
+            len = bcg729_sf_convert(sf, sf->carry, 1, out);
+        } else if (sf->kind == BCG729_SF_RESAMPLE) {
+            /* meio filtro de silêncio libera o atraso de grupo */
+            size_t pad = sf->rs.filter->taps / 2;
+            int16_t *zeros = (int16_t *) ecalloc(pad, sizeof(int16_t));
+            out = safe_emalloc(1, bcg729_sf_max_out(sf, pad), 1);
+            len = bcg729_sf_convert(sf, (const unsigned char *) zeros, pad, out);
+            efree(zeros);
+            bcg729_resampler_reset_state(&sf->rs);
+        }
+        sf->carry_len = 0;
 
-    size_t len = ZSTR_LEN(input);
-    if (len == 0 || (len % 10) != 0) {
-        RETURN_FALSE;
+        if (out) {
+            bcg729_sf_emit(stream, buckets_out, out, len);
+            produced |= len > 0;
+        }
     }
 
-    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
-    if (!self->decoder) {
-        php_error_docref(NULL, E_WARNING, "Decoder channel is closed or not initialized");
-        RETURN_FALSE;
+    if (bytes_consumed) {
+        *bytes_consumed = consumed;
     }
 
-    size_t frames = len / 10;
-    size_t out_samples = frames * 80; /* 80 amostras por frame */
-    size_t out_bytes = out_samples * 2;
+    return produced ? PSFS_PASS_ON : PSFS_FEED_ME;
+}
 
-    zend_string *out = zend_string_alloc(out_bytes, 0);
-    int16_t *dst = (int16_t *) ZSTR_VAL(out);
-    const uint8_t *src = (const uint8_t *) ZSTR_VAL(input);
+static void bcg729_sf_dtor(php_stream_filter *thisfilter) {
+    bcg729StreamFilter *sf = (bcg729StreamFilter *) Z_PTR(thisfilter->abstract);
 
-    for (size_t i = 0; i < frames; i++) {
-        int16_t pcmOut[80] = {0};
-        const uint8_t *frame = src + (i * 10);
-        bcg729Decoder(self->decoder, frame, 10, 0, 0, 0, pcmOut);
-        memcpy(dst + (i * 80), pcmOut, sizeof(pcmOut));
+    if (sf->kind == BCG729_SF_G729_ENCODE) {
+        bcg729_pool_release(BCG729_POOL_ENCODER, sf->ctx);
+    } else if (sf->kind == BCG729_SF_G729_DECODE) {
+        bcg729_pool_release(BCG729_POOL_DECODER, sf->ctx);
     }
-
-    ZSTR_VAL(out)[out_bytes] = '\0';
-    RETURN_STR(out);
+    if (sf->rs.buf) {
+        efree(sf->rs.buf);
+    }
+    efree(sf);
 }
 
-ZEND_METHOD(bcg729Channel, encode) {
-    zend_string *input;
+static const php_stream_filter_ops bcg729_sf_ops = {
+    bcg729_sf_filter,
+    bcg729_sf_dtor,
+    "bcg729.*"
+};
 
-    ZEND_PARSE_PARAMETERS_START(1, 1)
-        Z_PARAM_STR(input)
-    ZEND_PARSE_PARAMETERS_END();
+/* Taxas do bcg729.resample: ['from' => Hz, 'to' => Hz] */
+static zend_bool bcg729_sf_resample_init(bcg729StreamFilter *sf, zval *params) {
+    zval *from = NULL, *to = NULL;
 
-    size_t len = ZSTR_LEN(input);
-    if (len == 0 || (len % 160) != 0) {
-        RETURN_FALSE;
+    if (params && Z_TYPE_P(params) == IS_ARRAY) {
+        from = zend_hash_str_find(Z_ARRVAL_P(params), "from", sizeof("from") - 1);
+        to = zend_hash_str_find(Z_ARRVAL_P(params), "to", sizeof("to") - 1);
     }
-
-    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
-    if (!self->encoder) {
-        php_error_docref(NULL, E_WARNING, "Encoder channel is closed or not initialized");
-        RETURN_FALSE;
+    if (!from || !to) {
+        php_error_docref(NULL, E_WARNING, "bcg729.resample requires the \"from\" and \"to\" parameters");
+        return 0;
     }
 
-    size_t frames = len / 160;
+    zend_long src_rate = zval_get_long(from), dst_rate = zval_get_long(to);
+    if (src_rate <= 0 || src_rate > 384000 || dst_rate <= 0 || dst_rate > 384000) {
+        php_error_docref(NULL, E_WARNING, "bcg729.resample rates must be between 1 and 384000");
+        return 0;
+    }
 
-    /* Tamanho máximo: 10 bytes por frame */
-    size_t max_out = frames * 10;
-    zend_string *out = zend_string_alloc(max_out, 0);
-    uint8_t *dst = (uint8_t *) ZSTR_VAL(out);
-    size_t offset = 0;
+    uint32_t g = bcg729_gcd((uint32_t) src_rate, (uint32_t) dst_rate);
+    uint32_t up = (uint32_t) dst_rate / g;
+    uint32_t down = (uint32_t) src_rate / g;
+    if (up > BCG729_RESAMPLER_MAX_FACTOR || down > BCG729_RESAMPLER_MAX_FACTOR) {
+        php_error_docref(NULL, E_WARNING, "Unsupported rate ratio " ZEND_LONG_FMT ":" ZEND_LONG_FMT, src_rate, dst_rate);
+        return 0;
+    }
 
-    const char *raw = ZSTR_VAL(input);
+    sf->rs.filter = bcg729_resampler_filter_get(up, down);
+    sf->rs.src_rate = src_rate;
+    sf->rs.dst_rate = dst_rate;
+    sf->rs.buf_cap = sf->rs.filter->taps + 320;
+    sf->rs.buf = (int16_t *) safe_emalloc(sf->rs.buf_cap, sizeof(int16_t), 0);
+    bcg729_resampler_reset_state(&sf->rs);
+    return 1;
+}
 
-    for (size_t i = 0; i < frames; i++) {
-        const int16_t *pcmIn = (const int16_t *) (raw + (i * 160));
-        uint8_t g729[10];
-        uint8_t frame_len = 0;
+static php_stream_filter *bcg729_sf_create(const char *filtername, zval *filterparams, uint8_t persistent) {
+    static const struct {
+        const char *name;
+        int kind;
+        size_t unit;
+    } names[] = {
+        { "bcg729.encode",    BCG729_SF_G729_ENCODE, 160 },
+        { "bcg729.decode",    BCG729_SF_G729_DECODE, 10 },
+        { "bcg729.resample",  BCG729_SF_RESAMPLE,    2 },
+        { "g711.alaw.encode", BCG729_SF_ALAW_ENCODE, 2 },
+        { "g711.alaw.decode", BCG729_SF_ALAW_DECODE, 1 },
+        { "g711.ulaw.encode", BCG729_SF_ULAW_ENCODE, 2 },
+        { "g711.ulaw.decode", BCG729_SF_ULAW_DECODE, 1 },
+    };
+    int kind = 0;
+    size_t unit = 0;
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcasecmp(filtername, names[i].name) == 0) {
+            kind = names[i].kind;
+            unit = names[i].unit;
+            break;
+        }
+    }
+    if (!kind) {
+        return NULL;
+    }
+    if (persistent) {
+        php_error_docref(NULL, E_WARNING, "Filter %s cannot be used on persistent streams", filtername);
+        return NULL;
+    }
 
-        bcg729Encoder(self->encoder, pcmIn, g729, &frame_len);
+    bcg729StreamFilter *sf = ecalloc(1, sizeof(bcg729StreamFilter));
+    sf->kind = kind;
+    sf->unit = unit;
 
-        if (frame_len > 0) {
-            if (offset + frame_len > max_out) {
-                /* segurança extra, mas em teoria não deveria acontecer */
-                frame_len = (uint8_t) (max_out - offset);
-            }
-            memcpy(dst + offset, g729, frame_len);
-            offset += frame_len;
-        }
+    if (kind == BCG729_SF_RESAMPLE && !bcg729_sf_resample_init(sf, filterparams)) {
+        efree(sf);
+        return NULL;
+    }
+    if (kind == BCG729_SF_G729_ENCODE) {
+        sf->ctx = bcg729_pool_acquire(BCG729_POOL_ENCODER);
+    } else if (kind == BCG729_SF_G729_DECODE) {
+        sf->ctx = bcg729_pool_acquire(BCG729_POOL_DECODER);
     }
 
-    dst[offset] = '\0';
-    ZSTR_LEN(out) = offset;
-    RETURN_STR(out);
+    return php_stream_filter_alloc(&bcg729_sf_ops, sf, 0);
 }
 
-ZEND_METHOD(bcg729Channel, info) {
+static const php_stream_filter_factory bcg729_sf_factory = {
+    bcg729_sf_create
+};
+
+/* ------------------------------------------------------------------------- */
+/*    bcg729_stats() e phpinfo()                                              */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Agregados de todos os canais do processo (da thread, em ZTS): canais
+ * vivos, criados e a soma dos contadores de info(), inclusive de canais
+ * já destruídos. O tempo é o gasto dentro de bcg729Encoder/bcg729Decoder.
+ */
+ZEND_FUNCTION(bcg729_stats) {
+    ZEND_PARSE_PARAMETERS_NONE();
+
+    bcg729ChannelStats total;
+    uint32_t live = bcg729_stats_total(&total);
+
     array_init(return_value);
-    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
-    add_assoc_bool(return_value, "decoder_initialized", self->decoder != NULL);
-    add_assoc_bool(return_value, "encoder_initialized", self->encoder != NULL);
+    add_assoc_long(return_value, "live_channels", live);
+    add_assoc_long(return_value, "channels_created", (zend_long) BCG729_G(channels_created));
+    bcg729_stats_to_array(return_value, &total);
+    add_assoc_double(return_value, "encoder_ns_per_frame",
+        total.frames_encoded ? (double) total.encoder_ns / total.frames_encoded : 0.0);
+    add_assoc_double(return_value, "decoder_ns_per_frame",
+        (total.frames_decoded + total.erasures) ? (double) total.decoder_ns / (total.frames_decoded + total.erasures) : 0.0);
+    add_assoc_string(return_value, "simd", (char *) bcg729_simd_level);
+    add_assoc_long(return_value, "threads", bcg729_threads_running());
 }
 
-ZEND_METHOD(bcg729Channel, close) {
-    bcg729Channel *self = Z_BCG729_CHANNEL_P(getThis());
-
-    if (self->decoder) {
-        closeBcg729DecoderChannel(self->decoder);
-        self->decoder = NULL;
+PHP_MINFO_FUNCTION(bcg729) {
+    bcg729ChannelStats total;
+    uint32_t live = bcg729_stats_total(&total);
+    char buf[64];
+
+    php_info_print_table_start();
+    php_info_print_table_header(2, "bcg729 support", "enabled");
+    php_info_print_table_row(2, "Version", PHP_BCG729_VERSION);
+    php_info_print_table_row(2, "SIMD kernels", bcg729_simd_level);
+    if (bcg729_threads_running() > 1) {
+        snprintf(buf, sizeof(buf), "available (%d)", bcg729_threads_running());
+        php_info_print_table_row(2, "Native threads", buf);
+    } else {
+        php_info_print_table_row(2, "Native threads", BCG729_G(threads) > 1 ? "not started" : "unavailable");
     }
 
-    if (self->encoder) {
-        closeBcg729EncoderChannel(self->encoder);
-        self->encoder = NULL;
-    }
+    snprintf(buf, sizeof(buf), "%zu / %zu / %zu", bcg729_decoder_ctx_bytes, bcg729_encoder_ctx_bytes, bcg729_encoder_vad_ctx_bytes);
+    php_info_print_table_row(2, "Context bytes (decoder / encoder / encoder VAD)", buf);
 
-    gc_collect_cycles();
+    snprintf(buf, sizeof(buf), "%u", live);
+    php_info_print_table_row(2, "Live channels", buf);
+    snprintf(buf, sizeof(buf), "%llu / %llu", (unsigned long long) total.frames_encoded, (unsigned long long) total.frames_decoded);
+    php_info_print_table_row(2, "Frames encoded / decoded", buf);
+    snprintf(buf, sizeof(buf), "%.3f / %.3f", (double) total.encoder_ns / 1e6, (double) total.decoder_ns / 1e6);
+    php_info_print_table_row(2, "Encoder / decoder time (ms)", buf);
+    php_info_print_table_end();
 
-    RETURN_TRUE;
+    DISPLAY_INI_ENTRIES();
 }
 
 /* ------------------------------------------------------------------------- */
@@ -713,17 +7303,83 @@ ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_codec_io, 0, 1, IS_STRING, 0)
     ZEND_ARG_TYPE_INFO(0, input, IS_STRING, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_push, 0, 1, MAY_BE_LONG | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, pcm, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_pull, 0, 1, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, maxFrames, IS_LONG, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_codec_into, 0, 2, MAY_BE_LONG | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, input, IS_STRING, 0)
+    ZEND_ARG_INFO(1, output)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, offset, IS_LONG, 0, "0")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_batch, 0, 2, IS_ARRAY, 0)
+    ZEND_ARG_TYPE_INFO(0, channels, IS_ARRAY, 0)
+    ZEND_ARG_TYPE_INFO(0, inputs, IS_ARRAY, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, packed, _IS_BOOL, 0, "false")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_INFO_EX(arginfo_channel_construct, 0, 0, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, annexB, _IS_BOOL, 0, "false")
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, mode, IS_LONG, 0, "bcg729Channel::BOTH")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_codec_io_or_false, 0, 1, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, input, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_export_state, 0, 0, MAY_BE_STRING | MAY_BE_FALSE)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_import_state, 0, 1, _IS_BOOL, 0)
+    ZEND_ARG_TYPE_INFO(0, state, IS_STRING, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_serialize, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_unserialize, 0, 1, IS_VOID, 0)
+    ZEND_ARG_TYPE_INFO(0, data, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_decode_lost, 0, 0, MAY_BE_STRING | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, frames, IS_LONG, 0, "1")
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry bcg729_methods[] = {
-    ZEND_ME(bcg729Channel, __construct, arginfo_void,    ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
+    ZEND_ME(bcg729Channel, __construct, arginfo_channel_construct, ZEND_ACC_PUBLIC | ZEND_ACC_CTOR)
     ZEND_ME(bcg729Channel, decode,      arginfo_codec_io, ZEND_ACC_PUBLIC)
     ZEND_ME(bcg729Channel, encode,      arginfo_codec_io, ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, decodeInto,     arginfo_codec_into,        ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, encodeInto,     arginfo_codec_into,        ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, decodeLost,     arginfo_decode_lost,       ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, encodeBatch,    arginfo_batch,             ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+    ZEND_ME(bcg729Channel, decodeBatch,    arginfo_batch,             ZEND_ACC_PUBLIC | ZEND_ACC_STATIC)
+    ZEND_ME(bcg729Channel, push,           arginfo_push,              ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, pull,           arginfo_pull,              ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, decodeToPcma,   arginfo_codec_io_or_false, ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, decodeToPcmu,   arginfo_codec_io_or_false, ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, encodeFromPcma, arginfo_codec_io_or_false, ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, encodeFromPcmu, arginfo_codec_io_or_false, ZEND_ACC_PUBLIC)
     ZEND_ME(bcg729Channel, info,        arginfo_void,    ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, reset,       arginfo_void,    ZEND_ACC_PUBLIC)
     ZEND_ME(bcg729Channel, close,       arginfo_void,    ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, exportState,    arginfo_export_state,      ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, importState,    arginfo_import_state,      ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, __serialize,    arginfo_serialize,         ZEND_ACC_PUBLIC)
+    ZEND_ME(bcg729Channel, __unserialize,  arginfo_unserialize,       ZEND_ACC_PUBLIC)
     ZEND_FE_END
 };
 
 PHP_MINIT_FUNCTION(bcg729) {
     zend_class_entry ce;
+
+    REGISTER_INI_ENTRIES();
+
     INIT_CLASS_ENTRY(ce, "bcg729Channel", bcg729_methods);
     bcg729_ce = zend_register_internal_class(&ce);
     bcg729_ce->create_object = bcg729_create;
@@ -732,9 +7388,141 @@ PHP_MINIT_FUNCTION(bcg729) {
     bcg729_handlers.offset = XtOffsetOf(bcg729Channel, std);
     bcg729_handlers.free_obj = bcg729_free;
 
+    zend_declare_class_constant_long(bcg729_ce, "ENCODE_ONLY", sizeof("ENCODE_ONLY") - 1, BCG729_MODE_ENCODE);
+    zend_declare_class_constant_long(bcg729_ce, "DECODE_ONLY", sizeof("DECODE_ONLY") - 1, BCG729_MODE_DECODE);
+    zend_declare_class_constant_long(bcg729_ce, "BOTH", sizeof("BOTH") - 1, BCG729_MODE_BOTH);
+
+    INIT_CLASS_ENTRY(ce, "bcg729Resampler", bcg729_resampler_methods);
+    bcg729_resampler_ce = zend_register_internal_class(&ce);
+    bcg729_resampler_ce->create_object = bcg729_resampler_create;
+
+    memcpy(&bcg729_resampler_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_resampler_handlers.offset = XtOffsetOf(bcg729Resampler, std);
+    bcg729_resampler_handlers.free_obj = bcg729_resampler_free;
+    bcg729_resampler_handlers.clone_obj = NULL;
+
+    INIT_CLASS_ENTRY(ce, "bcg729Mixer", bcg729_mixer_methods);
+    bcg729_mixer_ce = zend_register_internal_class(&ce);
+    bcg729_mixer_ce->create_object = bcg729_mixer_create;
+
+    memcpy(&bcg729_mixer_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_mixer_handlers.offset = XtOffsetOf(bcg729Mixer, std);
+    bcg729_mixer_handlers.free_obj = bcg729_mixer_free;
+    bcg729_mixer_handlers.clone_obj = NULL;
+
+    INIT_CLASS_ENTRY(ce, "bcg729Analyzer", bcg729_analyzer_methods);
+    bcg729_analyzer_ce = zend_register_internal_class(&ce);
+    bcg729_analyzer_ce->create_object = bcg729_analyzer_create;
+
+    memcpy(&bcg729_analyzer_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_analyzer_handlers.offset = XtOffsetOf(bcg729Analyzer, std);
+    bcg729_analyzer_handlers.free_obj = bcg729_analyzer_free;
+    bcg729_analyzer_handlers.clone_obj = NULL;
+
+    INIT_CLASS_ENTRY(ce, "bcg729WavWriter", bcg729_wav_writer_methods);
+    bcg729_wav_writer_ce = zend_register_internal_class(&ce);
+    bcg729_wav_writer_ce->create_object = bcg729_wav_writer_create;
+
+    memcpy(&bcg729_wav_writer_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_wav_writer_handlers.offset = XtOffsetOf(bcg729WavWriter, std);
+    bcg729_wav_writer_handlers.dtor_obj = bcg729_wav_writer_dtor;
+    bcg729_wav_writer_handlers.free_obj = bcg729_wav_writer_free;
+    bcg729_wav_writer_handlers.clone_obj = NULL;
+
+    INIT_CLASS_ENTRY(ce, "bcg729WavReader", bcg729_wav_reader_methods);
+    bcg729_wav_reader_ce = zend_register_internal_class(&ce);
+    bcg729_wav_reader_ce->create_object = bcg729_wav_reader_create;
+
+    memcpy(&bcg729_wav_reader_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_wav_reader_handlers.offset = XtOffsetOf(bcg729WavReader, std);
+    bcg729_wav_reader_handlers.dtor_obj = bcg729_wav_reader_dtor;
+    bcg729_wav_reader_handlers.free_obj = bcg729_wav_reader_free;
+    bcg729_wav_reader_handlers.clone_obj = NULL;
+
+    INIT_CLASS_ENTRY(ce, "bcg729Rtp", bcg729_rtp_methods);
+    bcg729_rtp_ce = zend_register_internal_class(&ce);
+    bcg729_rtp_ce->create_object = bcg729_rtp_create;
+
+    memcpy(&bcg729_rtp_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_rtp_handlers.offset = XtOffsetOf(bcg729Rtp, std);
+    bcg729_rtp_handlers.free_obj = bcg729_rtp_free;
+    bcg729_rtp_handlers.clone_obj = NULL;
+
+    INIT_CLASS_ENTRY(ce, "bcg729JitterBuffer", bcg729_jb_methods);
+    bcg729_jb_ce = zend_register_internal_class(&ce);
+    bcg729_jb_ce->create_object = bcg729_jb_create;
+
+    memcpy(&bcg729_jb_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_jb_handlers.offset = XtOffsetOf(bcg729JitterBuffer, std);
+    bcg729_jb_handlers.free_obj = bcg729_jb_free;
+    bcg729_jb_handlers.clone_obj = NULL;
+
+    INIT_CLASS_ENTRY(ce, "bcg729DtmfDetector", bcg729_dtmf_methods);
+    bcg729_dtmf_ce = zend_register_internal_class(&ce);
+    bcg729_dtmf_ce->create_object = bcg729_dtmf_create;
+
+    memcpy(&bcg729_dtmf_handlers, zend_get_std_object_handlers(), sizeof(zend_object_handlers));
+    bcg729_dtmf_handlers.offset = XtOffsetOf(bcg729DtmfDetector, std);
+    bcg729_dtmf_handlers.free_obj = bcg729_dtmf_free;
+    bcg729_dtmf_handlers.clone_obj = NULL;
+
+    bcg729_q15_kernels_init();
+    bcg729_g711_tables_init();
+    if (BCG729_G(simd)) {
+        bcg729_simd_init();
+        bcg729_q15_simd_init();
+    }
+    bcg729_ctx_sizes_init();
+
+    php_stream_filter_register_factory("bcg729.*", &bcg729_sf_factory);
+    php_stream_filter_register_factory("g711.*", &bcg729_sf_factory);
+
+    return SUCCESS;
+}
+
+PHP_MSHUTDOWN_FUNCTION(bcg729) {
+    php_stream_filter_unregister_factory("bcg729.*");
+    php_stream_filter_unregister_factory("g711.*");
+    bcg729_tp_shutdown();
+    UNREGISTER_INI_ENTRIES();
+    return SUCCESS;
+}
+
+/* Completa o pool de decoders/encoders no início de cada request */
+PHP_RINIT_FUNCTION(bcg729) {
+#if defined(COMPILE_DL_BCG729) && defined(ZTS)
+    ZEND_TSRMLS_CACHE_UPDATE();
+#endif
+    bcg729_pool_fill(BCG729_POOL_DECODER);
+    bcg729_pool_fill(BCG729_POOL_ENCODER);
     return SUCCESS;
 }
 
+static PHP_GINIT_FUNCTION(bcg729) {
+#if defined(COMPILE_DL_BCG729) && defined(ZTS)
+    ZEND_TSRMLS_CACHE_UPDATE();
+#endif
+    bcg729_globals->resampler_filters = NULL;
+    bcg729_globals->pool_size = 0;
+    bcg729_globals->threads = 1;
+    bcg729_globals->simd = 1;
+    bcg729_globals->state_frames = 0;
+    bcg729_globals->live_channels = NULL;
+    bcg729_globals->channels_created = 0;
+    memset(&bcg729_globals->retired_stats, 0, sizeof(bcg729_globals->retired_stats));
+    for (int kind = 0; kind < BCG729_POOL_KINDS; kind++) {
+        bcg729_globals->pool[kind] = NULL;
+        bcg729_globals->pool_count[kind] = 0;
+        bcg729_globals->pool_cap[kind] = 0;
+    }
+}
+
+static PHP_GSHUTDOWN_FUNCTION(bcg729) {
+    bcg729_resampler_filters_free(bcg729_globals->resampler_filters);
+    bcg729_globals->resampler_filters = NULL;
+    bcg729_pool_free(bcg729_globals);
+}
+
 ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_decode_law, 0, 1, IS_STRING, 0)
     ZEND_ARG_TYPE_INFO(0, input, IS_STRING, 0)
 ZEND_END_ARG_INFO()
@@ -748,6 +7536,21 @@ ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_mix_channels, 0, 1, IS_STRING, 0
     ZEND_ARG_TYPE_INFO(0, sample_rate, IS_LONG, 0)
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_mix_encoded, 0, 3, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, inputs, IS_ARRAY, 0)
+    ZEND_ARG_TYPE_INFO(0, inFormat, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO(0, outFormat, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, gains, IS_ARRAY, 0, "[]")
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(arginfo_bcg729_stats, 0, 0, IS_ARRAY, 0)
+ZEND_END_ARG_INFO()
+
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_MASK_EX(arginfo_analyze_pcm, 0, 1, MAY_BE_ARRAY | MAY_BE_FALSE)
+    ZEND_ARG_TYPE_INFO(0, pcm, IS_STRING, 0)
+    ZEND_ARG_TYPE_INFO_WITH_DEFAULT_VALUE(0, frameSamples, IS_LONG, 0, "80")
+ZEND_END_ARG_INFO()
+
 static const zend_function_entry bcg729_functions[] = {
     ZEND_FE(decodePcmaToPcm,  arginfo_decode_law)
     ZEND_FE(decodePcmuToPcm,  arginfo_decode_law)
@@ -756,8 +7559,14 @@ static const zend_function_entry bcg729_functions[] = {
     ZEND_FE(decodeL16ToPcm,   arginfo_decode_law)
     ZEND_FE(encodePcmToL16,   arginfo_encode_law)
     ZEND_FE(mixAudioChannels, arginfo_mix_channels)
+    ZEND_FE(mixEncoded,       arginfo_mix_encoded)
+    ZEND_FE(analyzePcm,       arginfo_analyze_pcm)
     ZEND_FE(pcmLeToBe,        arginfo_decode_law)
     ZEND_FE(resampler,        arginfo_resampler)
+    ZEND_FE(transcodePcmaToPcmu, arginfo_decode_law)
+    ZEND_FE(transcodePcmuToPcma, arginfo_decode_law)
+    ZEND_FE(bcg729_transcode_file, arginfo_transcode_file)
+    ZEND_FE(bcg729_stats,     arginfo_bcg729_stats)
     ZEND_FE_END
 };
 
@@ -766,14 +7575,21 @@ zend_module_entry bcg729_module_entry = {
     PHP_BCG729_EXTNAME,
     bcg729_functions,
     PHP_MINIT(bcg729),
+    PHP_MSHUTDOWN(bcg729),
+    PHP_RINIT(bcg729),
     NULL,
-    NULL,
-    NULL,
-    NULL,
+    PHP_MINFO(bcg729),
     PHP_BCG729_VERSION,
-    STANDARD_MODULE_PROPERTIES
+    PHP_MODULE_GLOBALS(bcg729),
+    PHP_GINIT(bcg729),
+    PHP_GSHUTDOWN(bcg729),
+    NULL,
+    STANDARD_MODULE_PROPERTIES_EX
 };
 
 #ifdef COMPILE_DL_BCG729
+#ifdef ZTS
+ZEND_TSRMLS_CACHE_DEFINE()
+#endif
 ZEND_GET_MODULE(bcg729)
 #endif
\ No newline at end of file
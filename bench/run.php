@@ -0,0 +1,423 @@
+#!/usr/bin/env php
+<?php
+/**
+ * Benchmarks da extensão bcg729
+ *
+ * Mede cada função/método exportado em pacotes de 10, 20 e 60 ms e, para
+ * os caminhos com vários canais, em diferentes quantidades de canais.
+ * A saída é JSON para permitir comparar releases (gate de upgrade).
+ *
+ * Métricas por caso:
+ *   - ns_per_call / ns_per_frame (frame = 10 ms de áudio a 8 kHz)
+ *   - frames_per_sec (frames de 10 ms processados por segundo de CPU)
+ *   - alloc_bytes_per_call: pico de memória do Zend MM durante uma
+ *     chamada isolada (PHP >= 8.2; null nas versões anteriores)
+ *   - rss_bytes_per_channel: crescimento do RSS por bcg729Channel ativo
+ *
+ * Uso:
+ *   php bench/run.php [--time=0.2] [--sizes=10,20,60] [--channels=1,10,100]
+ *                     [--filter=regex] [--compare-simd] [--output=arquivo.json]
+ *
+ * --compare-simd executa o próprio script duas vezes (bcg729.simd=0 e =1)
+ * e acrescenta a razão escalar/SIMD por caso. bcg729.simd só afeta os
+ * kernels escolhidos em tempo de execução (G.711, byte-swap, mixagem e
+ * o caminho Q15 do resampler()).
+ */
+
+error_reporting(E_ALL);
+ini_set('display_errors', 'stderr');
+
+if (!extension_loaded('bcg729')) {
+    fwrite(STDERR, "Extensão bcg729 não está carregada!\n");
+    exit(1);
+}
+
+$opts = getopt('', ['time:', 'sizes:', 'channels:', 'filter:', 'compare-simd', 'output:']);
+$time_per_case = isset($opts['time']) ? (float) $opts['time'] : 0.2;
+$sizes = array_map('intval', explode(',', $opts['sizes'] ?? '10,20,60'));
+$channel_counts = array_map('intval', explode(',', $opts['channels'] ?? '1,10,100'));
+$filter = $opts['filter'] ?? null;
+
+// ----------------------------------------------------------------------------
+// Modo comparação: roda o script em subprocessos com e sem SIMD
+// ----------------------------------------------------------------------------
+
+if (isset($opts['compare-simd'])) {
+    $args = [];
+    foreach (['time', 'sizes', 'channels', 'filter'] as $name) {
+        if (isset($opts[$name])) {
+            $args[] = escapeshellarg("--$name=" . $opts[$name]);
+        }
+    }
+
+    $runs = [];
+    foreach (['scalar' => '0', 'simd' => '1'] as $label => $flag) {
+        $cmd = escapeshellarg(PHP_BINARY) . " -d bcg729.simd=$flag " . escapeshellarg(__FILE__) . ' ' . implode(' ', $args);
+        $json = shell_exec($cmd);
+        $runs[$label] = $json ? json_decode($json, true) : null;
+        if (!is_array($runs[$label])) {
+            fwrite(STDERR, "Falha ao executar: $cmd\n");
+            exit(1);
+        }
+    }
+
+    $scalar = [];
+    foreach ($runs['scalar']['results'] as $r) {
+        $scalar[$r['name'] . '@' . $r['ptime_ms'] . 'ms/' . $r['channels']] = $r['ns_per_frame'];
+    }
+
+    $speedup = [];
+    foreach ($runs['simd']['results'] as $r) {
+        $key = $r['name'] . '@' . $r['ptime_ms'] . 'ms/' . $r['channels'];
+        if (isset($scalar[$key]) && $r['ns_per_frame'] > 0) {
+            $speedup[$key] = round($scalar[$key] / $r['ns_per_frame'], 3);
+        }
+    }
+
+    emit(['scalar' => $runs['scalar'], 'simd' => $runs['simd'], 'speedup' => $speedup], $opts);
+    exit(0);
+}
+
+// ----------------------------------------------------------------------------
+// Dados de entrada
+// ----------------------------------------------------------------------------
+
+function pcm_frame($samples) {
+    $data = '';
+    for ($i = 0; $i < $samples; $i++) {
+        $data .= pack('s', (int) (sin($i * 0.1) * 12000 + sin($i * 0.37) * 4000));
+    }
+    return $data;
+}
+
+function rss_bytes() {
+    $status = @file_get_contents('/proc/self/status');
+    if ($status && preg_match('/VmRSS:\s+(\d+)\s+kB/', $status, $m)) {
+        return (int) $m[1] * 1024;
+    }
+    return null;
+}
+
+function measure($fn, $time_per_case) {
+    // aquecimento + calibração
+    $calls = 1;
+    while (true) {
+        $start = hrtime(true);
+        for ($i = 0; $i < $calls; $i++) {
+            $fn();
+        }
+        $elapsed = hrtime(true) - $start;
+        if ($elapsed >= 20e6 || $calls >= (1 << 24)) {
+            break;
+        }
+        $calls *= 2;
+    }
+
+    $calls = max(1, (int) ($calls * ($time_per_case * 1e9) / max($elapsed, 1)));
+    $start = hrtime(true);
+    for ($i = 0; $i < $calls; $i++) {
+        $fn();
+    }
+    $elapsed = hrtime(true) - $start;
+
+    $alloc = null;
+    if (function_exists('memory_reset_peak_usage')) {
+        $base = memory_get_usage();
+        memory_reset_peak_usage();
+        $fn();
+        $alloc = memory_get_peak_usage() - $base;
+    }
+
+    return [$calls, $elapsed, $alloc];
+}
+
+// ----------------------------------------------------------------------------
+// Casos: nome => function(int $ms, int $channels): [callable, frames por chamada]
+// ----------------------------------------------------------------------------
+
+$cases = [
+    'encodePcmToPcma' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        return [fn() => encodePcmToPcma($pcm), $ms / 10];
+    },
+    'encodePcmToPcmu' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        return [fn() => encodePcmToPcmu($pcm), $ms / 10];
+    },
+    'decodePcmaToPcm' => function ($ms) {
+        $pcma = encodePcmToPcma(pcm_frame($ms * 8));
+        return [fn() => decodePcmaToPcm($pcma), $ms / 10];
+    },
+    'decodePcmuToPcm' => function ($ms) {
+        $pcmu = encodePcmToPcmu(pcm_frame($ms * 8));
+        return [fn() => decodePcmuToPcm($pcmu), $ms / 10];
+    },
+    'transcodePcmaToPcmu' => function ($ms) {
+        $pcma = encodePcmToPcma(pcm_frame($ms * 8));
+        return [fn() => transcodePcmaToPcmu($pcma), $ms / 10];
+    },
+    'transcodePcmuToPcma' => function ($ms) {
+        $pcmu = encodePcmToPcmu(pcm_frame($ms * 8));
+        return [fn() => transcodePcmuToPcma($pcmu), $ms / 10];
+    },
+    'encodePcmToL16' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        return [fn() => encodePcmToL16($pcm), $ms / 10];
+    },
+    'decodeL16ToPcm' => function ($ms) {
+        $l16 = encodePcmToL16(pcm_frame($ms * 8));
+        return [fn() => decodeL16ToPcm($l16), $ms / 10];
+    },
+    'pcmLeToBe' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        return [fn() => pcmLeToBe($pcm), $ms / 10];
+    },
+    'resampler 8k->16k' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        return [fn() => resampler($pcm, 8000, 16000), $ms / 10];
+    },
+    'resampler 16k->8k' => function ($ms) {
+        $pcm = pcm_frame($ms * 16);
+        return [fn() => resampler($pcm, 16000, 8000), $ms / 10];
+    },
+    'resampler 8k->48k' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        return [fn() => resampler($pcm, 8000, 48000), $ms / 10];
+    },
+    'resampler 48k->8k' => function ($ms) {
+        $pcm = pcm_frame($ms * 48);
+        return [fn() => resampler($pcm, 48000, 8000), $ms / 10];
+    },
+    'bcg729Resampler::process 8k->48k' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        $r = new bcg729Resampler(8000, 48000);
+        return [fn() => $r->process($pcm), $ms / 10];
+    },
+    'bcg729Channel::encode' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        $ch = new bcg729Channel();
+        return [fn() => $ch->encode($pcm), $ms / 10];
+    },
+    'bcg729Channel::decode' => function ($ms) {
+        $enc = new bcg729Channel();
+        $g729 = $enc->encode(pcm_frame($ms * 8));
+        $ch = new bcg729Channel();
+        return [fn() => $ch->decode($g729), $ms / 10];
+    },
+    'bcg729Channel::encodeInto' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        $ch = new bcg729Channel();
+        $out = '';
+        return [function () use ($ch, $pcm, &$out) { $ch->encodeInto($pcm, $out); }, $ms / 10];
+    },
+    'bcg729Channel::decodeInto' => function ($ms) {
+        $enc = new bcg729Channel();
+        $g729 = $enc->encode(pcm_frame($ms * 8));
+        $ch = new bcg729Channel();
+        $out = '';
+        return [function () use ($ch, $g729, &$out) { $ch->decodeInto($g729, $out); }, $ms / 10];
+    },
+    'bcg729Channel::decodeLost' => function ($ms) {
+        $ch = new bcg729Channel();
+        return [fn() => $ch->decodeLost($ms / 10), $ms / 10];
+    },
+    'bcg729Channel::encodeFromPcma' => function ($ms) {
+        $pcma = encodePcmToPcma(pcm_frame($ms * 8));
+        $ch = new bcg729Channel();
+        return [fn() => $ch->encodeFromPcma($pcma), $ms / 10];
+    },
+    'bcg729Channel::encodeFromPcmu' => function ($ms) {
+        $pcmu = encodePcmToPcmu(pcm_frame($ms * 8));
+        $ch = new bcg729Channel();
+        return [fn() => $ch->encodeFromPcmu($pcmu), $ms / 10];
+    },
+    'bcg729Channel::decodeToPcma' => function ($ms) {
+        $enc = new bcg729Channel();
+        $g729 = $enc->encode(pcm_frame($ms * 8));
+        $ch = new bcg729Channel();
+        return [fn() => $ch->decodeToPcma($g729), $ms / 10];
+    },
+    'bcg729Channel::decodeToPcmu' => function ($ms) {
+        $enc = new bcg729Channel();
+        $g729 = $enc->encode(pcm_frame($ms * 8));
+        $ch = new bcg729Channel();
+        return [fn() => $ch->decodeToPcmu($g729), $ms / 10];
+    },
+    'analyzePcm' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        return [fn() => analyzePcm($pcm), $ms / 10];
+    },
+    'bcg729Analyzer::process' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        $analyzer = new bcg729Analyzer();
+        return [fn() => $analyzer->process($pcm), $ms / 10];
+    },
+    'bcg729DtmfDetector::process' => function ($ms) {
+        $pcm = pcm_frame($ms * 8);
+        $detector = new bcg729DtmfDetector();
+        return [fn() => $detector->process($pcm), $ms / 10];
+    },
+    'bcg729DtmfDetector::decode g729' => function ($ms) {
+        $enc = new bcg729Channel();
+        $g729 = $enc->encode(pcm_frame($ms * 8));
+        $ch = new bcg729Channel();
+        $detector = new bcg729DtmfDetector();
+        return [fn() => $detector->decode($g729, 'g729', $ch), $ms / 10];
+    },
+    'bcg729DtmfDetector::decode pcmu' => function ($ms) {
+        $pcmu = encodePcmToPcmu(pcm_frame($ms * 8));
+        $detector = new bcg729DtmfDetector();
+        return [fn() => $detector->decode($pcmu, 'pcmu'), $ms / 10];
+    },
+    'bcg729Rtp::packetize+parse' => function ($ms) {
+        $enc = new bcg729Channel();
+        $g729 = $enc->encode(pcm_frame($ms * 8));
+        $rtp = new bcg729Rtp(18, $ms);
+        return [fn() => $rtp->parse($rtp->packetize($g729)[0]), $ms / 10];
+    },
+];
+
+// Stream filters: um fwrite() por pacote num php://memory esvaziado a cada chamada
+function filter_case($filter, $input, $frames, $params = null) {
+    $fp = fopen('php://memory', 'w+');
+    stream_filter_append($fp, $filter, STREAM_FILTER_WRITE, $params);
+    return [function () use ($fp, $input) {
+        fwrite($fp, $input);
+        ftruncate($fp, 0);
+        rewind($fp);
+    }, $frames];
+}
+
+$cases += [
+    'filter bcg729.encode' => fn($ms) => filter_case('bcg729.encode', pcm_frame($ms * 8), $ms / 10),
+    'filter bcg729.decode' => function ($ms) {
+        $enc = new bcg729Channel();
+        return filter_case('bcg729.decode', $enc->encode(pcm_frame($ms * 8)), $ms / 10);
+    },
+    'filter bcg729.resample 8k->16k' => fn($ms) => filter_case('bcg729.resample', pcm_frame($ms * 8), $ms / 10,
+        ['from' => 8000, 'to' => 16000]),
+    'filter g711.alaw.encode' => fn($ms) => filter_case('g711.alaw.encode', pcm_frame($ms * 8), $ms / 10),
+    'filter g711.ulaw.decode' => fn($ms) => filter_case('g711.ulaw.decode', encodePcmToPcmu(pcm_frame($ms * 8)), $ms / 10),
+];
+
+// Casos com vários canais por chamada
+$multi = [
+    'bcg729Channel::encodeBatch' => function ($ms, $n) {
+        $pcm = pcm_frame($ms * 8);
+        $channels = [];
+        $inputs = [];
+        for ($i = 0; $i < $n; $i++) {
+            $channels[$i] = new bcg729Channel(false, bcg729Channel::ENCODE_ONLY);
+            $inputs[$i] = $pcm;
+        }
+        return [fn() => bcg729Channel::encodeBatch($channels, $inputs), $n * $ms / 10];
+    },
+    'bcg729Channel::decodeBatch' => function ($ms, $n) {
+        $enc = new bcg729Channel();
+        $g729 = $enc->encode(pcm_frame($ms * 8));
+        $channels = [];
+        $inputs = [];
+        for ($i = 0; $i < $n; $i++) {
+            $channels[$i] = new bcg729Channel(false, bcg729Channel::DECODE_ONLY);
+            $inputs[$i] = $g729;
+        }
+        return [fn() => bcg729Channel::decodeBatch($channels, $inputs), $n * $ms / 10];
+    },
+    'mixAudioChannels' => function ($ms, $n) {
+        $inputs = array_fill(0, max($n, 2), pcm_frame($ms * 8));
+        return [fn() => mixAudioChannels($inputs, 8000), $ms / 10];
+    },
+    'mixEncoded pcma->pcma' => function ($ms, $n) {
+        $inputs = array_fill(0, max($n, 2), encodePcmToPcma(pcm_frame($ms * 8)));
+        return [fn() => mixEncoded($inputs, 'pcma', 'pcma'), $ms / 10];
+    },
+    'bcg729Mixer::mix' => function ($ms, $n) {
+        $inputs = array_fill(1, max($n, 2), pcm_frame($ms * 8));
+        $mixer = new bcg729Mixer($ms * 8);
+        return [fn() => $mixer->mix($inputs), $ms / 10];
+    },
+];
+
+// ----------------------------------------------------------------------------
+// Execução
+// ----------------------------------------------------------------------------
+
+$results = [];
+
+$run = function ($name, $ms, $channels, $setup) use (&$results, $time_per_case, $filter) {
+    if ($filter !== null && !preg_match('/' . $filter . '/i', $name)) {
+        return;
+    }
+
+    [$fn, $frames] = $setup($ms, $channels);
+    [$calls, $elapsed, $alloc] = measure($fn, $time_per_case);
+
+    $ns_per_call = $elapsed / $calls;
+    $results[] = [
+        'name' => $name,
+        'ptime_ms' => $ms,
+        'channels' => $channels,
+        'calls' => $calls,
+        'ns_per_call' => round($ns_per_call, 1),
+        'ns_per_frame' => round($ns_per_call / $frames, 1),
+        'frames_per_sec' => (int) round($frames * 1e9 / $ns_per_call),
+        'alloc_bytes_per_call' => $alloc,
+    ];
+};
+
+foreach ($cases as $name => $setup) {
+    foreach ($sizes as $ms) {
+        $run($name, $ms, 1, $setup);
+    }
+}
+
+foreach ($multi as $name => $setup) {
+    foreach ($channel_counts as $n) {
+        foreach ($sizes as $ms) {
+            $run($name, $ms, $n, $setup);
+        }
+    }
+}
+
+// RSS por canal ativo (encoder + decoder alocados)
+$rss = [];
+foreach ($channel_counts as $n) {
+    gc_collect_cycles();
+    $before = rss_bytes();
+    $pcm = pcm_frame(80);
+    $channels = [];
+    for ($i = 0; $i < $n; $i++) {
+        $ch = new bcg729Channel();
+        $ch->decode($ch->encode($pcm));
+        $channels[] = $ch;
+    }
+    $after = rss_bytes();
+    $rss[] = [
+        'channels' => $n,
+        'rss_bytes_per_channel' => ($before === null || $after === null) ? null : (int) (($after - $before) / $n),
+    ];
+    unset($channels, $ch);
+}
+
+emit([
+    'meta' => [
+        'php' => PHP_VERSION,
+        'extension' => phpversion('bcg729'),
+        'simd' => (bool) ini_get('bcg729.simd'),
+        'threads' => (int) ini_get('bcg729.threads'),
+        'os' => PHP_OS_FAMILY . ' ' . php_uname('m'),
+        'date' => date('c'),
+        'time_per_case' => $time_per_case,
+    ],
+    'results' => $results,
+    'rss' => $rss,
+], $opts);
+
+function emit($data, $opts) {
+    $json = json_encode($data, JSON_PRETTY_PRINT | JSON_UNESCAPED_SLASHES | JSON_UNESCAPED_UNICODE) . "\n";
+    if (isset($opts['output'])) {
+        file_put_contents($opts['output'], $json);
+    } else {
+        echo $json;
+    }
+}
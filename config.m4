@@ -1,7 +1,17 @@
 PHP_ARG_ENABLE(bcg729, whether to enable bcg729 support,
 [  --enable-bcg729           Enable bcg729 extension])
 
+PHP_ARG_ENABLE(bcg729-threads, whether to enable the bcg729 native thread pool,
+[  --disable-bcg729-threads  Disable the pthreads pool behind bcg729.threads], yes, no)
+
 if test "$PHP_BCG729" != "no"; then
   PHP_NEW_EXTENSION(bcg729, bcg729.c, $ext_shared)
   PHP_ADD_LIBRARY(bcg729, 1, bcg729)
-fi
\ No newline at end of file
+
+  if test "$PHP_BCG729_THREADS" != "no"; then
+    AC_CHECK_HEADER([pthread.h], [
+      AC_DEFINE(HAVE_BCG729_THREADS, 1, [Native thread pool for encodeBatch/decodeBatch])
+      PHP_ADD_LIBRARY(pthread, 1, bcg729)
+    ])
+  fi
+fi
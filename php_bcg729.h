@@ -7,4 +7,49 @@
 extern zend_module_entry bcg729_module_entry;
 #define phpext_bcg729_ptr &bcg729_module_entry
 
+struct _bcg729ResamplerFilter;
+struct _bcg729Channel;
+
+/* Tipos de contexto mantidos no pool */
+#define BCG729_POOL_DECODER     0
+#define BCG729_POOL_ENCODER     1
+#define BCG729_POOL_ENCODER_VAD 2
+#define BCG729_POOL_KINDS       3
+
+/* Contadores de um bcg729Channel (info()) e agregados do módulo (bcg729_stats()) */
+typedef struct {
+    uint64_t frames_encoded;
+    uint64_t frames_decoded;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t rejected;         /* entradas com tamanho inválido */
+    uint64_t erasures;         /* frames gerados por PLC/CNG sem payload */
+    uint64_t sid_encoded;
+    uint64_t sid_decoded;
+    uint64_t encoder_ns;       /* tempo dentro de bcg729Encoder */
+    uint64_t decoder_ns;       /* tempo dentro de bcg729Decoder */
+} bcg729ChannelStats;
+
+ZEND_BEGIN_MODULE_GLOBALS(bcg729)
+    struct _bcg729ResamplerFilter *resampler_filters; /* cache de tabelas polyphase por razão */
+    zend_long pool_size;                  /* bcg729.pool_size: contextos prontos por tipo */
+    zend_long threads;                    /* bcg729.threads: threads nos lotes (1 = sem pool) */
+    zend_bool simd;                       /* bcg729.simd: 0 força os kernels escalares (benchmarks) */
+    zend_long state_frames;               /* bcg729.state_frames: histórico por contexto para exportState() */
+    struct _bcg729Channel *live_channels; /* canais vivos, para bcg729_stats() */
+    uint64_t channels_created;
+    bcg729ChannelStats retired_stats;     /* contadores somados dos canais já destruídos */
+    void **pool[BCG729_POOL_KINDS];       /* contextos recém-inicializados, prontos para uso */
+    uint32_t pool_count[BCG729_POOL_KINDS];
+    uint32_t pool_cap[BCG729_POOL_KINDS];
+ZEND_END_MODULE_GLOBALS(bcg729)
+
+ZEND_EXTERN_MODULE_GLOBALS(bcg729)
+
+#define BCG729_G(v) ZEND_MODULE_GLOBALS_ACCESSOR(bcg729, v)
+
+#if defined(ZTS) && defined(COMPILE_DL_BCG729)
+ZEND_TSRMLS_CACHE_EXTERN()
+#endif
+
 #endif /* PHP_BCG729_H */
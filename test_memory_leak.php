@@ -100,6 +100,28 @@ function generateG729Data($frames = 1) {
     return $data;
 }
 
+/**
+ * Roda $code num PHP filho com outras diretivas PHP_INI_SYSTEM (como o
+ * --compare-simd do bench/run.php); o filho imprime um JSON com o resultado.
+ */
+function runChild(array $ini, $code, ...$args) {
+    $file = tempnam(sys_get_temp_dir(), 'bcg729_child_');
+    file_put_contents($file, "<?php\n" . $code);
+    $cmd = escapeshellarg(PHP_BINARY);
+    foreach ($ini as $name => $value) {
+        $cmd .= ' -d ' . escapeshellarg("$name=$value");
+    }
+    $cmd .= ' ' . escapeshellarg($file);
+    foreach ($args as $arg) {
+        $cmd .= ' ' . escapeshellarg((string) $arg);
+    }
+    $output = shell_exec($cmd . ' 2>&1');
+    unlink($file);
+
+    $result = json_decode(trim((string) $output), true);
+    return is_array($result) ? $result : ['error' => trim((string) $output)];
+}
+
 // Configurações do teste
 $iterations = 10000;  // Número de iterações
 $check_interval = 1000; // Intervalo para verificar memória
@@ -119,8 +141,15 @@ $memory_start = memory_get_usage(true);
 $memory_peak_start = memory_get_peak_usage(true);
 $memory_samples = [];
 
+$g711_errors = 0;
+
 try {
     $channel = new bcg729Channel();
+    // Canais paralelos: decodeToPcm*/encodeFromPcm* contra o caminho via PCM
+    $viaPcma = new bcg729Channel();
+    $viaPcmu = new bcg729Channel();
+    $refPcma = new bcg729Channel();
+    $refPcmu = new bcg729Channel();
 
     for ($i = 0; $i < $iterations; $i++) {
         // Gera dados PCM (160 bytes = 80 samples de 16-bit)
@@ -132,6 +161,18 @@ try {
         // Decode
         if ($encoded !== false) {
             $decoded = $channel->decode($encoded);
+
+            if ($viaPcma->decodeToPcma($encoded) !== encodePcmToPcma($decoded)
+                || $viaPcmu->decodeToPcmu($encoded) !== encodePcmToPcmu($decoded)) {
+                $g711_errors++;
+            }
+        }
+
+        $pcma = encodePcmToPcma($pcm);
+        $pcmu = encodePcmToPcmu($pcm);
+        if ($viaPcma->encodeFromPcma($pcma) !== $refPcma->encode(decodePcmaToPcm($pcma))
+            || $viaPcmu->encodeFromPcmu($pcmu) !== $refPcmu->encode(decodePcmuToPcm($pcmu))) {
+            $g711_errors++;
         }
 
         // Coleta amostra de memória
@@ -145,11 +186,11 @@ try {
         }
 
         // Força limpeza de variáveis
-        unset($pcm, $encoded, $decoded);
+        unset($pcm, $encoded, $decoded, $pcma, $pcmu);
     }
 
     $channel->close();
-    unset($channel);
+    unset($channel, $viaPcma, $viaPcmu, $refPcma, $refPcmu);
 
 } catch (Exception $e) {
     printError("Erro: " . $e->getMessage());
@@ -171,7 +212,9 @@ printInfo("  Diferença: " . formatBytes($memory_diff));
 printInfo("  Pico de memória: " . formatBytes($peak_diff));
 
 // Análise de vazamento
-if ($memory_diff > 1048576) { // > 1MB
+if ($g711_errors > 0) {
+    printWarning("decodeToPcm*/encodeFromPcm* diferem do caminho via PCM em $g711_errors frames");
+} elseif ($memory_diff > 1048576) { // > 1MB
     printWarning("POSSÍVEL VAZAMENTO! Crescimento de memória: " . formatBytes($memory_diff));
 } elseif ($memory_diff > 102400) { // > 100KB
     printWarning("Pequeno crescimento de memória detectado: " . formatBytes($memory_diff));
@@ -203,6 +246,8 @@ $tests = [
     'decodePcmuToPcm' => ['input' => generateULawData(160), 'name' => 'μ-law decode'],
     'encodePcmToPcma' => ['input' => generatePCMData(80), 'name' => 'A-law encode'],
     'encodePcmToPcmu' => ['input' => generatePCMData(80), 'name' => 'μ-law encode'],
+    'transcodePcmaToPcmu' => ['input' => generateALawData(160), 'name' => 'A-law -> μ-law'],
+    'transcodePcmuToPcma' => ['input' => generateULawData(160), 'name' => 'μ-law -> A-law'],
 ];
 
 foreach ($tests as $function => $test) {
@@ -380,6 +425,1113 @@ if ($memory_diff > 2097152) { // > 2MB
     printSuccess("OK (" . formatBytes($memory_diff) . ")");
 }
 
+// ============================================================================
+// TESTE 7: bcg729Resampler (streaming com estado)
+// ============================================================================
+printHeader("TESTE 7: bcg729Resampler 8k -> 16k -> 48k em pacotes de 20ms");
+
+printTest("Reamostrando " . number_format($iterations) . " pacotes");
+
+$memory_start = memory_get_usage(true);
+
+$up16 = new bcg729Resampler(8000, 16000);
+$up48 = new bcg729Resampler(16000, 48000);
+$down8 = new bcg729Resampler(48000, 8000);
+$packet = generatePCMData(160);
+$total_out = 0;
+
+for ($i = 0; $i < $iterations; $i++) {
+    $wide = $up48->process($up16->process($packet));
+    $narrow = $down8->process($wide);
+    $total_out += strlen($narrow);
+    unset($wide, $narrow);
+}
+
+$tail = $down8->flush();
+unset($up16, $up48, $down8, $tail);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+// Sem estado perdido entre pacotes, a saída tem o mesmo tamanho da entrada
+$expected = $iterations * strlen($packet);
+if (abs($total_out - $expected) > 4 * 1024) {
+    printWarning("Tamanho inesperado: " . number_format($total_out) . " bytes (esperado ~" . number_format($expected) . ")");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 8: G.729 Annex B (VAD/DTX/CNG)
+// ============================================================================
+printHeader("TESTE 8: bcg729Channel Annex B com silêncio intercalado");
+
+printTest("Codificando/decodificando " . number_format($iterations) . " frames");
+
+$memory_start = memory_get_usage(true);
+
+$channel = new bcg729Channel(true);
+$speech = generatePCMData(80);
+$silence = str_repeat("\0", 160);
+$sid_frames = 0;
+$pcm_out = 0;
+
+for ($i = 0; $i < $iterations; $i++) {
+    $g729 = $channel->encode(($i % 50) < 25 ? $speech : $silence);
+    if (strlen($g729) === 2) {
+        $sid_frames++;
+    }
+    // Frame não transmitido (DTX): o decoder continua o ruído de conforto
+    $pcm = $g729 === '' ? $channel->decodeLost() : $channel->decode($g729);
+    $pcm_out += strlen($pcm);
+    unset($g729, $pcm);
+}
+
+$channel->close();
+unset($channel);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($pcm_out !== $iterations * 160) {
+    printWarning("Tamanho inesperado: " . number_format($pcm_out) . " bytes");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . number_format($sid_frames) . " SID, " . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 9: Canais DECODE_ONLY / ENCODE_ONLY (alocação sob demanda)
+// ============================================================================
+printHeader("TESTE 9: Canais de um sentido só");
+
+printTest("Criando 1000 canais DECODE_ONLY e 1000 ENCODE_ONLY");
+
+$memory_start = memory_get_usage(true);
+
+$payload = (new bcg729Channel())->encode(generatePCMData(80));
+$pcm = generatePCMData(80);
+$channels = [];
+for ($i = 0; $i < 1000; $i++) {
+    $dec = new bcg729Channel(false, bcg729Channel::DECODE_ONLY);
+    $dec->decode($payload);
+    $enc = new bcg729Channel(false, bcg729Channel::ENCODE_ONLY);
+    $enc->encode($pcm);
+    $channels[] = $dec;
+    $channels[] = $enc;
+}
+
+$dec_info = $channels[0]->info();
+$enc_info = $channels[1]->info();
+unset($channels, $dec, $enc, $payload, $pcm);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($dec_info['encoder_initialized'] || $enc_info['decoder_initialized']) {
+    printWarning("Contexto alocado fora do modo do canal");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (decoder " . formatBytes($dec_info['decoder_bytes']) . ", encoder "
+        . formatBytes($enc_info['encoder_bytes']) . " por contexto)");
+}
+
+// ============================================================================
+// TESTE 10: reset() reaproveitando o canal entre chamadas
+// ============================================================================
+printHeader("TESTE 10: bcg729Channel::reset()");
+
+printTest("Reiniciando o mesmo canal " . number_format($iterations) . " vezes");
+
+$memory_start = memory_get_usage(true);
+
+$pcm = generatePCMData(160);
+$fresh = (new bcg729Channel())->encode($pcm);
+$channel = new bcg729Channel();
+$mismatch = 0;
+
+for ($i = 0; $i < $iterations; $i++) {
+    // Depois do reset o encoder deve se comportar como um canal novo
+    if ($channel->encode($pcm) !== $fresh) {
+        $mismatch++;
+    }
+    $channel->decode($fresh);
+    $channel->reset();
+}
+
+$channel->close();
+unset($channel, $pcm, $fresh);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($mismatch > 0) {
+    printWarning("Saída diferente de um canal novo em " . number_format($mismatch) . " iterações");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 11: push()/pull() com blocos de tamanho arbitrário
+// ============================================================================
+printHeader("TESTE 11: bcg729Channel::push()/pull()");
+
+printTest("Empurrando " . number_format($iterations) . " blocos de tamanho variável");
+
+$memory_start = memory_get_usage(true);
+
+$stream = new bcg729Channel();
+$reference = new bcg729Channel();
+$pcm = generatePCMData(80 * 64);
+$pushed = '';
+$pulled = '';
+
+for ($i = 0; $i < $iterations; $i++) {
+    // Tamanhos pares que nunca fecham um frame exato (ex.: saída do resampler)
+    $chunk = substr($pcm, 0, 2 * (1 + ($i * 37) % 300));
+    $pushed .= $chunk;
+    $stream->push($chunk);
+    $pulled .= $stream->pull(2);
+}
+while (($packet = $stream->pull(2)) !== '') {
+    $pulled .= $packet;
+}
+
+$complete = strlen($pushed) - (strlen($pushed) % 160);
+$expected = $reference->encode(substr($pushed, 0, $complete));
+$leftover = $stream->info()['buffered_pcm_bytes'];
+
+// Annex B: voz dos dois lados de uma lacuna de DTX nunca vai no mesmo payload
+$dtx = new bcg729Channel(true);
+$dtxReference = new bcg729Channel(true);
+$audio = generatePCMData(80 * 10) . str_repeat("\0", 160 * 30) . generatePCMData(80 * 10);
+$dtx->push($audio);
+$dtxPulled = [];
+while ($dtx->info()['pending_frames'] > 0) {
+    $dtxPulled[] = $dtx->pull(1000);
+}
+$dtxExpected = [];
+$acc = '';
+foreach (str_split($audio, 160) as $frame) {
+    $g729 = $dtxReference->encode($frame);
+    if ($g729 === '') {
+        if ($acc !== '') {
+            $dtxExpected[] = $acc;
+        }
+        $dtxExpected[] = $acc = '';
+        continue;
+    }
+    $acc .= $g729;
+    if (strlen($g729) === 2) {
+        $dtxExpected[] = $acc;
+        $acc = '';
+    }
+}
+if ($acc !== '') {
+    $dtxExpected[] = $acc;
+}
+$dtxOk = $dtxPulled === $dtxExpected && in_array('', $dtxPulled, true);
+
+unset($stream, $reference, $pcm, $pushed, $chunk, $packet, $dtx, $dtxReference, $audio, $frame, $g729, $acc);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($pulled !== $expected) {
+    printWarning("Saída de push()/pull() difere de encode() sobre o mesmo áudio");
+} elseif (!$dtxOk) {
+    printWarning("pull() juntou voz dos dois lados de uma lacuna de DTX");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . number_format(strlen($pulled)) . " bytes, sobra de $leftover bytes)");
+}
+unset($pulled, $expected, $dtxPulled, $dtxExpected);
+
+// ============================================================================
+// TESTE 12: decodeInto()/encodeInto() com buffer reutilizado
+// ============================================================================
+printHeader("TESTE 12: decodeInto()/encodeInto()");
+
+printTest("Reutilizando o mesmo buffer em " . number_format($iterations) . " pacotes");
+
+$memory_start = memory_get_usage(true);
+
+$enc_a = new bcg729Channel();
+$enc_b = new bcg729Channel();
+$dec_a = new bcg729Channel();
+$dec_b = new bcg729Channel();
+$pcm = generatePCMData(160);
+$g729_buf = '';
+$pcm_buf = '';
+$mismatch = 0;
+
+for ($i = 0; $i < $iterations; $i++) {
+    $g729 = $enc_a->encode($pcm);
+    $enc_b->encodeInto($pcm, $g729_buf);
+    $decoded = $dec_a->decode($g729);
+    $dec_b->decodeInto($g729_buf, $pcm_buf);
+    if ($g729 !== $g729_buf || $decoded !== $pcm_buf) {
+        $mismatch++;
+    }
+    unset($g729, $decoded);
+}
+
+// Escrita com offset: o segundo pacote vai logo após o primeiro
+$written = $dec_b->decodeInto($g729_buf, $pcm_buf, strlen($pcm_buf));
+
+unset($enc_a, $enc_b, $dec_a, $dec_b, $pcm);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($mismatch > 0 || strlen($pcm_buf) !== 2 * $written) {
+    printWarning("Saída *Into() difere de encode()/decode() em " . number_format($mismatch) . " pacotes");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+unset($g729_buf, $pcm_buf);
+
+// ============================================================================
+// TESTE 13: encodeBatch()/decodeBatch()
+// ============================================================================
+printHeader("TESTE 13: encodeBatch()/decodeBatch() com 50 canais");
+
+printTest("Processando " . number_format($iterations / 10) . " ticks de 20ms");
+
+$memory_start = memory_get_usage(true);
+
+$encoders = [];
+$decoders = [];
+$inputs = [];
+for ($c = 0; $c < 50; $c++) {
+    $encoders["leg$c"] = new bcg729Channel(false, bcg729Channel::ENCODE_ONLY);
+    $decoders["leg$c"] = new bcg729Channel(false, bcg729Channel::DECODE_ONLY);
+    $inputs["leg$c"] = generatePCMData(160);
+}
+$mismatch = 0;
+
+for ($i = 0; $i < $iterations / 10; $i++) {
+    $g729 = bcg729Channel::encodeBatch($encoders, $inputs);
+    $packed = bcg729Channel::decodeBatch($decoders, $g729, true);
+    foreach ($packed['lengths'] as $leg => $len) {
+        if ($len !== 320 || strlen($g729[$leg]) !== 20) {
+            $mismatch++;
+        }
+    }
+    unset($g729, $packed);
+}
+
+unset($encoders, $decoders, $inputs);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($mismatch > 0) {
+    printWarning("Tamanhos inesperados em " . number_format($mismatch) . " saídas");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+printTest("Pool de threads nativas (bcg729.threads = 4) contra o caminho serial");
+
+// Mesmo lote em dois PHP filhos; bcg729.threads é PHP_INI_SYSTEM
+$batchCode = <<<'PHP'
+$encoders = [];
+$decoders = [];
+$inputs = [];
+for ($c = 0; $c < 20; $c++) {
+    $encoders["leg$c"] = new bcg729Channel($c % 2 === 1);
+    $decoders["leg$c"] = new bcg729Channel();
+    $pcm = '';
+    for ($i = 0; $i < 400; $i++) {
+        $pcm .= pack('s', (int) (sin($i * (0.03 + $c * 0.01)) * (2000 + $c * 500)));
+    }
+    $inputs["leg$c"] = $pcm;
+}
+// o mesmo canal duas vezes no lote: tem que rodar em ordem, como no serial
+$shared = new bcg729Channel();
+$encoders['dup1'] = $shared;
+$encoders['dup2'] = $shared;
+$inputs['dup1'] = $inputs['leg0'];
+$inputs['dup2'] = $inputs['leg1'];
+$decoders['dup1'] = new bcg729Channel();
+
+$hash = hash_init('sha256');
+for ($tick = 0; $tick < 50; $tick++) {
+    $g729 = bcg729Channel::encodeBatch($encoders, $inputs);
+    $pcm = bcg729Channel::decodeBatch($decoders, $g729);
+    $packed = bcg729Channel::decodeBatch($decoders, $g729, true);
+    hash_update($hash, serialize([$g729, $pcm, $packed]));
+}
+echo json_encode(['hash' => hash_final($hash), 'threads' => bcg729_stats()['threads']]);
+PHP;
+
+$serial = runChild(['bcg729.threads' => 1], $batchCode);
+$threaded = runChild(['bcg729.threads' => 4], $batchCode);
+
+if (isset($serial['error']) || isset($threaded['error'])) {
+    printWarning("PHP filho falhou: " . ($serial['error'] ?? $threaded['error']));
+} elseif ($serial['hash'] !== $threaded['hash']) {
+    printWarning("Saída com threads difere do caminho serial");
+} elseif ($threaded['threads'] !== 4) {
+    printInfo("Pool não iniciado (compilado sem pthreads?): threads = {$threaded['threads']}");
+} else {
+    printSuccess("OK (4 threads, saída idêntica ao serial)");
+}
+
+// ============================================================================
+// TESTE 14: bcg729_transcode_file() em blocos
+// ============================================================================
+printHeader("TESTE 14: bcg729_transcode_file() PCM -> G.729 -> WAV");
+
+printTest("Transcodificando 60s de áudio em blocos de 1s");
+
+$memory_start = memory_get_usage(true);
+
+$tmp = sys_get_temp_dir() . '/bcg729_test_' . getmypid();
+file_put_contents("$tmp.pcm", str_repeat(generatePCMData(80), 6000));
+
+$to_g729 = bcg729_transcode_file("$tmp.pcm", "$tmp.g729", 'pcm', 'g729', ['chunk_frames' => 100]);
+$to_wav = bcg729_transcode_file("$tmp.g729", "$tmp.wav", 'g729', 'wav', ['chunk_frames' => 100]);
+$to_pcmu = bcg729_transcode_file("$tmp.wav", "$tmp.ulaw", 'wav', 'pcmu', ['threads' => true]);
+
+$sizes = [filesize("$tmp.g729"), filesize("$tmp.wav"), filesize("$tmp.ulaw")];
+foreach (['pcm', 'g729', 'wav', 'ulaw'] as $ext) {
+    @unlink("$tmp.$ext");
+}
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if (!$to_g729 || !$to_wav || !$to_pcmu || $sizes !== [60000, 44 + 960000, 480000]) {
+    printWarning("Tamanhos inesperados: " . implode(', ', $sizes));
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess(sprintf("OK (encode %.0fx tempo real, %s)", $to_g729['speed'], formatBytes($memory_diff)));
+}
+
+// ============================================================================
+// TESTE 15: bcg729WavWriter / bcg729WavReader
+// ============================================================================
+printHeader("TESTE 15: bcg729WavWriter / bcg729WavReader");
+
+printTest("Gravando e relendo $iterations frames em WAV μ-law");
+
+$memory_start = memory_get_usage(true);
+
+$tmp = sys_get_temp_dir() . '/bcg729_wav_' . getmypid() . '.wav';
+$frame = encodePcmToPcmu(generatePCMData(80));
+
+// Aberto por stream wrapper: grava via file://, relê pelo caminho simples
+$writer = new bcg729WavWriter('file://' . $tmp, 'pcmu');
+for ($i = 0; $i < $iterations; $i++) {
+    $writer->write($frame);
+}
+$writer->close();
+
+$reader = new bcg729WavReader($tmp, 80);
+$frames = 0;
+$matches = 0;
+while (($pcm = $reader->readFrame(true)) !== false) {
+    $frames++;
+    $matches += ($pcm === decodePcmuToPcm($frame));
+}
+$reader->close();
+unset($writer, $reader);
+@unlink($tmp);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($frames !== $iterations || $matches !== $iterations) {
+    printWarning("Frames lidos: $frames, iguais: $matches");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 16: bcg729Rtp
+// ============================================================================
+printHeader("TESTE 16: bcg729Rtp packetize/decode");
+
+printTest("Empacotando e decodificando $iterations pacotes de 20ms");
+
+$memory_start = memory_get_usage(true);
+
+$tx = new bcg729Rtp(18, 20, 1234, 0, 0);
+$rx = new bcg729Rtp(18);
+$encoder = new bcg729Channel();
+$decoder = new bcg729Channel();
+$payload = $encoder->encode(generatePCMData(160));
+$errors = 0;
+
+for ($i = 0; $i < $iterations; $i++) {
+    $packets = $tx->packetize($payload, $i === 0);
+    $header = $rx->parse($packets[0]);
+    $pcm = $rx->decode($packets[0], $decoder);
+    if (count($packets) !== 1 || $header['sequence'] !== ($i & 0xffff) || strlen($pcm) !== 320) {
+        $errors++;
+    }
+}
+
+// Objeto sem __construct (subclasse que não chama o pai) precisa lançar Error
+$bare = (new ReflectionClass('bcg729Rtp'))->newInstanceWithoutConstructor();
+try {
+    $bare->packetize($payload);
+    $errors++;
+} catch (Error $e) {
+}
+
+$info = $rx->info();
+$encoder->close();
+$decoder->close();
+unset($tx, $rx, $encoder, $decoder, $packets, $header, $pcm, $bare);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($errors > 0 || $info['packets_received'] !== $iterations * 2) {
+    printWarning("Erros: $errors");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 17: bcg729JitterBuffer
+// ============================================================================
+printHeader("TESTE 17: bcg729JitterBuffer com reordenação e perda");
+
+printTest("Entregando $iterations pacotes fora de ordem (1% perdidos)");
+
+$memory_start = memory_get_usage(true);
+
+$rtp = new bcg729Rtp(18, 20, 42, 0, 0);
+$jb = new bcg729JitterBuffer(18, 20, 40, 200);
+$encoder = new bcg729Channel();
+$decoder = new bcg729Channel();
+$payload = $encoder->encode(generatePCMData(160));
+$pending = [];
+$ticks = 0;
+
+for ($i = 0; $i < $iterations; $i++) {
+    $packet = $rtp->packetize($payload)[0];
+    if ($i % 100 === 50) {
+        continue; // perdido
+    }
+    $pending[] = $packet;
+    if (count($pending) === 2) {
+        // troca a ordem de cada par
+        $jb->put($pending[1], $i * 0.02);
+        $jb->put($pending[0], $i * 0.02);
+        $pending = [];
+    }
+    if ($jb->pop($decoder) !== false) {
+        $ticks++;
+    }
+}
+
+$info = $jb->info();
+
+// Volta do sequence 65535 -> 0 com capacidade que não divide 65536
+$wrapRtp = new bcg729Rtp(0, 20, 7, 65500, 0);
+$wrapJb = new bcg729JitterBuffer(0, 20, 40, 200, 100);
+for ($i = 0; $i < 60; $i++) {
+    $wrapJb->put($wrapRtp->packetize(str_repeat("\xff", 160))[0], $i * 0.02);
+}
+$wrapInfo = $wrapJb->info();
+$wrapOk = $wrapInfo['buffered'] === 60 && $wrapInfo['discarded'] === 0;
+for ($i = 0; $i < 60; $i++) {
+    $wrapJb->pop();
+}
+$wrapInfo = $wrapJb->info();
+$wrapOk = $wrapOk && $wrapInfo['lost'] === 0;
+
+// Peer com ptime diferente do configurado (20 ms): 10 e 30 ms tocam o stream inteiro, sem perda nem descarte
+$ulaw = '';
+for ($i = 0; $i < 2400; $i++) {
+    $ulaw .= chr(($i * 7) % 256);
+}
+$expected = decodePcmuToPcm($ulaw);
+$ptimeOk = true;
+foreach ([10, 30] as $peerPtime) {
+    $packets = (new bcg729Rtp(0, $peerPtime, 9, 0, 0))->packetize($ulaw);
+    $ptimeJb = new bcg729JitterBuffer(0, 20, 40, 200);
+    $played = '';
+    for ($ms = 0, $k = 0; $ms <= 2400 / 8 + 200; $ms += 10) {
+        if ($k < count($packets) && $k * $peerPtime === $ms) {
+            $ptimeJb->put($packets[$k++], $ms / 1000);
+        }
+        if ($ms % 20 === 0 && ($tick = $ptimeJb->pop()) !== false) {
+            $ptimeOk = $ptimeOk && strlen($tick) === 320;
+            $played .= $tick;
+        }
+    }
+    $ptimeInfo = $ptimeJb->info();
+    $ptimeOk = $ptimeOk && strpos($played, $expected) === 0
+        && $ptimeInfo['discarded'] === 0 && $ptimeInfo['lost'] === 0;
+}
+
+$encoder->close();
+$decoder->close();
+unset($rtp, $jb, $encoder, $decoder, $pending, $packet, $wrapRtp, $wrapJb, $packets, $ptimeJb, $played);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($ticks < $iterations - 10 || $info['lost'] < 1) {
+    printWarning("Ticks: $ticks, perdidos: {$info['lost']}");
+} elseif (!$wrapOk) {
+    printWarning("Volta do sequence: " . json_encode($wrapInfo));
+} elseif (!$ptimeOk) {
+    printWarning("ptime do peer diferente do configurado: " . json_encode($ptimeInfo));
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess(sprintf("OK (perdidos %d, atrasados %d, %s)", $info['lost'], $info['late'], formatBytes($memory_diff)));
+}
+
+// ============================================================================
+// TESTE 18: bcg729Mixer (mix-minus)
+// ============================================================================
+printHeader("TESTE 18: bcg729Mixer com 10 participantes");
+
+printTest("Executando $iterations ticks de mix-minus");
+
+$memory_start = memory_get_usage(true);
+
+$mixer = new bcg729Mixer(160);
+$inputs = [];
+for ($p = 1; $p <= 10; $p++) {
+    $inputs[$p] = generatePCMData(160);
+}
+$mixer->join(99); // só ouve
+
+$errors = 0;
+for ($i = 0; $i < $iterations; $i++) {
+    $result = $mixer->mix($inputs);
+    if (strlen($result['mix']) !== 320 || count($result['outputs']) !== 11 || $result['outputs'][99] !== $result['mix']) {
+        $errors++;
+    }
+}
+
+$info = $mixer->info();
+
+// entrada inválida no meio do array: nenhum id novo pode ter entrado
+try {
+    $mixer->mix([500 => generatePCMData(160), 501 => 42]);
+    $errors++;
+} catch (ValueError $e) {
+    if ($mixer->info()['participants'] !== 11) {
+        $errors++;
+    }
+}
+
+// entradas por referência (foreach com &) valem como strings
+$refInputs = $inputs;
+foreach ($refInputs as &$ref) {
+}
+unset($ref);
+$refMixer = new bcg729Mixer(160);
+$plainMixer = new bcg729Mixer(160);
+if ($refMixer->mix($refInputs) !== $plainMixer->mix($inputs)) {
+    $errors++;
+}
+
+unset($mixer, $inputs, $result, $refInputs, $refMixer, $plainMixer);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($errors > 0 || $info['participants'] !== 11) {
+    printWarning("Erros: $errors");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 19: mixEncoded()
+// ============================================================================
+printHeader("TESTE 19: mixEncoded() A-law -> μ-law");
+
+printTest("Mixando 4 entradas A-law $iterations vezes");
+
+$memory_start = memory_get_usage(true);
+
+$inputs = [];
+for ($p = 0; $p < 4; $p++) {
+    $inputs["p$p"] = encodePcmToPcma(generatePCMData(160));
+}
+$gains = ['p0' => 0.5, 'p1' => 0.5, 'p2' => 0.5, 'p3' => 0.5];
+
+$errors = 0;
+for ($i = 0; $i < $iterations; $i++) {
+    if (strlen(mixEncoded($inputs, 'pcma', 'pcmu', $gains)) !== 160) {
+        $errors++;
+    }
+}
+
+// ganho 1.0 com uma entrada só deve reproduzir a expansão
+$single = mixEncoded(['a' => $inputs['p0']], 'pcma', 'pcm');
+if ($single !== decodePcmaToPcm($inputs['p0'])) {
+    $errors++;
+}
+
+// ganho logo abaixo de 8.0 não pode inverter o sinal (Q12 satura em 32767)
+$loud = mixEncoded(['a' => encodePcmToPcma(pack('v*', ...array_fill(0, 160, 1000)))], 'pcma', 'pcm', ['a' => 7.9999]);
+if (unpack('v', $loud)[1] >= 32768 || unpack('v', $loud)[1] < 7000) {
+    $errors++;
+}
+
+// entradas e ganhos por referência (foreach com &) valem como os valores
+$refInputs = $inputs;
+$refGains = $gains;
+foreach ($refInputs as &$ref) {
+}
+foreach ($refGains as &$ref) {
+}
+unset($ref);
+if (mixEncoded($refInputs, 'pcma', 'pcmu', $refGains) !== mixEncoded($inputs, 'pcma', 'pcmu', $gains)) {
+    $errors++;
+}
+
+unset($inputs, $gains, $single, $loud, $refInputs, $refGains);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($errors > 0) {
+    printWarning("Erros: $errors");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 20: contadores (info() / bcg729_stats())
+// ============================================================================
+printHeader("TESTE 20: contadores por canal e bcg729_stats()");
+
+printTest("Conferindo contadores após $iterations encode/decode");
+
+$memory_start = memory_get_usage(true);
+
+$before = bcg729_stats();
+$channel = new bcg729Channel();
+$pcm = generatePCMData(160);
+
+for ($i = 0; $i < $iterations; $i++) {
+    $channel->decode($channel->encode($pcm));
+}
+$channel->decode('123'); // rejeitado
+$channel->decodeLost(1);
+
+$info = $channel->info();
+$during = bcg729_stats();
+unset($channel);
+$after = bcg729_stats();
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+$ok = $info['frames_encoded'] === $iterations * 2
+    && $info['frames_decoded'] === $iterations * 2
+    && $info['rejected'] === 1
+    && $info['erasures'] === 1
+    && $info['encoder_ns'] > 0
+    && $during['live_channels'] === $before['live_channels'] + 1
+    && $after['live_channels'] === $before['live_channels']
+    && $after['frames_encoded'] - $before['frames_encoded'] === $iterations * 2
+    // pool desligado (bcg729.threads = 1) ou ainda não iniciado: só a thread do PHP
+    && (ini_get('bcg729.threads') > 1 || $after['threads'] === 1);
+
+if (!$ok) {
+    printWarning("Contadores inesperados: " . json_encode($info));
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess(sprintf("OK (encoder %.0f ns/frame, %s)", $after['encoder_ns_per_frame'], formatBytes($memory_diff)));
+}
+
+// ============================================================================
+// TESTE 21: analyzePcm() / bcg729Analyzer
+// ============================================================================
+printHeader("TESTE 21: analyzePcm() e bcg729Analyzer");
+
+printTest("Analisando $iterations frames (silêncio + tom) em pedaços de tamanho irregular");
+
+$memory_start = memory_get_usage(true);
+
+$signal = str_repeat("\x00\x00", 800) . generatePCMData(800);
+$whole = analyzePcm($signal, 80);
+
+$analyzer = new bcg729Analyzer(80);
+$frames = 0;
+for ($i = 0; $frames < $iterations; $i++) {
+    $result = $analyzer->process(substr($signal, ($i * 74) % 3000, 37 + ($i % 300)));
+    $frames += count($result['rms']);
+}
+$info = $analyzer->info();
+unset($analyzer, $result);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+$ok = count($whole['rms']) === 20
+    && $whole['speech'][0] === false
+    && $whole['speech'][15] === true
+    && $whole['peak'][0] === 0
+    && $info['frames'] >= $iterations;
+
+if (!$ok) {
+    printWarning("Resultado inesperado: " . json_encode($whole['speech']));
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK ({$info['speech_frames']} frames de voz, " . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 22: bcg729DtmfDetector
+// ============================================================================
+printHeader("TESTE 22: bcg729DtmfDetector");
+
+printTest("Detectando dígitos em $iterations frames de 10 ms");
+
+$memory_start = memory_get_usage(true);
+
+// "5" (770 + 1336 Hz) por 80 ms seguido de 60 ms de silêncio
+$dtmf = '';
+for ($i = 0; $i < 640; $i++) {
+    $dtmf .= pack('s', (int)(6000 * sin(2 * M_PI * 770 * $i / 8000) + 5000 * sin(2 * M_PI * 1336 * $i / 8000)));
+}
+$dtmf .= str_repeat("\x00\x00", 480);
+$frames = str_split($dtmf, 160);
+
+$detector = new bcg729DtmfDetector();
+$digits = '';
+for ($i = 0; $i < $iterations; $i++) {
+    foreach ($detector->process($frames[$i % count($frames)]) as $event) {
+        if ($event['event'] === 'start') {
+            $digits .= $event['digit'];
+        }
+    }
+}
+
+$detector->reset();
+$alaw = $detector->decode(encodePcmToPcma($dtmf), 'pcma');
+$fused = $detector->events();
+$info = $detector->info();
+unset($detector, $frames);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+$ok = strlen($digits) >= intdiv($iterations, 14) && trim($digits, '5') === ''
+    && strlen($alaw) === strlen($dtmf)
+    && count($fused) === 2 && $fused[0]['digit'] === '5';
+
+if (!$ok) {
+    printWarning("Detecção inesperada: " . strlen($digits) . " dígitos, " . json_encode($fused));
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK ({$info['digits']} dígitos, " . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 23: exportState() / importState()
+// ============================================================================
+printHeader("TESTE 23: exportState() / importState() e serialize()");
+
+printTest("Histórico desligado por padrão (bcg729.state_frames = 0)");
+
+$channel = new bcg729Channel();
+$channel->decode($channel->encode(generatePCMData(80)));
+$info = $channel->info();
+$exported = @$channel->exportState();
+unset($channel);
+
+if ((int) ini_get('bcg729.state_frames') !== 0) {
+    printInfo("bcg729.state_frames = " . ini_get('bcg729.state_frames') . " no php.ini; pulando");
+} elseif ($exported !== false || $info['state_frames'] !== 0) {
+    printWarning("Estado gravado com o histórico desligado: " . json_encode($info));
+} else {
+    printSuccess("OK (exportState() recusado, encoder " . formatBytes($info['encoder_bytes']) . ")");
+}
+
+printTest("Migrando um canal a cada 100 frames ($iterations frames, bcg729.state_frames = 32)");
+
+$result = runChild(['bcg729.state_frames' => 32], <<<'PHP'
+$iterations = (int) $argv[1];
+$pcm = '';
+for ($i = 0; $i < 80; $i++) {
+    $pcm .= pack('s', (int) (sin($i * 0.1) * 16000));
+}
+$memory_start = memory_get_usage(true);
+
+// Dentro da janela (< bcg729.state_frames) a cópia tem que ser idêntica
+$reference = new bcg729Channel();
+for ($i = 0; $i < 10; $i++) {
+    $reference->decode($reference->encode($pcm));
+}
+$ringBytes = $reference->info()['encoder_bytes'];
+$copy = unserialize(serialize($reference));
+$same = true;
+for ($i = 0; $i < 10; $i++) {
+    $same = $same && $copy->decode($copy->encode($pcm)) === $reference->decode($reference->encode($pcm));
+}
+unset($reference, $copy);
+
+$channel = new bcg729Channel();
+for ($i = 0; $i < $iterations; $i++) {
+    if ($i % 100 === 99) {
+        $moved = new bcg729Channel();
+        $moved->importState($channel->exportState());
+        $channel = $moved;
+    }
+    $channel->decode($channel->encode($pcm));
+}
+$info = $channel->info();
+unset($channel, $moved);
+
+// Migração no meio do DTX: o SID já saiu da janela, mas vai fixo no estado
+mt_srand(729);
+$noise = '';
+for ($i = 0; $i < 80; $i++) {
+    $noise .= pack('s', mt_rand(-300, 300));
+}
+$dtx = new bcg729Channel(true);
+$sid = null;
+for ($i = 0; $i < 20; $i++) {
+    $dtx->decode($dtx->encode($pcm));
+}
+for ($i = 0; $i < 200 && $sid === null; $i++) {
+    $g729 = $dtx->encode($noise);
+    if (strlen($g729) === 2) {
+        $sid = $g729;
+    }
+    $g729 === '' ? $dtx->decodeLost() : $dtx->decode($g729);
+}
+$dtx->decodeLost(100); // 1 s de CNG: bem mais que os 320 ms da janela
+$state = $dtx->exportState();
+$pinned = $sid !== null && (ord($state[5]) & 0x40) !== 0;
+$dtxMoved = new bcg729Channel(true);
+$dtxMoved->importState($state);
+$rms = function ($pcm16) {
+    $samples = unpack('s*', $pcm16);
+    return sqrt(array_sum(array_map(fn($v) => $v * $v, $samples)) / count($samples));
+};
+$dtxRms = $rms($dtx->decodeLost(10));
+$dtxMovedRms = $rms($dtxMoved->decodeLost(10));
+unset($dtx, $dtxMoved, $noise, $sid, $g729, $state);
+
+gc_collect_cycles();
+
+echo json_encode([
+    'same' => $same,
+    'pinned' => $pinned,
+    'dtx_rms' => $dtxRms,
+    'moved_rms' => $dtxMovedRms,
+    'ring_bytes' => $ringBytes,
+    'info' => $info,
+    'memory_diff' => memory_get_usage(true) - $memory_start,
+]);
+PHP, $iterations);
+
+if (isset($result['error'])) {
+    printWarning("PHP filho falhou: " . $result['error']);
+} else {
+    $dtxRms = $result['dtx_rms'];
+    $dtxMovedRms = $result['moved_rms'];
+    $dtxOk = $result['pinned'] && ($dtxRms == 0 || ($dtxMovedRms > $dtxRms / 4 && $dtxMovedRms < $dtxRms * 4));
+    $info = $result['info'];
+
+    if (!$result['same']) {
+        printWarning("Saída diferente após migração dentro da janela exata");
+    } elseif (!$dtxOk) {
+        printWarning("CNG após migração no meio do DTX: " . ($result['pinned'] ? round($dtxMovedRms) . " vs " . round($dtxRms) . " RMS" : "SID não fixado"));
+    } elseif ($info['state_exact'] || $info['state_frames'] === 0) {
+        printWarning("Estado inesperado: " . json_encode($info));
+    } elseif ($result['ring_bytes'] < 32 * 160) {
+        printWarning("encoder_bytes não conta o anel: " . $result['ring_bytes']);
+    } elseif ($result['memory_diff'] > 102400) {
+        printWarning("Crescimento: " . formatBytes($result['memory_diff']));
+    } else {
+        printSuccess("OK ({$info['state_frames']} frames guardados, " . formatBytes($result['memory_diff']) . ")");
+    }
+}
+
+// ============================================================================
+// TESTE 24: stream filters
+// ============================================================================
+printHeader("TESTE 24: stream filters (bcg729.*, g711.*)");
+
+printTest("Transcodificando $iterations frames por stream_copy_to_stream()");
+
+$memory_start = memory_get_usage(true);
+
+$pcm = generatePCMData(80 * 50);
+$ok = true;
+
+for ($i = 0; $i < $iterations / 50; $i++) {
+    // PCM -> A-law na escrita, em pedaços que não fecham amostras
+    $alaw = fopen('php://temp', 'w+b');
+    stream_filter_append($alaw, 'g711.alaw.encode', STREAM_FILTER_WRITE);
+    foreach (str_split($pcm, 333) as $piece) {
+        fwrite($alaw, $piece);
+    }
+    rewind($alaw);
+
+    // A-law -> PCM -> G.729 -> PCM na leitura
+    stream_filter_append($alaw, 'g711.alaw.decode', STREAM_FILTER_READ);
+    stream_filter_append($alaw, 'bcg729.encode', STREAM_FILTER_READ);
+    stream_filter_append($alaw, 'bcg729.decode', STREAM_FILTER_READ);
+    stream_filter_append($alaw, 'bcg729.resample', STREAM_FILTER_READ, ['from' => 8000, 'to' => 16000]);
+
+    $sink = fopen('php://memory', 'w+b');
+    $copied = stream_copy_to_stream($alaw, $sink);
+    fclose($alaw);
+    fclose($sink);
+
+    if ($i === 0 && ($copied < strlen($pcm) * 2 - 64 || $copied > strlen($pcm) * 2 + 256)) {
+        $ok = false;
+    }
+}
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if (!$ok) {
+    printWarning("Tamanho inesperado: $copied bytes");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess("OK (" . formatBytes($memory_diff) . ")");
+}
+
+// ============================================================================
+// TESTE 25: decodeLost() (ocultação de perda)
+// ============================================================================
+printHeader("TESTE 25: bcg729Channel::decodeLost()");
+
+printTest("Alternando rajadas de perda e frames reais ($iterations frames)");
+
+$memory_start = memory_get_usage(true);
+
+$encoder = new bcg729Channel(false, bcg729Channel::ENCODE_ONLY);
+$decoder = new bcg729Channel(false, bcg729Channel::DECODE_ONLY);
+$frames = [];
+for ($i = 0; $i < 50; $i++) {
+    $frames[] = $encoder->encode(substr(str_repeat(generatePCMData(80), 2), $i % 80 * 2, 160));
+}
+$errors = 0;
+
+for ($i = 0; $i < $iterations; $i++) {
+    if ($i % 10 === 5) {
+        // rajada de 1 a 5 frames perdidos
+        $burst = 1 + ($i / 10) % 5;
+        if (strlen($decoder->decodeLost($burst)) !== $burst * 160) {
+            $errors++;
+        }
+        continue;
+    }
+    $pcm = $decoder->decode($frames[$i % 50]);
+    if (strlen($pcm) !== 160) {
+        $errors++;
+    }
+}
+
+// depois de uma rajada longa, o decoder volta a tocar os frames reais
+$decoder->decodeLost(100);
+$recovered = '';
+for ($i = 0; $i < 20; $i++) {
+    $recovered .= $decoder->decode($frames[$i]);
+}
+$samples = unpack('s*', substr($recovered, 160 * 10));
+if (max($samples) - min($samples) < 1000) {
+    $errors++;
+}
+
+// limites do argumento: 1..1000
+$bounds = 0;
+foreach ([0, -1, 1001] as $bad) {
+    try {
+        $decoder->decodeLost($bad);
+    } catch (ValueError $e) {
+        $bounds++;
+    }
+}
+if ($bounds !== 3 || strlen($decoder->decodeLost()) !== 160 || strlen($decoder->decodeLost(1000)) !== 160000) {
+    $errors++;
+}
+
+$info = $decoder->info();
+unset($encoder, $decoder, $frames, $pcm, $recovered, $samples);
+
+gc_collect_cycles();
+
+$memory_end = memory_get_usage(true);
+$memory_diff = $memory_end - $memory_start;
+
+if ($errors > 0) {
+    printWarning("Erros: $errors (erasures: {$info['erasures']})");
+} elseif ($memory_diff > 102400) {
+    printWarning("Crescimento: " . formatBytes($memory_diff));
+} else {
+    printSuccess(sprintf("OK (%d frames ocultados, %s)", $info['erasures'], formatBytes($memory_diff)));
+}
+
 // ============================================================================
 // RESUMO FINAL
 // ============================================================================